@@ -0,0 +1,542 @@
+// Micro-benchmarks of MCC and particle kernels.
+//
+// Inputs (including the cross section table) are synthetic and generated
+// from a fixed seed, each kernel is
+// timed over sizes 10^k from --min-size to --max-size and the result is
+// written as JSON (stdout or --output file). The error of float particle
+// storage against double is written along ("accuracy").
+//
+// usage: bench_kernels [--min-size N] [--max-size N] [--repeat R]
+//                      [--seed S] [--filter name] [--output file]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+
+#include "../espic_type.h"
+#include "../espic_math.h"
+#include "../particles.h"
+#include "../species.h"
+#include "../ambient.h"
+#include "../reaction.h"
+#include "../collision.h"
+#include "../Inject/beam.h"
+
+// deviation of a particle storage precision from double
+class AccuracyResult {
+  public:
+    std::string storage;
+    long size;
+    int nstep;
+    double pos_rms;       // in cells
+    double energy_rel;    // max relative error of total energy
+};
+
+// result of one kernel at one size
+class BenchResult {
+  public:
+    std::string kernel;
+    long size;
+    int repeat;
+    long items;           // work items done in one run
+    double best;          // seconds
+    double median;
+};
+
+class BenchSuite {
+  public:
+    BenchSuite(long nmin, long nmax, int nrep, unsigned s, const std::string& f)
+      : min_size(nmin), max_size(nmax), repeat(nrep), seed(s), filter(f) { }
+
+    // setup(size) prepares input and is not timed, run(size) returns
+    // # of items done
+    void run(const std::string& kernel,
+             std::function<void(long)> setup,
+             std::function<long(long)> fn)
+    {
+      if (!selected(kernel)) return;
+
+      for (long size = min_size; size <= max_size; size *= 10) {
+        std::vector<double> t(repeat);
+        long items = 0;
+        for (int r = 0; r < repeat; r++) {
+          setup(size);
+          auto t0 = std::chrono::steady_clock::now();
+          items = fn(size);
+          std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+          t[r] = elapsed.count();
+        }
+        std::sort(t.begin(), t.end());
+
+        BenchResult res;
+        res.kernel = kernel;
+        res.size = size;
+        res.repeat = repeat;
+        res.items = items;
+        res.best = t[0];
+        res.median = t[repeat/2];
+        result_arr.push_back(res);
+
+        std::cerr << kernel << " size " << size << ": "
+          << 1e9*res.best/std::max(items, 1L) << " ns/item" << std::endl;
+      }
+    }
+
+    void write_json(std::ostream& os) const
+    {
+      std::time_t now = std::time(nullptr);
+      char stamp[32];
+      std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+      os << "{\n  \"suite\": \"espic-kernels\",\n"
+         << "  \"timestamp\": \"" << stamp << "\",\n"
+         << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+         << "  \"seed\": " << seed << ",\n"
+         << "  \"repeat\": " << repeat << ",\n"
+         << "  \"results\": [\n";
+      for (std::size_t i = 0; i < result_arr.size(); i++) {
+        const BenchResult& r = result_arr[i];
+        double rate = r.best > 0. ? r.items/r.best : 0.;
+        os << "    {\"kernel\": \"" << r.kernel << "\", \"size\": " << r.size
+           << ", \"items\": " << r.items
+           << ", \"best_s\": " << r.best << ", \"median_s\": " << r.median
+           << ", \"ns_per_item\": " << 1e9*r.best/std::max(r.items, 1L)
+           << ", \"items_per_s\": " << rate << "}"
+           << (i + 1 < result_arr.size() ? ",\n" : "\n");
+      }
+      os << "  ],\n  \"accuracy\": [\n";
+      for (std::size_t i = 0; i < accuracy_arr.size(); i++) {
+        const AccuracyResult& a = accuracy_arr[i];
+        os << "    {\"storage\": \"" << a.storage << "\", \"size\": " << a.size
+           << ", \"steps\": " << a.nstep << ", \"pos_rms_cells\": " << a.pos_rms
+           << ", \"energy_rel\": " << a.energy_rel << "}"
+           << (i + 1 < accuracy_arr.size() ? ",\n" : "\n");
+      }
+      os << "  ]\n}\n";
+    }
+
+    bool selected(const std::string& kernel) const
+    {
+      return filter.empty() || kernel.find(filter) != std::string::npos;
+    }
+
+    void add_accuracy(const AccuracyResult& a)
+    {
+      accuracy_arr.push_back(a);
+      std::cerr << "accuracy " << a.storage << ": " << a.pos_rms << " cells rms, "
+        << a.energy_rel << " of energy after " << a.nstep << " steps" << std::endl;
+    }
+
+    unsigned get_seed() const { return seed; }
+
+  private:
+    long min_size, max_size;
+    int repeat;
+    unsigned seed;
+    std::string filter;
+    std::vector<BenchResult> result_arr;
+    std::vector<AccuracyResult> accuracy_arr;
+};
+
+/* ------------------------------------------------------- */
+
+// synthetic particles, thermal with vth = 1 in a unit box
+static void make_particles(long n, unsigned seed, Particles& pts)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<Real> uni(0., 1.);
+  std::normal_distribution<Real> nrm(0., 1.);
+
+  pts.pop_back(pts.size());
+  pts.reserve(n);
+  for (long i = 0; i < n; i++)
+    pts.append(Particle(uni(gen), nrm(gen), uni(gen), nrm(gen), uni(gen), nrm(gen)));
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_reaction(BenchSuite& suite)
+{
+  // synthetic table: 3 processes on 20000 energy bins
+  const char* file = "bench_reaction.tmp";
+  const int nbin = 20000;
+  const Real de = 0.00386817;
+  {
+    std::ofstream of(file);
+    of << "basic 3 " << nbin << " " << de << " 1\n"
+       << "reaction 1 ela 0.0\nreaction 2 exc 4.4484\nreaction 3 ion 6.11171 e Ar+\n";
+    for (int i = 1; i <= nbin; i++) {
+      Real e = i*de;
+      of << e << " " << 1e-8/(1. + e) << " " << (e > 4.4484 ? 1e-9*(e - 4.4484) : 0.)
+         << " " << (e > 6.11171 ? 1e-9*log(e/6.11171) : 0.) << "\n";
+    }
+  }
+  Reaction reaction(file, ReactPair("e", "Ar"), 0);
+  std::remove(file);
+  Real emax = 0.9*reaction.de()*reaction.size();
+  std::vector<Real> energy;
+
+  suite.run("Reaction::en_cs",
+    [&](long n) {
+      std::mt19937 gen(suite.get_seed());
+      std::uniform_real_distribution<Real> uni(0., emax);
+      energy.resize(n);
+      for (Real& e : energy) e = uni(gen);
+    },
+    [&](long n) {
+      Real sum = 0.;
+      for (long i = 0; i < n; i++) sum += reaction.en_cs(energy[i])[0];
+      if (sum < 0.) std::cerr << sum;
+      return n;
+    });
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_random(BenchSuite& suite)
+{
+  suite.run("VelBoltzDistr",
+    [&](long) { },
+    [&](long n) {
+      Real vx, vy, vz, sum = 0.;
+      for (long i = 0; i < n; i++) {
+        VelBoltzDistr(1., vx, vy, vz);
+        sum += vx + vy + vz;
+      }
+      if (sum > 1e300) std::cerr << sum;
+      return n;
+    });
+
+  suite.run("RG01",
+    [&](long) { },
+    [&](long n) {
+      Real sum = 0.;
+      for (long i = 0; i < n; i++) sum += RG01();
+      if (sum < 0.) std::cerr << sum;
+      return n;
+    });
+
+  std::vector<int> index_list;
+  suite.run("random_index",
+    [&](long) { index_list.clear(); },
+    [&](long n) {
+      random_index(n, n/10, index_list);
+      return n;
+    });
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_collision(BenchSuite& suite)
+{
+  const Real m1 = 1., m2 = 72820.7, vth = 1e-3;
+  Particles pts;
+  std::vector<VrArr> vr;
+  std::vector<Real> g;
+
+  auto setup = [&](long n) {
+    make_particles(n, suite.get_seed(), pts);
+    vr.resize(n);
+    g.resize(n);
+    for (long i = 0; i < n; i++) {
+      // relative speed high enough for all thresholds
+      const Particle& pt = pts[i];
+      Real s = 4./velocity(pt.vx(), pt.vy(), pt.vz());
+      vr[i] = { s*pt.vx(), s*pt.vy(), s*pt.vz() };
+      g[i] = 4.;
+      pts[i].vx() = vr[i][0];
+      pts[i].vy() = vr[i][1];
+      pts[i].vz() = vr[i][2];
+    }
+  };
+
+  const char* name[] = { "Collisionpair::elastic", "Collisionpair::excitation",
+                         "Collisionpair::ionization", "Collisionpair::isotropic",
+                         "Collisionpair::backward" };
+  for (int type = 0; type < 5; type++) {
+    suite.run(name[type], setup,
+      [&, type](long n) {
+        for (long i = 0; i < n; i++) {
+          Collisionpair cp(pts[i], vr[i], g[i], m1, m2, vth);
+          switch (type) {
+            case 0: cp.ParticleElasticCollision(); break;
+            case 1: cp.ParticleExcitatinCollision(1.); break;
+            case 2: cp.ParticleIonizationCollision(1.); break;
+            case 3: cp.ParticleIsotropicCollision(); break;
+            default: cp.ParticleBackwardCollision(); break;
+          }
+        }
+        return n;
+      });
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_particles(BenchSuite& suite)
+{
+  Particles src, dst;
+  std::vector<Particles::size_type> ids;
+
+  suite.run("Particles::append",
+    [&](long n) {
+      make_particles(n, suite.get_seed(), src);
+      dst.pop_back(dst.size());
+    },
+    [&](long n) {
+      for (long i = 0; i < n; i++) dst.append(src[i]);
+      return n;
+    });
+
+  suite.run("Particles::erase",
+    [&](long n) {
+      make_particles(n, suite.get_seed(), dst);
+      std::mt19937 gen(suite.get_seed());
+      ids.resize(n/2);
+      for (long i = 0; i < n/2; i++)
+        ids[i] = std::uniform_int_distribution<long>(0, n-1-i)(gen);
+    },
+    [&](long n) {
+      for (long i = 0; i < n/2; i++) dst.erase(ids[i]);
+      return n/2;
+    });
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_ambient(BenchSuite& suite)
+{
+  Particles* pts = new Particles();
+  const int dims[] = { 2, 3, 5 };
+  const char* name[] = { "Ambient::gen_ambient_2d", "Ambient::gen_ambient_3d",
+                         "Ambient::gen_ambient_axi" };
+
+  for (int d = 0; d < 3; d++) {
+    int nc[3] = { 10, 10, 10 };
+    Real lo[3] = { 0., 0., 0. }, hi[3] = { 10., 10., 10. }, dx[3] = { 1., 1., 1. };
+    Real v[3] = { 0., 0., 0. };
+    Real vol = (3 == dims[d]) ? 1000. : (5 == dims[d]) ? ESPIC::PI*1000. : 100.;
+    Ambient* ambient = nullptr;
+
+    suite.run(name[d],
+      [&](long n) {
+        delete ambient;
+        SpeciesDef spec("e", 1., -1., vol/n);
+        AmbientDef def(0, 1., 1., v, lo, hi);
+        ambient = new Ambient(dims[d], &def, &spec);
+        pts->pop_back(pts->size());
+      },
+      [&](long) {
+        ambient->gen_ambient(nc, lo, hi, dx, pts);
+        return static_cast<long> (pts->size());
+      });
+    delete ambient;
+  }
+
+  {
+    Real v[3] = { 0., 0., 0. }, lo[3] = { 0., 0., 0. }, hi[3] = { 1., 1., 1. };
+    SpeciesDef spec("e", 1., -1., 1.);
+    AmbientDef def(0, 1., 1., v, lo, hi);
+    Ambient ambient(2, &def, &spec);
+    suite.run("Ambient::gen_ambient_0d",
+      [&](long) { pts->pop_back(pts->size()); },
+      [&](long n) {
+        ambient.gen_ambient_0d(n, pts);
+        return static_cast<long> (pts->size());
+      });
+  }
+  delete pts;
+}
+
+/* ------------------------------------------------------- */
+
+static void bench_beam(BenchSuite& suite)
+{
+  const int dims[] = { 2, 3, 5 };
+  const char* name[] = { "Beam::gen_particles_2d", "Beam::gen_particles_3d",
+                         "Beam::gen_particles_axi" };
+  const Real dt = 0.1;
+  std::vector<Particle> buffer;
+
+  for (int d = 0; d < 3; d++) {
+    Real v[3] = { 2., 0., 0. }, c[3] = { 0., 0.5, 0.5 }, fn[3] = { 1., 0., 0. };
+    Beam* beam = nullptr;
+
+    suite.run(name[d],
+      [&](long n) {
+        delete beam;
+        // about n/100 particles per step
+        SpeciesDef spec("e", 1., -1., 1e-2);
+        BeamDef def(0, 1e-2*n/(2.*dt), 1., v, c, fn, 1., 1.);
+        beam = new Beam(dims[d], &def, &spec);
+        // first call fills the particle cache synchronously
+        buffer.clear();
+        beam->gen_particles(dt, buffer);
+      },
+      [&](long n) {
+        long ngen = 0;
+        while (ngen < n) {
+          buffer.clear();
+          beam->gen_particles(dt, buffer);
+          ngen += static_cast<long> (buffer.size());
+          if (buffer.empty()) break;
+        }
+        return ngen;
+      });
+    delete beam;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+// leapfrog in a harmonic well, E = -omega^2*(x - center) on a mesh of
+// unit cells [0, 256)^3, arithmetic in Real and rounded to the storage
+// scalars after each step as in Tile::ParticlePush
+const Real well_center = 128., well_omega2 = 1e-4;
+
+template <typename P, typename V>
+static void push_well(std::vector<BasicParticle<P, V>>& pts, int nstep, Real dt)
+{
+  const long n = static_cast<long> (pts.size());
+  for (int s = 0; s < nstep; s++)
+    for (long i = 0; i < n; i++) {
+      BasicParticle<P, V>& pt = pts[i];
+      pt.vx() += -well_omega2*(pt.x() - well_center)*dt;
+      pt.vy() += -well_omega2*(pt.y() - well_center)*dt;
+      pt.vz() += -well_omega2*(pt.z() - well_center)*dt;
+      pt.x() += Real(pt.vx())*dt;
+      pt.y() += Real(pt.vy())*dt;
+      pt.z() += Real(pt.vz())*dt;
+    }
+}
+
+template <typename P, typename V>
+static Real well_energy(const std::vector<BasicParticle<P, V>>& pts)
+{
+  Real e = 0.;
+  for (const BasicParticle<P, V>& pt : pts) {
+    Real dx = pt.x() - well_center, dy = pt.y() - well_center, dz = pt.z() - well_center;
+    e += 0.5*(Real(pt.vx())*pt.vx() + Real(pt.vy())*pt.vy() + Real(pt.vz())*pt.vz())
+       + 0.5*well_omega2*(dx*dx + dy*dy + dz*dz);
+  }
+  return e;
+}
+
+template <typename P, typename V>
+static void bench_storage(BenchSuite& suite, const std::string& storage)
+{
+  typedef BasicParticle<double, double> Reference;
+  const int nstep = 1000;
+  const Real dt = 0.1;
+  std::vector<Reference> ref;
+  std::vector<BasicParticle<P, V>> pts;
+
+  auto make = [&](long n) {
+    std::mt19937 gen(suite.get_seed());
+    std::uniform_real_distribution<Real> uni(0., 2.*well_center);
+    std::normal_distribution<Real> nrm(0., 1.);
+    ref.clear();
+    for (long i = 0; i < n; i++)
+      ref.push_back(Reference(uni(gen), nrm(gen), uni(gen), nrm(gen), uni(gen), nrm(gen)));
+    pts.clear();
+    for (const Reference& p : ref) pts.push_back(BasicParticle<P, V>(p));
+  };
+
+  suite.run("push<" + storage + ">", make,
+    [&](long n) {
+      push_well(pts, 10, dt);
+      return 10*n;
+    });
+
+  // against the same particles stored in double
+  if (!suite.selected("push<" + storage + ">")) return;
+  const long n = 10000;
+  make(n);
+  Real e0 = well_energy(ref), emax = 0., sum2 = 0.;
+  for (int s = 0; s < nstep; s += 10) {
+    push_well(ref, 10, dt);
+    push_well(pts, 10, dt);
+    Real e = well_energy(ref), ep = well_energy(pts);
+    emax = std::max(emax, fabs(ep - e)/e0);
+  }
+  for (long i = 0; i < n; i++) {
+    Real dx = pts[i].x() - ref[i].x(), dy = pts[i].y() - ref[i].y(), dz = pts[i].z() - ref[i].z();
+    sum2 += dx*dx + dy*dy + dz*dz;
+  }
+
+  AccuracyResult a;
+  a.storage = storage;
+  a.size = n;
+  a.nstep = nstep;
+  a.pos_rms = sqrt(sum2/n);
+  a.energy_rel = emax;
+  suite.add_accuracy(a);
+}
+
+static void bench_precision(BenchSuite& suite)
+{
+  bench_storage<double, double>(suite, "double");
+  bench_storage<double, float>(suite, "mixed");
+  bench_storage<float, float>(suite, "single");
+}
+
+/* ------------------------------------------------------- */
+
+int main(int argc, char** argv)
+{
+  long nmin = 1000, nmax = 1000000;
+  int nrep = 3;
+  unsigned seed = 12345;
+  std::string filter, outfile;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value of " << arg << std::endl;
+      return 1;
+    }
+         if ("--min-size" == arg) nmin = static_cast<long> (atof(argv[++i]));
+    else if ("--max-size" == arg) nmax = static_cast<long> (atof(argv[++i]));
+    else if ("--repeat"   == arg) nrep = atoi(argv[++i]);
+    else if ("--seed"     == arg) seed = static_cast<unsigned> (atol(argv[++i]));
+    else if ("--filter"   == arg) filter = argv[++i];
+    else if ("--output"   == arg) outfile = argv[++i];
+    else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (nmin < 1 || nmax < nmin || nrep < 1) {
+    std::cerr << "Illegal sizes or repeat" << std::endl;
+    return 1;
+  }
+
+  ESPIC::Random::set_seed(seed);
+  kTe0 = 2.585;
+
+  BenchSuite suite(nmin, nmax, nrep, seed, filter);
+  bench_reaction(suite);
+  bench_random(suite);
+  bench_collision(suite);
+  bench_particles(suite);
+  bench_ambient(suite);
+  bench_beam(suite);
+  bench_precision(suite);
+
+  if (outfile.empty()) suite.write_json(std::cout);
+  else {
+    std::ofstream of(outfile);
+    suite.write_json(of);
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#!/bin/bash
+# Check that seeded decks give the same history on any # of threads
+# and across a checkpoint and restart.
+#
+# usage: Bench/check_threads.sh [max_threads] [decks...]
+#
+# Each deck (with "seed" in its control.in) runs in a scratch copy under
+# Bench/runs/<deck>.<threads> on 1, 2, 4, ... max_threads threads and
+# history.dat of every run is compared byte by byte with the one of the
+# 1-thread run. A deck with a "checkpoint every N" line is also run up
+# to step N on max_threads threads and restarted from its checkpoint, and
+# the history of both parts has to be the same as the straight run.
+# Needs main built with OpenMP, e.g.
+#   make CFLAGS="-std=c++17 -Wall -g -O2 -pthread -fopenmp -DOMP"
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+PROG=$ROOT/main
+MAXT=${1:-4}
+shift
+DECKS=${@:-"inject2d pair2d"}
+
+if [ ! -x "$PROG" ]; then
+  echo "Build main first (make)" >&2
+  exit 1
+fi
+
+. "$ROOT/Bench/reaction.sh"
+
+status=0
+for deck in $DECKS; do
+  mkdir -p "$ROOT/Bench/runs"
+  t=1
+  while [ $t -le $MAXT ]; do
+    dir=$ROOT/Bench/runs/$deck.$t
+    rm -rf "$dir"
+    cp -r "$ROOT/Bench/decks/$deck" "$dir"
+    write_reaction "$dir"
+    (cd "$dir" && OMP_NUM_THREADS=$t "$PROG" > main.log 2>&1)
+    if [ $? -ne 0 ]; then
+      echo "$deck on $t threads failed, see $dir/main.log" >&2
+      status=1
+    elif [ $t -gt 1 ]; then
+      if cmp -s "$ROOT/Bench/runs/$deck.1/history.dat" "$dir/history.dat"; then
+        echo "$deck: $t threads same as 1"
+      else
+        echo "$deck: $t threads differ from 1, see $dir/history.dat" >&2
+        status=1
+      fi
+    fi
+    t=$((t*2))
+  done
+
+  # checkpoint at step N and restart from it
+  nckpt=$(awk '$1 == "checkpoint" && $2 == "every" { print $3 }' "$ROOT/Bench/decks/$deck/control.in")
+  nstep=$(awk '$1 == "num_steps" { print $2 }' "$ROOT/Bench/decks/$deck/control.in")
+  if [ -n "$nckpt" ] && [ "$nckpt" -gt 0 ] && [ "$nckpt" -lt "$nstep" ]; then
+    dir=$ROOT/Bench/runs/$deck.restart
+    rm -rf "$dir"
+    cp -r "$ROOT/Bench/decks/$deck" "$dir"
+    write_reaction "$dir"
+    sed -i "s/^num_steps .*/num_steps $nckpt/" "$dir/control.in"
+    (cd "$dir" && OMP_NUM_THREADS=$MAXT "$PROG" > main.log 2>&1 \
+      && mv history.dat history.1 \
+      && sed -i "s/^num_steps .*/num_steps $((nstep-nckpt))/" control.in \
+      && echo "restart restart.ckpt" >> control.in \
+      && OMP_NUM_THREADS=$MAXT "$PROG" > restart.log 2>&1)
+    if [ $? -ne 0 ]; then
+      echo "$deck restart failed, see $dir/main.log and $dir/restart.log" >&2
+      status=1
+    else
+      (cat "$dir/history.1"; tail -n +2 "$dir/history.dat") > "$dir/history.all"
+      if cmp -s "$ROOT/Bench/runs/$deck.1/history.dat" "$dir/history.all"; then
+        echo "$deck: restart at step $nckpt same as straight run"
+      else
+        echo "$deck: restart at step $nckpt differs from straight run, see $dir/history.all" >&2
+        status=1
+      fi
+    fi
+  fi
+done
+exit $status
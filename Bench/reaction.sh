@@ -0,0 +1,24 @@
+# synthetic e-Ar cross sections (elastic, excitation, ionization) and a
+# Coulomb table for pairs of particles of the decks in Bench/decks,
+# sourced by the run scripts
+#
+# usage: write_reaction <run directory>
+write_reaction()
+{
+  mkdir -p "$1/reaction"
+  awk 'BEGIN {
+    nbin = 20000; de = 0.05;
+    printf "basic 3 %d %g 1\n", nbin, de;
+    print "reaction 1 ela 0.0";
+    print "reaction 2 exc 11.5";
+    print "reaction 3 ion 15.8 e Ar+";
+    for (i = 1; i <= nbin; i++) {
+      e = i*de;
+      exc = (e > 11.5) ? 2e-9*(1 - 11.5/e) : 0;
+      ion = (e > 15.8) ? 3e-9*log(e/15.8)/e*15.8 : 0;
+      printf "%g %g %g %g\n", e, 1e-8/(1 + 0.1*e), exc, ion;
+    }
+  }' > "$1/reaction/e_Ar_synth.dat"
+  # coul: Coulomb logarithm in place of the threshold, no cross sections
+  printf "basic 1 2 1.0 1\nreaction 1 coul 10.0\n1.0 0\n2.0 0\n" > "$1/reaction/coulomb_synth.dat"
+}
@@ -0,0 +1,79 @@
+#!/bin/bash
+# End-to-end scaling runs of the decks in Bench/decks.
+#
+# usage: Bench/run_scaling.sh [max_threads] [decks...]
+#
+# Each deck runs in a scratch copy under Bench/runs/<deck>:
+#   strong scaling - same deck on 1, 2, 4, ... max_threads threads
+#   weak scaling   - species weights divided by the # of threads, so the
+#                    # of particles grows with the threads
+# and steps/s, particle pushes/s and peak memory are read from the end of
+# run report of main. Thread scaling needs main built with OpenMP, e.g.
+#   make CFLAGS="-std=c++17 -Wall -g -O2 -pthread -fopenmp -DOMP"
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+PROG=$ROOT/main
+MAXT=${1:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+shift
+DECKS=${@:-"mcc0d cond2d axi box3d"}
+
+if [ ! -x "$PROG" ]; then
+  echo "Build main first (make)" >&2
+  exit 1
+fi
+
+. "$ROOT/Bench/reaction.sh"
+
+# run a deck in a directory with a # of threads and a weight divisor,
+# print: threads particles steps/s pushes/s peak_MB
+run_case()
+{
+  local deck=$1 dir=$2 nthr=$3 wdiv=$4
+  rm -rf "$dir"
+  cp -r "$ROOT/Bench/decks/$deck" "$dir"
+  write_reaction "$dir"
+  awk -v d="$wdiv" '$1 == "species" { $5 = $5/d } { print }' \
+    "$ROOT/Bench/decks/$deck/particle.in" > "$dir/particle.in"
+
+  (cd "$dir" && OMP_NUM_THREADS=$nthr "$PROG" > main.log 2>&1)
+  if [ $? -ne 0 ]; then
+    echo "$deck on $nthr threads failed, see $dir/main.log" >&2
+    echo "$nthr 0 0 0 0"
+    return
+  fi
+  awk -v t="$nthr" '
+    /^End of run/ { np = $10; ns = $12; wall = $15; final = 1 }
+    final && $1 == "push" { npush = $4 }
+    final && /peak memory/ { mem = $3 }
+    END { printf "%d %d %.2f %.4g %.1f\n", t, np, ns/wall, npush/wall, mem }
+  ' "$dir/main.log"
+}
+
+for deck in $DECKS; do
+  mkdir -p "$ROOT/Bench/runs"
+  echo "== $deck =="
+
+  echo "strong scaling"
+  printf "%8s %12s %10s %12s %9s %9s %9s\n" threads particles steps/s pushes/s speedup effic peakMB
+  t=1; base=""
+  while [ $t -le $MAXT ]; do
+    read nt np sps pps mem <<< "$(run_case $deck "$ROOT/Bench/runs/$deck" $t 1)"
+    [ -z "$base" ] && base=$sps
+    [ "$base" = "0" ] && base=1
+    awk -v nt=$nt -v np=$np -v s=$sps -v p=$pps -v m=$mem -v b=$base 'BEGIN {
+      printf "%8d %12d %10.2f %12.4g %9.2f %8.0f%% %9.1f\n", nt, np, s, p, s/b, 100*s/b/nt, m }'
+    t=$((t*2))
+  done
+
+  echo "weak scaling"
+  printf "%8s %12s %10s %12s %9s %9s\n" threads particles steps/s pushes/s effic peakMB
+  t=1; base=""
+  while [ $t -le $MAXT ]; do
+    read nt np sps pps mem <<< "$(run_case $deck "$ROOT/Bench/runs/$deck" $t $t)"
+    [ -z "$base" ] && base=$sps
+    [ "$base" = "0" ] && base=1
+    awk -v nt=$nt -v np=$np -v s=$sps -v p=$pps -v m=$mem -v b=$base 'BEGIN {
+      printf "%8d %12d %10.2f %12.4g %8.0f%% %9.1f\n", nt, np, s, p, 100*s/b, m }'
+    t=$((t*2))
+  done
+done
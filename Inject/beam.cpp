@@ -1,13 +1,21 @@
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include "../espic_info.h"
 #include "../espic_math.h"
 #include "../mesh.h"
 #include "../species.h"
 #include "beam.h"
 
+#ifdef OMP
+#include <omp.h>
+#endif
+
 using namespace ESPIC;
 
+// # of cached particles generated per block
+const int nblock = 1024;
+
 /* ---------------- Begin Public Methods ---------------- */
 
 /* ------------------------------------------------------- */
@@ -20,8 +28,8 @@ Beam::Beam(int dimension, const BeamDef* const & beamdef, const SpeciesDef* cons
       width_x(beamdef->width_x),
       width_y(beamdef->width_y),
       center{beamdef->center[0], beamdef->center[1], beamdef->center[2]},
-      cache_size(0),
-      cache_cursor(0)
+      cache_cursor(0),
+      cache_front(0)
 {
   // vector normal to beam tmat[0]
   Real norm = 0.;
@@ -36,20 +44,35 @@ Beam::Beam(int dimension, const BeamDef* const & beamdef, const SpeciesDef* cons
   switch (dimension) {
     case 2:
       init_2d();
-      ptr_gen_particles = &Beam::gen_particles_2d;
+      ptr_fill_cache = &Beam::fill_cache_2d;
       break;
     case 3:
       init_3d();
-      ptr_gen_particles = &Beam::gen_particles_3d;
+      ptr_fill_cache = &Beam::fill_cache_3d;
       break;
     case 5:
       init_axi();
-      ptr_gen_particles = &Beam::gen_particles_axi;
+      ptr_fill_cache = &Beam::fill_cache_axi;
       break;
     default:
       espic_error("Simulation must be performed in 2d, 3d or axisymmetric");
   }
 
+  // aperture spans width_y along tmat[1] in 2d and axi-symmetric, and
+  // width_x along tmat[1] and width_y along tmat[2] in 3d
+  Real x0, span[2] = { 0., 0. };
+  if (3 == dimension) {
+    x0 = center[0] - 0.5*width_x*tmat[1][0] - 0.5*width_y*tmat[2][0];
+    span[0] = width_x*tmat[1][0];
+    span[1] = width_y*tmat[2][0];
+  }
+  else {
+    x0 = center[0] - 0.5*width_y*tmat[0][1];
+    span[0] = width_y*tmat[1][0];
+  }
+  xrange[0] = x0 + std::min(span[0], 0.) + std::min(span[1], 0.);
+  xrange[1] = x0 + std::max(span[0], 0.) + std::max(span[1], 0.);
+
 // std::cout << "beam: " <<  "species = " << specdef->name
 // << ", n = " << ndens
 // << ", T = " << temp
@@ -73,9 +96,18 @@ Beam::Beam(int dimension, const BeamDef* const & beamdef, const SpeciesDef* cons
 
 /* ------------------------------------------------------- */
 
+Beam::~Beam()
+{
+  if (cache_refill.valid()) cache_refill.wait();
+}
+
+/* ------------------------------------------------------- */
+
 void Beam::gen_particles(Real dt, std::vector<Particle>& particles)
 {
-  (this->*ptr_gen_particles)(dt, particles);
+  if (cache_cursor == cache[cache_front].size) swap_particle_cache(dt);
+
+  inject_beam_particles(particles);
 }
 
 /* ------------------------------------------------------- */
@@ -107,6 +139,35 @@ void Beam::print() const
             << ", sn = " << sn
             << ", pn = " << pn
             << ", nflowrate = " << nflowrate << "\n";
+  std::cout << "beam cache: " << timing.nrefills << " refills"
+            << ", " << timing.nparticles << " particles"
+            << ", refill time (last/max/total) = " << timing.last
+            << "/" << timing.max << "/" << timing.total << " s"
+            << ", waited " << timing.wait << " s\n";
+}
+
+/* ------------------------------------------------------- */
+
+Inject::Position Beam::position() const
+{
+  // the front cache is not touched by a pending refill of the back one
+  const ParticleCache& front = cache[cache_front];
+  if (0 == front.size) return Position{ nfill, nres, 0 };
+  return Position{ front.ifill, front.res, cache_cursor };
+}
+
+/* ------------------------------------------------------- */
+
+void Beam::set_position(const Position& pos)
+{
+  if (cache_refill.valid()) cache_refill.get();
+  cache_refill = std::future<void>();
+
+  nfill = pos.ifill;
+  nres = pos.res;
+  resume_cursor = pos.cursor;
+  cache[cache_front].size = 0;
+  cache_cursor = 0;
 }
 
 // void Beam::inject_2d(Real dt, Particle* particle)
@@ -195,6 +256,35 @@ void Beam::init_axi()
 
 void Beam::init_3d()
 {
+  // first vector on beam exit surface, the same as 2d
+  // unless the beam is normal to the x-y plane
+  Real txy = sqrt(tmat[0][0]*tmat[0][0] + tmat[0][1]*tmat[0][1]);
+  if (txy > 1e-13) {
+    tmat[1][0] = -tmat[0][1]/txy;
+    tmat[1][1] = +tmat[0][0]/txy;
+    tmat[1][2] = 0.;
+  }
+  else {
+    tmat[1][0] = 1.;
+    tmat[1][1] = 0.;
+    tmat[1][2] = 0.;
+  }
+
+  // vector normal to the two other vectors
+  cross_prod(tmat[0], tmat[1], tmat[2]);
+
+  // aperture spans width_x along tmat[1] and width_y along tmat[2]
+  area = width_x*width_y;
+
+  precomputed(area);
+
+  int nthreads = 1;
+#ifdef OMP
+  nthreads = omp_get_max_threads();
+#endif
+  rng_arr.resize(nthreads);
+
+  return;
 }
 
 /* ------------------------------------------------------- */
@@ -217,54 +307,100 @@ void Beam::init_plane_2d_axi()
 
 /* ------------------------------------------------------- */
 
-void Beam::init_particle_cache_arr(Real dt)
+void Beam::init_particle_cache_arr(Real dt, ParticleCache& pcache)
 {
   Real dt_weight = dt/weight;
   Real np_inj = dt_weight*nflowrate;
 
   // cache ~ 1M particles in particle_cache_arr
-  cache_size = static_cast<int> (std::min(2*1024.*1024./np_inj, 1000.));
-  // round to multiple of 10
-  cache_size = static_cast<int> (cache_size/10 + 0.5)*10;
-  cache_count.resize(cache_size+1, 0);
+  pcache.size = static_cast<int> (std::min(2*1024.*1024./np_inj, 1000.));
+  // round to multiple of 10 (at least one step)
+  pcache.size = std::max(static_cast<int> (pcache.size/10 + 0.5)*10, 1);
+  pcache.count.assign(pcache.size+1, 0);
 
   if (np_inj > 1e-3) {  // do not inject particles if np_inj too small 
-    for (cache_cursor = 0; cache_cursor < cache_size; cache_cursor++) {
-      int np_gen = static_cast<int> (np_inj + nres + ranf());
-      cache_count[cache_cursor+1] = cache_count[cache_cursor]+np_gen;
+    for (int istep = 0; istep < pcache.size; istep++) {
+      int np_gen = static_cast<int> (np_inj + nres + rng());
+      pcache.count[istep+1] = pcache.count[istep]+np_gen;
       nres += (np_inj - np_gen);
     }
-    particle_cache_arr.resize(cache_count[cache_size]);
   }
+  pcache.arr.resize(pcache.count[pcache.size]);
 }
 
 /* ------------------------------------------------------- */
 
-void Beam::gen_particles_2d(Real dt, std::vector<Particle>& particles)
+void Beam::refill_particle_cache(Real dt, ParticleCache& pcache)
 {
-  if (cache_cursor == cache_size) {
-    init_particle_cache_arr(dt);
-
-    Real dtfrac = dt*1.0;
-    Particle particle (0, 0, 0, 0, 0, 0);
-    Real pos[3] = {0., 0., 0.}, vel[3] = {0., 0., 0.}, vn;
-    Real Lx, Ly, Lz = 0.;
-    Real x0 = center[0] - 0.5*width_y*tmat[0][1]; // origin of beam plane coord system
-    Real y0 = center[1] - 0.5*width_y*tmat[0][0];
-
-// #ifdef OMP
-// #pragma omp parallel for private (particle, pos,vel, vn, Lx, Ly, Lz)
-// #endif
-    for (int ip = 0; ip < cache_count[cache_size]; ip++) {
-      // generate velocity for a particle to be injected
-      gen_one_vel(vel);
-      
+  auto t0 = std::chrono::steady_clock::now();
+
+  pcache.ifill = nfill;
+  pcache.res = nres;
+  key_fill();
+  init_particle_cache_arr(dt, pcache);
+  (this->*ptr_fill_cache)(dt, pcache);
+  nfill++;
+
+  std::chrono::duration<Real> elapsed = std::chrono::steady_clock::now() - t0;
+  pcache.fill_time = elapsed.count();
+}
+
+/* ------------------------------------------------------- */
+
+void Beam::swap_particle_cache(Real dt)
+{
+  auto t0 = std::chrono::steady_clock::now();
+
+  if (cache_refill.valid()) {
+    // normally finished while the front cache was drained
+    cache_refill.get();
+  }
+  else {
+    // very first fill, nothing to overlap with
+    refill_particle_cache(dt, cache[1-cache_front]);
+  }
+
+  std::chrono::duration<Real> elapsed = std::chrono::steady_clock::now() - t0;
+  timing.wait += elapsed.count();
+
+  cache_front = 1-cache_front;
+  cache_cursor = resume_cursor;
+  resume_cursor = 0;
+
+  const ParticleCache& front = cache[cache_front];
+  timing.nrefills++;
+  timing.nparticles += front.count[front.size];
+  timing.last = front.fill_time;
+  timing.total += front.fill_time;
+  timing.max = std::max(timing.max, front.fill_time);
+
+  // fill the drained cache on a worker thread
+  cache_refill = std::async(std::launch::async, &Beam::refill_particle_cache,
+                            this, dt, std::ref(cache[1-cache_front]));
+}
+
+/* ------------------------------------------------------- */
+
+void Beam::fill_cache_2d(Real dt, ParticleCache& pcache)
+{
+  Real dtfrac = dt*1.0;
+  Real vx[nblock], vy[nblock], vz[nblock], vn;
+  Real Lx, Ly, Lz = 0.;
+  Real x0 = center[0] - 0.5*width_y*tmat[0][1]; // origin of beam plane coord system
+  Real y0 = center[1] - 0.5*width_y*tmat[0][0];
+  int np = pcache.count[pcache.size];
+
+  for (int ib = 0; ib < np; ib += nblock) {
+    int nb = std::min(nblock, np - ib);
+
+    // generate velocities for a block of particles to be injected
+    gen_vels(nb, vx, vy, vz);
+
+    for (int i = 0; i < nb; i++) {
       // generate initial position for a particle to be injected
-      vn = vel[0]*tmat[0][0] + vel[1]*tmat[0][1] + vel[2]*tmat[0][2];
-      Lx = vn*ranf()*dtfrac;
-      Ly = width_y*ranf();
-      pos[0] = tmat[0][0]*Lx + tmat[1][0]*Ly + tmat[2][0]*Lz + x0;
-      pos[1] = tmat[0][1]*Lx + tmat[1][1]*Ly + tmat[2][1]*Lz + y0;
+      vn = vx[i]*tmat[0][0] + vy[i]*tmat[0][1] + vz[i]*tmat[0][2];
+      Lx = vn*rng()*dtfrac;
+      Ly = width_y*rng();
 
 #ifdef DEBUG
       if (Lx < 0.) {
@@ -272,62 +408,47 @@ void Beam::gen_particles_2d(Real dt, std::vector<Particle>& particles)
       }
 #endif
 
-      particle.x() = pos[0];
-      particle.y() = pos[1];
+      Particle& particle = pcache.arr[ib+i];
+      particle.x() = tmat[0][0]*Lx + tmat[1][0]*Ly + tmat[2][0]*Lz + x0;
+      particle.y() = tmat[0][1]*Lx + tmat[1][1]*Ly + tmat[2][1]*Lz + y0;
       particle.z() = 0.;
-      particle.vx() = vel[0];
-      particle.vy() = vel[1];
-      particle.vz() = vel[2];
-
-//     particles[ip] = particle;
-      particle_cache_arr[ip] = particle;
-    }   // end for (ip = 0; ip < np_gen; ++ip)
-
-// if (specid == 0) {
-//   for (int ip = 0; ip < cache_count[cache_size]; ip++) {
-//     auto particle = particle_cache_arr[ip];
-//     std::cout <<  particle.vx() << " " << particle.vy() << " " << particle.x() << " " << particle.y() << "\n";
-//   }
-// }
-    cache_cursor = 0;
-  }
-
-  inject_beam_particles(particles);
-
+      particle.vx() = vx[i];
+      particle.vy() = vy[i];
+      particle.vz() = vz[i];
+    }
+  }   // end for (ib = 0; ib < np; ib += nblock)
 }
 
 /* ------------------------------------------------------- */
 
-void Beam::gen_particles_axi(Real dt, std::vector<Particle>& particles)
+void Beam::fill_cache_axi(Real dt, ParticleCache& pcache)
 {
-  if (cache_cursor == cache_size) {
-    init_particle_cache_arr(dt);
-
-    Real dtfrac = dt*1.0;
-    Particle particle (0, 0, 0, 0, 0, 0);
-    Real pos[3] = {0., 0., 0.}, vel[3] = {0., 0., 0.}, vn;
-    Real Lx, Ly, Lz = 0.;
-    Real x0 = center[0] - 0.5*width_y*tmat[0][1]; // origin of beam plane coord system
-    Real y0 = center[1] - 0.5*width_y*tmat[0][0];
-    Real y0sq = y0*y0, y0doub = 2.*y0;
-    bool normal_to_x = fabs(tmat[0][0]) < 1e-13;  // beam plane is normal to x-axis
-    Real wy_nx = width_y*tmat[0][0];
-
-    for (int ip = 0; ip < cache_count[cache_size]; ip++) {
-      // generate velocity for a particle to be injected
-      gen_one_vel(vel);
-
+  Real dtfrac = dt*1.0;
+  Real vx[nblock], vy[nblock], vz[nblock], vn;
+  Real Lx, Ly, Lz = 0.;
+  Real x0 = center[0] - 0.5*width_y*tmat[0][1]; // origin of beam plane coord system
+  Real y0 = center[1] - 0.5*width_y*tmat[0][0];
+  Real y0sq = y0*y0, y0doub = 2.*y0;
+  bool normal_to_x = fabs(tmat[0][0]) < 1e-13;  // beam plane is normal to x-axis
+  Real wy_nx = width_y*tmat[0][0];
+  int np = pcache.count[pcache.size];
+
+  for (int ib = 0; ib < np; ib += nblock) {
+    int nb = std::min(nblock, np - ib);
+
+    // generate velocities for a block of particles to be injected
+    gen_vels(nb, vx, vy, vz);
+
+    for (int i = 0; i < nb; i++) {
       if (normal_to_x) {
-        Ly = width_y*ranf();
+        Ly = width_y*rng();
       }
       else {
-        Ly = -y0 + sqrt(y0sq + wy_nx*(y0doub + wy_nx)*ranf());
+        Ly = -y0 + sqrt(y0sq + wy_nx*(y0doub + wy_nx)*rng());
       }
       // generate initial position for a particle to be injected
-      vn = vel[0]*tmat[0][0] + vel[1]*tmat[0][1] + vel[2]*tmat[0][2];
-      Lx = vn*ranf()*dtfrac;
-      pos[0] = tmat[0][0]*Lx + tmat[1][0]*Ly + tmat[2][0]*Lz + x0;
-      pos[1] = tmat[0][1]*Lx + tmat[1][1]*Ly + tmat[2][1]*Lz + y0;
+      vn = vx[i]*tmat[0][0] + vy[i]*tmat[0][1] + vz[i]*tmat[0][2];
+      Lx = vn*rng()*dtfrac;
 
 #ifdef DEBUG
       if (Lx < 0.) {
@@ -335,39 +456,79 @@ void Beam::gen_particles_axi(Real dt, std::vector<Particle>& particles)
       }
 #endif
 
-      particle.x() = pos[0];
-      particle.y() = pos[1];
+      Particle& particle = pcache.arr[ib+i];
+      particle.x() = tmat[0][0]*Lx + tmat[1][0]*Ly + tmat[2][0]*Lz + x0;
+      particle.y() = tmat[0][1]*Lx + tmat[1][1]*Ly + tmat[2][1]*Lz + y0;
       particle.z() = 0.;
-      particle.vx() = vel[0];
-      particle.vy() = vel[1];
-      particle.vz() = vel[2];
-
-      particle_cache_arr[ip] = particle;
-    }   // end for (ip = 0; ip < np_gen; ++ip)
-
-    cache_cursor = 0;
-  }
-
-  inject_beam_particles(particles);
-
+      particle.vx() = vx[i];
+      particle.vy() = vy[i];
+      particle.vz() = vz[i];
+    }
+  }   // end for (ib = 0; ib < np; ib += nblock)
 }
 
 
 /* ------------------------------------------------------- */
 
-void Beam::gen_particles_3d(Real dt, std::vector<Particle>& particles)
+void Beam::fill_cache_3d(Real dt, ParticleCache& pcache)
 {
+  Real dtfrac = dt*1.0;
+  Real x0[3];   // origin of beam plane coord system (corner of aperture)
+  for (int a = 0; a < 3; a++) {
+    x0[a] = center[a] - 0.5*width_x*tmat[1][a] - 0.5*width_y*tmat[2][a];
+  }
+  int np = pcache.count[pcache.size];
+  int nblocks = (np + nblock - 1)/nblock;
+
+  // each thread fills a disjoint range of blocks, a block draws from a
+  // stream keyed by its index, independent of the # of threads
+  int nthreads = static_cast<int> (rng_arr.size());
+#ifdef OMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+#endif
+  for (int ithrd = 0; ithrd < nthreads; ithrd++) {
+    const Random& rnd = rng_arr[ithrd];
+    Real vx[nblock], vy[nblock], vz[nblock], ru[3*nblock];
+
+    for (int iblk = nblocks*ithrd/nthreads; iblk < nblocks*(ithrd+1)/nthreads; iblk++) {
+      int ib = iblk*nblock;
+      int nb = std::min(nblock, np - ib);
+      rnd.set_key(nfill, rng_stream, iblk);
 
+      // generate velocities for a block of particles to be injected
+      gen_vels(nb, vx, vy, vz, rnd);
+      for (int i = 0; i < 3*nb; i++) ru[i] = rnd();
+
+#ifdef OMP
+#pragma omp simd
+#endif
+      for (int i = 0; i < nb; i++) {
+        // generate initial position for a particle to be injected
+        Real vn = vx[i]*tmat[0][0] + vy[i]*tmat[0][1] + vz[i]*tmat[0][2];
+        Real Lx = vn*ru[i]*dtfrac;
+        Real Ly = width_x*ru[nb+i];
+        Real Lz = width_y*ru[2*nb+i];
+
+        Particle& particle = pcache.arr[ib+i];
+        particle.x() = tmat[0][0]*Lx + tmat[1][0]*Ly + tmat[2][0]*Lz + x0[0];
+        particle.y() = tmat[0][1]*Lx + tmat[1][1]*Ly + tmat[2][1]*Lz + x0[1];
+        particle.z() = tmat[0][2]*Lx + tmat[1][2]*Ly + tmat[2][2]*Lz + x0[2];
+        particle.vx() = vx[i];
+        particle.vy() = vy[i];
+        particle.vz() = vz[i];
+      }
+    }
+  }   // end for (ithrd = 0; ithrd < nthreads; ithrd++)
 }
 
 /* ------------------------------------------------------- */
 
 void Beam::inject_beam_particles(std::vector<Particle>& particles)
 {
-  auto pos = particles.cbegin();
-  auto beg = particle_cache_arr.cbegin()+cache_count[cache_cursor];
-  auto end = particle_cache_arr.cbegin()+cache_count[cache_cursor+1];
-  particles.insert(pos, beg, end);
+  const ParticleCache& front = cache[cache_front];
+  auto beg = front.arr.cbegin()+front.count[cache_cursor];
+  auto end = front.arr.cbegin()+front.count[cache_cursor+1];
+  particles.insert(particles.end(), beg, end);
   cache_cursor++;
 }
 
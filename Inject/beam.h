@@ -1,6 +1,7 @@
 #ifndef _BEAM_H
 #define _BEAM_H
 
+#include <future>
 #include "inject.h"
 
 class BeamDef
@@ -29,13 +30,52 @@ class Beam : public Inject
     // constructors
     Beam(int, const class BeamDef* const&, const class SpeciesDef* const&);
 
+    // destructor (waits for a pending cache refill)
+    ~Beam();
+
     void gen_particles(Real, std::vector<Particle>&);
 
     void print() const;
 
+    void x_extent(Real& xa, Real& xb) const { xa = xrange[0]; xb = xrange[1]; }
+
+    Position position() const;
+
+    // waits for and drops a pending cache refill
+    void set_position(const Position&);
+
+    // wall time (in seconds) spent on refilling the particle cache
+    class RefillTiming {
+      public:
+        RefillTiming() 
+          : nrefills(0), nparticles(0), last(0.), total(0.), max(0.), wait(0.) { }
+
+        int nrefills;     // # of refills done
+        long nparticles;  // # of particles generated
+        Real last;        // time of last refill on the worker thread
+        Real total;       // time of all refills on the worker thread
+        Real max;         // longest refill
+        Real wait;        // time the caller was blocked waiting for a refill
+    };
+
+    const RefillTiming& refill_timing() const { return timing; }
+
   private:
-    typedef void (Beam::*GenPartFn)(Real, std::vector<Particle>&);
-    GenPartFn ptr_gen_particles;
+    // particles to be injected in the next cache_size steps
+    class ParticleCache {
+      public:
+        ParticleCache() : size(0), ifill(0), res(0.), fill_time(0.) { }
+
+        int size;                         // # of steps covered
+        uint64_t ifill;                   // fill # of the cache
+        Real res;                         // residual before the fill
+        std::vector<int> count;           // offset of each step in arr
+        std::vector<Particle> arr;
+        Real fill_time;                   // wall time used to fill
+    };
+
+    typedef void (Beam::*FillCacheFn)(Real, ParticleCache&);
+    FillCacheFn ptr_fill_cache;
 
     // private methods
     void init_2d();
@@ -43,11 +83,14 @@ class Beam : public Inject
     void init_axi();
 
     void init_plane_2d_axi();
-    void init_particle_cache_arr(Real);
+    void init_particle_cache_arr(Real, ParticleCache&);
+
+    void fill_cache_2d(Real, ParticleCache&);
+    void fill_cache_3d(Real, ParticleCache&);
+    void fill_cache_axi(Real, ParticleCache&);
 
-    void gen_particles_2d(Real, std::vector<Particle>&);
-    void gen_particles_3d(Real, std::vector<Particle>&);
-    void gen_particles_axi(Real, std::vector<Particle>&);
+    void refill_particle_cache(Real, ParticleCache&);
+    void swap_particle_cache(Real);
 
     void inject_beam_particles(std::vector<Particle>&);
 
@@ -56,12 +99,17 @@ class Beam : public Inject
     Real width_y;
     Real area;
     Real center[3];   // beam center
+    Real xrange[2];   // x-extent of the aperture
 
   private:
-    int cache_size;
     int cache_cursor;
-    std::vector<int> cache_count;
-    std::vector<Particle> particle_cache_arr;
+    int cache_front;              // cache being drained, the other one
+                                  // is filled on a worker thread
+    ParticleCache cache[2];
+    RefillTiming timing;
+    std::vector<ESPIC::Random> rng_arr; // per-thread streams for 3d fill,
+                                        // keyed by (fill, beam, block)
+    std::future<void> cache_refill;
 };
 
 #endif
@@ -0,0 +1,254 @@
+#include <iostream>
+#include <algorithm>
+#include "../espic_info.h"
+#include "../espic_math.h"
+#include "../mesh.h"
+#include "../species.h"
+#include "flow.h"
+
+using namespace ESPIC;
+
+// # of cached particles generated per block
+const int nblock = 1024;
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* ------------------------------------------------------- */
+
+Flow::Flow(int dimension, const FlowDef* const & flowdef,
+           const SpeciesDef* const & specdef, const Mesh* const & mesh)
+    : Inject(flowdef->specid,
+             flowdef->ndens,
+             flowdef->temp,
+             flowdef->vel),
+      face(flowdef->face),
+      r0sq(0.),
+      drsq(0.),
+      radial(false),
+      cache_size(0),
+      cache_cursor(0),
+      cache_fill(0),
+      cache_res(0.)
+{
+  const Real bound_lo[3] = { mesh->xmin(), mesh->ymin(), mesh->zmin() };
+  const Real bound_hi[3] = { mesh->xmax(), mesh->ymax(), mesh->zmax() };
+  int iface = static_cast<int> (face);
+  bool lo_side = (0 == iface%2);
+  axis = iface/2;
+
+  if (3 != dimension && 2 == axis)
+    espic_error("Flow cannot be injected through ZLO/ZHI in 2d or axisymmetric");
+  if (5 == dimension && Mesh::BoundaryId::ylo == face)
+    espic_error("Flow cannot be injected through YLO (axis) in axisymmetric");
+
+  // inward normal tmat[0] and two tangential axes of face,
+  // (a, a+1, a+2) is right-handed for the lower face
+  for (int c = 0; c < 3; c++) {
+    tmat[0][c] = tmat[1][c] = tmat[2][c] = 0.;
+  }
+  int t1 = (axis+1)%3, t2 = (axis+2)%3;
+  tmat[0][axis] = lo_side ? 1. : -1.;
+  tmat[1][t1] = 1.;
+  tmat[2][t2] = 1.;
+
+  // corner and extent of face, no extent in z for 2d and axi
+  origin[axis] = lo_side ? bound_lo[axis] : bound_hi[axis];
+  origin[t1] = bound_lo[t1];
+  origin[t2] = bound_lo[t2];
+  length[0] = bound_hi[t1] - bound_lo[t1];
+  length[1] = bound_hi[t2] - bound_lo[t2];
+  if (3 != dimension) {
+    if (2 == t1) { origin[t1] = 0.; length[0] = 0.; }
+    if (2 == t2) { origin[t2] = 0.; length[1] = 0.; }
+  }
+
+  switch (dimension) {
+    case 2:
+      area = length[0] + length[1];   // one of them is 0 (unit length in z)
+      break;
+    case 3:
+      area = length[0]*length[1];
+      break;
+    case 5:
+      if (0 == axis) {  // disk (annulus) normal to x-axis
+        r0sq = bound_lo[1]*bound_lo[1];
+        drsq = bound_hi[1]*bound_hi[1] - r0sq;
+        radial = true;
+        area = PI*drsq;
+      }
+      else {            // cylinder at YHI
+        area = PI2*bound_hi[1]*length[1];
+      }
+      break;
+    default:
+      espic_error("Simulation must be performed in 2d, 3d or axisymmetric");
+  }
+
+  // thermal velocity
+  vth = sqrt(2.*temp/specdef->mass);
+  weight = specdef->weight;
+
+  precomputed(area);
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::gen_particles(Real dt, std::vector<Particle>& particles)
+{
+  if (cache_cursor == cache_size) {
+    init_particle_cache_arr(dt);
+    fill_particle_cache(dt);
+    cache_cursor = resume_cursor;
+    resume_cursor = 0;
+  }
+
+  inject_flow_particles(particles);
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::print() const
+{
+  const char* face_name[6] = { "xlo", "xhi", "ylo", "yhi", "zlo", "zhi" };
+
+  std::cout << "flow: " <<  "species id = " << specid
+            << ", n = " << ndens
+            << ", T = " << temp
+            << ", v = [" << vel[0]
+            << ", " << vel[1]
+            << ", " << vel[2] << "]"
+            << ", face = " << face_name[static_cast<int> (face)]
+            << ", direction =[" << tmat[0][0]
+            << ", " << tmat[0][1]
+            << ", " << tmat[0][2] << "]"
+            << ", area = " << area
+            << ", vth = " << vth
+            << ", sn = " << sn
+            << ", nflowrate = " << nflowrate << "\n";
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::x_extent(Real& xa, Real& xb) const
+{
+  xa = xb = origin[0];
+  if (0 == axis) return;
+  xb += (0 == (axis+1)%3) ? length[0] : length[1];
+}
+
+/* ------------------------------------------------------- */
+
+bool Flow::clip_x(Real xlo, Real xhi)
+{
+  if (0 == axis) return false;    // face normal to x lies in one slab
+
+  // flux scales with the extent of face along x
+  Real& len = (0 == (axis+1)%3) ? length[0] : length[1];
+  Real xa = std::max(origin[0], xlo);
+  Real xb = std::min(origin[0] + len, xhi);
+  Real lclip = std::max(xb - xa, 0.);
+  nflowrate = (len > 0.) ? nflowrate*lclip/len : 0.;
+  area = (len > 0.) ? area*lclip/len : 0.;
+  origin[0] = std::min(xa, xb);
+  len = lclip;
+  return true;
+}
+
+/* ------------------------------------------------------- */
+
+Inject::Position Flow::position() const
+{
+  // nothing drawn yet, the next fill starts from the current state
+  if (0 == cache_size) return Position{ nfill, nres, 0 };
+  return Position{ cache_fill, cache_res, cache_cursor };
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::set_position(const Position& pos)
+{
+  nfill = pos.ifill;
+  nres = pos.res;
+  resume_cursor = pos.cursor;
+  cache_size = cache_cursor = 0;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+/* ------------------------------------------------------- */
+
+void Flow::init_particle_cache_arr(Real dt)
+{
+  Real dt_weight = dt/weight;
+  Real np_inj = dt_weight*nflowrate;
+
+  cache_fill = nfill;
+  cache_res = nres;
+  key_fill();
+
+  // cache ~ 2M particles in cache_arr, same as beam
+  cache_size = static_cast<int> (std::min(2*1024.*1024./np_inj, 1000.));
+  cache_size = std::max(static_cast<int> (cache_size/10 + 0.5)*10, 1);
+  cache_count.assign(cache_size+1, 0);
+  cache_cursor = 0;
+
+  if (np_inj > 1e-3) {  // do not inject particles if np_inj too small
+    for (int istep = 0; istep < cache_size; istep++) {
+      int np_gen = static_cast<int> (np_inj + nres + rng());
+      cache_count[istep+1] = cache_count[istep]+np_gen;
+      nres += (np_inj - np_gen);
+    }
+  }
+  cache_arr.resize(cache_count[cache_size]);
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::fill_particle_cache(Real dt)
+{
+  Real vx[nblock], vy[nblock], vz[nblock], ru[3*nblock];
+  const Real r0 = sqrt(r0sq);
+  int np = cache_count[cache_size];
+
+  for (int ib = 0; ib < np; ib += nblock) {
+    int nb = std::min(nblock, np - ib);
+
+    // generate velocities for a block of particles to be injected
+    gen_vels(nb, vx, vy, vz);
+    for (int i = 0; i < 3*nb; i++) ru[i] = rng();
+
+#ifdef OMP
+#pragma omp simd
+#endif
+    for (int i = 0; i < nb; i++) {
+      // a particle has travelled a random fraction of dt into the domain
+      Real vn = vx[i]*tmat[0][0] + vy[i]*tmat[0][1] + vz[i]*tmat[0][2];
+      Real Ln = vn*ru[i]*dt;
+      Real L1 = radial ? sqrt(r0sq + drsq*ru[nb+i]) - r0 : length[0]*ru[nb+i];
+      Real L2 = length[1]*ru[2*nb+i];
+
+      Particle& particle = cache_arr[ib+i];
+      particle.x() = tmat[0][0]*Ln + tmat[1][0]*L1 + tmat[2][0]*L2 + origin[0];
+      particle.y() = tmat[0][1]*Ln + tmat[1][1]*L1 + tmat[2][1]*L2 + origin[1];
+      particle.z() = tmat[0][2]*Ln + tmat[1][2]*L1 + tmat[2][2]*L2 + origin[2];
+      particle.vx() = vx[i];
+      particle.vy() = vy[i];
+      particle.vz() = vz[i];
+    }
+  }   // end for (ib = 0; ib < np; ib += nblock)
+  nfill++;
+}
+
+/* ------------------------------------------------------- */
+
+void Flow::inject_flow_particles(std::vector<Particle>& particles)
+{
+  auto beg = cache_arr.cbegin()+cache_count[cache_cursor];
+  auto end = cache_arr.cbegin()+cache_count[cache_cursor+1];
+  particles.insert(particles.end(), beg, end);
+  cache_cursor++;
+}
+
+/* ----------------- End Private Methods ----------------- */
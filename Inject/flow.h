@@ -0,0 +1,64 @@
+#ifndef _FLOW_H
+#define _FLOW_H
+
+#include "inject.h"
+#include "../mesh.h"
+
+class FlowDef
+{
+  public:
+    // constructor
+    FlowDef(int sid, Real n, Real T, Real v[3], Mesh::BoundaryId f)
+      : specid(sid), ndens(n), temp(T), vel{v[0], v[1], v[2]}, face(f)
+        { }
+
+    int specid;
+    Real ndens;
+    Real temp;
+    Real vel[3];
+    Mesh::BoundaryId face;  // domain boundary particles flow in through
+};
+
+class Flow : public Inject
+{
+  public:
+    // constructors
+    Flow(int, const class FlowDef* const&, const class SpeciesDef* const&,
+         const class Mesh* const&);
+
+    void gen_particles(Real, std::vector<Particle>&);
+
+    void print() const;
+
+    void x_extent(Real& xa, Real& xb) const;
+    bool clip_x(Real, Real);
+
+    Mesh::BoundaryId boundary() const { return face; }
+
+    Position position() const;
+    void set_position(const Position&);
+
+  private:
+    // private methods
+    void init_particle_cache_arr(Real);
+    void fill_particle_cache(Real);
+    void inject_flow_particles(std::vector<Particle>&);
+
+    Mesh::BoundaryId face;
+    int axis;                 // axis normal to face
+    Real area;
+    Real origin[3];           // corner of face
+    Real length[2];           // extent of face along tmat[1] and tmat[2]
+    Real r0sq, drsq;          // radial extent of an axi-symmetric x face
+    bool radial;              // sample radius with uniform density in axi
+
+    // particles to be injected in the next cache_size steps
+    int cache_size;
+    int cache_cursor;
+    uint64_t cache_fill;              // fill # of the cache
+    Real cache_res;                   // residual before the fill
+    std::vector<int> cache_count;     // offset of each step in cache_arr
+    std::vector<Particle> cache_arr;
+};
+
+#endif
@@ -1,21 +1,30 @@
 #include <iostream>
+#include <algorithm>
 
 #include "../espic_info.h"
 #include "../espic_math.h"
 #include "inject.h"
 #include "beam.h"
+#include "flow.h"
 
 using namespace ESPIC;
 
 // cutoff value for particle injection
 const Real vth_max = 3.0;
 
+// # of intervals in the inverse CDF table of normal speed ratio
+const int nicdf = 4096;
+
+// # of particles whose velocities are generated in one batch
+const int nbatch = 256;
+
 /* ---------------- class InjectDef ----------------*/ 
 
 /* ------------------------------------------------------- */
 
 InjectDef::InjectDef()
-  : beamdef_arr(0)
+  : beamdef_arr(0),
+    flowdef_arr(0)
 {
 
 }
@@ -27,6 +36,10 @@ InjectDef::~InjectDef()
   for (int i = 0; i < num_beams(); i++) delete beamdef_arr[i];
   beamdef_arr.clear();
   beamdef_arr.shrink_to_fit();
+
+  for (int i = 0; i < num_flows(); i++) delete flowdef_arr[i];
+  flowdef_arr.clear();
+  flowdef_arr.shrink_to_fit();
 }
 
 void InjectDef::append(BeamDef* b)
@@ -34,6 +47,11 @@ void InjectDef::append(BeamDef* b)
   beamdef_arr.push_back(b);
 }
 
+void InjectDef::append(FlowDef* f)
+{
+  flowdef_arr.push_back(f);
+}
+
 /* ======================================================== */
 /* ======================================================== */
 
@@ -62,11 +80,42 @@ void Inject::precomputed(Real area)
   pn = 2.0/(sn + h)*exp(0.5 + 0.5*sn*(sn - h));
   nflowrate = area*calc_nflux();
 
+  init_icdf_table();
+
   return;
 }
 
 /* ------------------------------------------------------- */
 
+void Inject::init_icdf_table()
+{
+  // thermal speed ratio s normal to surface has pdf (s + sn)*exp(-s*s)
+  // on s > -sn, cut at vth_max, the cdf is G(s) - G(smin) with
+  // G(s) = -0.5*exp(-s*s) + 0.5*sqrt(pi)*sn*erf(s)
+  Real smin = std::max(-vth_max, -sn);
+  Real smax = std::max(vth_max, -sn + vth_max);  // strong counter drift
+  Real sqpi = sqrt(PI);
+  auto G = [&](Real s) { return -0.5*exp(-s*s) + 0.5*sqpi*sn*erf(s); };
+  Real g0 = G(smin), gnorm = 1./(G(smax) - g0);
+
+  icdf.resize(nicdf+1);
+  icdf[0] = smin;
+  icdf[nicdf] = smax;
+  for (int k = 1; k < nicdf; k++) {
+    // cdf is monotonic, invert by bisection
+    Real u = static_cast<Real> (k)/nicdf;
+    Real lo = icdf[k-1], hi = smax;
+    for (int it = 0; it < 60; it++) {
+      Real mid = 0.5*(lo + hi);
+      if ((G(mid) - g0)*gnorm < u) lo = mid;
+      else hi = mid;
+    }
+    icdf[k] = 0.5*(lo + hi);
+  }
+}
+
+/* ------------------------------------------------------- */
+
 Real Inject::calc_nflux()
 {
   Real nflux;
@@ -83,31 +132,53 @@ Real Inject::calc_nflux()
 
 void Inject::gen_one_vel(Real v[3])
 {
-  Real snew, f, vrf, trf, Lu, Lv, Lw;
-  Real vth_range = 2.*vth_max;
-
-  // gen thermal vel (ratio) normal to surface by acceptance-rejection
-  while(1) {
-    snew = -vth_max + vth_range*ranf();
-    if ((snew + sn) <= 0.0) continue;
-    f = pn*(snew + sn)*exp(-snew*snew);
-    if (f > ranf()) break;
-  }
+  gen_vels(1, v, v+1, v+2);
+}
+
+/* ------------------------------------------------------- */
+
+void Inject::gen_vels(int n, Real* vx, Real* vy, Real* vz)
+{
+  gen_vels(n, vx, vy, vz, rng);
+}
+
+/* ------------------------------------------------------- */
 
-  // tangential thermal vels by Box-Muller method
-//   vrf = vth*sqrt(-log(ranf() + SMALLREAL));
-  vrf = vth*ranf.normal_dist_factor();
-  trf = PI2*ranf();
-
-  // thermal velocity in the surface coordinate system
-  Lu = snew*vth;        // normal component
-  Lv = vrf*cos(trf);    // tangential components
-  Lw = vrf*sin(trf);
-    
-  // convert v in the surface coordinate system back to the Cartesian system
-  v[0] = tmat[0][0]*Lu + tmat[1][0]*Lv + tmat[2][0]*Lw + vel[0];
-  v[1] = tmat[0][1]*Lu + tmat[1][1]*Lv + tmat[2][1]*Lw + vel[1];
-  v[2] = tmat[0][2]*Lu + tmat[1][2]*Lv + tmat[2][2]*Lw + vel[2];
+void Inject::gen_vels(int n, Real* vx, Real* vy, Real* vz, 
+                      const Random& rnd) const
+{
+  Real ru[3*nbatch];
+  const Real* ticdf = icdf.data();
+
+  for (int ib = 0; ib < n; ib += nbatch) {
+    int nb = std::min(nbatch, n - ib);
+    for (int i = 0; i < 3*nb; i++) ru[i] = rnd();
+
+    // the loop below has no branch or call besides math functions
+#ifdef OMP
+#pragma omp simd
+#endif
+    for (int i = 0; i < nb; i++) {
+      // thermal vel (ratio) normal to surface from inverse CDF table
+      Real s = ru[i]*nicdf;
+      int k = std::min(static_cast<int> (s), nicdf-1);
+      Real snew = ticdf[k] + (s - k)*(ticdf[k+1] - ticdf[k]);
+
+      // tangential thermal vels by Box-Muller method
+      Real vrf = vth*sqrt(-log(1. - ru[nb+i]));
+      Real trf = PI2*ru[2*nb+i];
+
+      // thermal velocity in the surface coordinate system
+      Real Lu = snew*vth;       // normal component
+      Real Lv = vrf*cos(trf);   // tangential components
+      Real Lw = vrf*sin(trf);
+
+      // convert v in the surface coordinate system back to the Cartesian system
+      vx[ib+i] = tmat[0][0]*Lu + tmat[1][0]*Lv + tmat[2][0]*Lw + vel[0];
+      vy[ib+i] = tmat[0][1]*Lu + tmat[1][1]*Lv + tmat[2][1]*Lw + vel[1];
+      vz[ib+i] = tmat[0][2]*Lu + tmat[1][2]*Lv + tmat[2][2]*Lw + vel[2];
+    }
+  }
 }
 
 /* ----------------- End Protected Methods ----------------- */
\ No newline at end of file
@@ -15,14 +15,15 @@ class InjectDef {
 
     // public methods
     int num_beams() const { return static_cast<int> (beamdef_arr.size()); }
+    int num_flows() const { return static_cast<int> (flowdef_arr.size()); }
 
     void append(class BeamDef* b);
 
-//     void append(class FlowDef* f);
+    void append(class FlowDef* f);
 
     // members
     std::vector<class BeamDef*> beamdef_arr;
-//     std::vector<class FlowDef*> flowdef_arr;
+    std::vector<class FlowDef*> flowdef_arr;
 
   private:
 
@@ -34,10 +35,12 @@ class Inject {  // base for particle injection
   public:
     // constructors
     Inject()
-      : specid(0), ndens(0), temp(0), vel {0, 0, 0} { }
+      : specid(0), ndens(0), temp(0), vel {0, 0, 0}, nres(0.),
+        rng_stream(rng.get_state()), nfill(0), resume_cursor(0) { }
 
     Inject(const int sid, const Real n, const Real T, const Real v[3], Real nr=0.)
-      : specid(sid), ndens(n), temp(T), vel {v[0], v[1], v[2]} , nres(nr) { }
+      : specid(sid), ndens(n), temp(T), vel {v[0], v[1], v[2]} , nres(nr),
+        rng_stream(rng.get_state()), nfill(0), resume_cursor(0) { }
 
     // desctructor
     virtual ~Inject() { }
@@ -46,8 +49,38 @@ class Inject {  // base for particle injection
 
     virtual void print() const = 0;
 
+    // x-range particles are placed in before they move into the domain
+    virtual void x_extent(Real& xa, Real& xb) const = 0;
+
+    // inject through the part of the face within [xlo, xhi] along x
+    // only, return false if the injection cannot be split along x
+    virtual bool clip_x(Real, Real) { return false; }
+
     int species() { return specid; }
 
+    // key own generator by the index of the injection (beams first,
+    // then flows), not by construction order or # of threads
+    void set_stream(uint64_t id) {
+      rng.set_key(0, ESPIC::Random::inject_stream, id);
+      rng_stream = rng.get_state();
+    }
+
+    // position in the injection sequence, kept in checkpoints: each
+    // cache fill draws from a stream keyed by (fill #, stream), so the
+    // cache being drained is regenerated on restart from its fill #, the
+    // residual before it was drawn and the # of steps taken from it
+    class Position {
+      public:
+        uint64_t ifill;
+        Real res;
+        int cursor;
+    };
+
+    virtual Position position() const = 0;
+
+    // the cache is regenerated at the next gen_particles()
+    virtual void set_position(const Position&) = 0;
+
   protected:
     int specid;         // species id
     Real ndens;         // number density
@@ -60,16 +93,32 @@ class Inject {  // base for particle injection
     Real nflowrate;     // particle number flow rate
     Real nres;          // residual of injected particle
     Real tmat[3][3];    // transformation matrix
+    ESPIC::Random rng;  // own generator, particles may be generated
+                        // on a worker thread
+    uint64_t rng_stream;  // key of cache fills, set with rng
+    uint64_t nfill;       // # of cache fills drawn
+    int resume_cursor;    // steps to skip in the next fill (restart)
+    std::vector<Real> icdf; // inverse CDF table of normal speed ratio
 
     // preform some pre-computation for part injection
     void precomputed(Real);
 
+    // start the stream of the next cache fill
+    void key_fill() { rng.set_key(nfill, rng_stream, ~0ULL); }
+
     // calculate number flux density
     Real calc_nflux();
     
+    // tabulate inverse CDF of flux-weighted normal speed ratio
+    void init_icdf_table();
+
     // generate velocity for one part to be injected
     void gen_one_vel(Real v[3]);
 
+    // generate velocities for n parts to be injected in batches
+    void gen_vels(int n, Real* vx, Real* vy, Real* vz);
+    void gen_vels(int n, Real* vx, Real* vy, Real* vz, const ESPIC::Random&) const;
+
 };
 
 #endif
@@ -1,35 +1,79 @@
 
+#include <algorithm>
 #include "conductor.h"
 
+#ifdef OMP
+#include <omp.h>
+#endif
+
 int Object::current_id = 0;
 
 /* ---------------- Begin Public Methods ---------------- */
 
-void Conductor::lostparticles_increment(int nspecies,
-                                        Real curr_time)
+void Conductor::init_lost_particles(int nspec, int nthrd, int nsamples)
 {
-  if (lostparticles.back().is_used()) {
-    lostparticles.push_back(LostParticleInfo(nspecies, curr_time));
-  }
-  else  {
-    lostparticles.back().time = curr_time;
+  nspecies = nspec;
+  nthreads = nthrd;
+  lost_tally.assign(nthreads*nspecies, LostParticleTally());
+
+  lost_head = -1;
+  lost_nsamples = 0;
+  lost_time.assign(nsamples, 0.);
+  lost_count.assign(nsamples*nspecies, 0);
+  lost_charge.assign(nsamples*nspecies, 0.);
+  lost_energy.assign(nsamples*nspecies, 0.);
+}
+
+/* ------------------------------------------------------- */
+
+void Conductor::reduce_lost_particles(Real curr_time)
+{
+  if (lost_tally.empty()) return;
+
+  int nslots = static_cast<int> (lost_time.size());
+  lost_head = (lost_head + 1) % nslots;
+  lost_nsamples = std::min(lost_nsamples + 1, nslots);
+  lost_time[lost_head] = curr_time;
+
+  Real dcharge = 0.;
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    Bigint count = 0;
+    Real q = 0., en = 0.;
+    for (int ithrd = 0; ithrd < nthreads; ithrd++) {
+      LostParticleTally& tally = lost_tally[ithrd*nspecies + ispec];
+      count += tally.count;
+      q += tally.charge;
+      en += tally.energy;
+      tally = LostParticleTally();
+    }
+    lost_count[lost_head*nspecies + ispec] = count;
+    lost_charge[lost_head*nspecies + ispec] = q;
+    lost_energy[lost_head*nspecies + ispec] = en;
+    dcharge += q;
   }
+
+  // floating conductor collects charges of the particles it scraped
+  if (!is_fixed_potential()) charge += dcharge;
 }
 
 /* ------------------------------------------------------- */
 
 bool Conductor::scrape_particle(int spec_id,
-                                Real curr_time,
+                                Real q,
+                                Real en,
                                 const Vector3& pos_old,
                                 const Vector3& pos_new)
 {
   bool is_scraped = intersect(pos_old, pos_new);
-  if (is_lost_particles_statistics_on()) {
-    if (is_scraped) {
-      lostparticles.back().add_one_lost(spec_id);
-    }
+  if (is_scraped && !lost_tally.empty()) {
+    int ithrd = 0;
+#ifdef OMP
+    ithrd = omp_get_thread_num();
+#endif
+    lost_tally[ithrd*nspecies + spec_id].add_one_lost(q, en);
   }
   return is_scraped;
 }
 
 /* ----------------- End Public Methods ----------------- */
+
@@ -9,22 +9,29 @@ class Conductor : public Object {
   public:
     // constructors
     explicit Conductor(int _id = -1, int _type = 1, Real _epsilon = 1., Real _phi = 0., int lparticles = 0, bool is_rf = false)
-      : Object(_id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf)
+      : Object(_id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf),
+        nspecies(0), nthreads(0), lost_head(-1), lost_nsamples(0)
     { }
 
     Conductor(Real c[3], int _id = -1, int _type = 1, Real _epsilon = 1., Real _phi = 0., int lparticles = 0, bool is_rf = false)
-      : Object(c, _id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf)
+      : Object(c, _id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf),
+        nspecies(0), nthreads(0), lost_head(-1), lost_nsamples(0)
     { }
       
     Conductor(const Vector3& c, int _id = -1, int _type = 1, Real _epsilon = 1., Real _phi = 0., int lparticles = 0, bool is_rf = false)
-      : Object(c, _id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf)
+      : Object(c, _id), type(_type), flag_collectlp(lparticles), epsilon(_epsilon), phi(_phi), charge(0.), rf(is_rf),
+        nspecies(0), nthreads(0), lost_head(-1), lost_nsamples(0)
     { }
       
     // copy constructors
     Conductor(const Conductor& orig)
       : Object(orig), type(orig.type), flag_collectlp(orig.flag_collectlp),
-        epsilon(orig.epsilon), phi(orig.phi), charge(orig.charge),
-        lostparticles(orig.lostparticles)
+        epsilon(orig.epsilon), phi(orig.phi), charge(orig.charge), rf(orig.rf),
+        nspecies(orig.nspecies), nthreads(orig.nthreads),
+        lost_tally(orig.lost_tally), lost_head(orig.lost_head),
+        lost_nsamples(orig.lost_nsamples), lost_time(orig.lost_time),
+        lost_count(orig.lost_count), lost_charge(orig.lost_charge),
+        lost_energy(orig.lost_energy)
     { }
 
     // desctructor
@@ -37,7 +44,33 @@ class Conductor : public Object {
 
     bool is_lost_particles_statistics_on() const { return flag_collectlp == 1; }
 
-    void lostparticles_increment(int, Real);
+    // lost particles are tallied if requested or to collect floating charge
+    bool is_collecting_lost_particles() const {
+      return is_lost_particles_statistics_on() || !is_fixed_potential();
+    }
+
+    // allocate per-thread tallies and ring buffer of time samples
+    void init_lost_particles(int nspec, int nthrd, int nsamples = 1024);
+
+    // reduce per-thread tallies into a new time sample
+    void reduce_lost_particles(Real);
+
+    // # of time samples stored, sample 0 is the latest
+    int num_lost_samples() const { return lost_nsamples; }
+
+    Real lost_sample_time(int i) const { return lost_time[sample_index(i)]; }
+
+    Bigint lost_sample_count(int i, int spec_id) const { 
+      return lost_count[sample_index(i)*nspecies + spec_id];
+    }
+
+    Real lost_sample_charge(int i, int spec_id) const {
+      return lost_charge[sample_index(i)*nspecies + spec_id];
+    }
+
+    Real lost_sample_energy(int i, int spec_id) const {
+      return lost_energy[sample_index(i)*nspecies + spec_id];
+    }
 
     Real get_epsilon() const { return epsilon; }
 
@@ -56,27 +89,29 @@ class Conductor : public Object {
     virtual bool intersect(const Vector3&, const Vector3&) const = 0;
     virtual bool intersect(const Vector3&, const Vector3&,
                            std::vector<Vector3>&) const = 0;
+    // segment parameter t in [0, 1] of the first hit (0 if the
+    // segment starts inside)
+    virtual bool intersect(const Vector3&, const Vector3&, Real&) const = 0;
+
+    // axis-aligned bounding box (lo, hi) enclosing this object
+    virtual void bounding_box(Vector3&, Vector3&) const = 0;
 
-    bool scrape_particle(int, Real, const Vector3&, const Vector3&);
+    // (spec_id, charge, energy, pos_old, pos_new) of a particle,
+    // safe to call concurrently from different threads
+    bool scrape_particle(int, Real, Real, const Vector3&, const Vector3&);
 
   protected:
-    class LostParticleInfo {
+    // lost particles of one species tallied by one thread,
+    // one cache line each so threads never share a line
+    class alignas(64) LostParticleTally {
       public:
-        LostParticleInfo(int nspecies, Real t)
-          : time(t), num_lostparticles(nspecies)
-        { }
+        LostParticleTally() : count(0), charge(0.), energy(0.) { }
 
-      bool is_used() const {
-        bool is_used = false;
-        for (auto it = num_lostparticles.cbegin(); !is_used && it != num_lostparticles.cend(); ++it)
-          is_used = *it > 0;
-        return is_used;
-      }
+        void add_one_lost(Real q, Real en) { ++count; charge += q; energy += en; }
 
-      void add_one_lost(int spec_id) { ++num_lostparticles[spec_id]; }
-
-      Real time;
-      std::vector<Bigint> num_lostparticles;
+        Bigint count;
+        Real charge;
+        Real energy;
     };
 
     int type;               // 0 - virtual, (fixed phi)
@@ -87,9 +122,23 @@ class Conductor : public Object {
     Real epsilon;           // relative permittivity
     Real phi;               // potential
     Real charge;
-    std::vector<LostParticleInfo> lostparticles;
     bool rf;                // true if rf is rf_source
 
+    int nspecies;
+    int nthreads;
+    std::vector<LostParticleTally> lost_tally;  // [thread][species]
+    int lost_head;                              // slot of latest sample
+    int lost_nsamples;                          // # of samples stored
+    std::vector<Real> lost_time;                // [sample]
+    std::vector<Bigint> lost_count;             // [sample][species]
+    std::vector<Real> lost_charge;              // [sample][species]
+    std::vector<Real> lost_energy;              // [sample][species]
+
+    int sample_index(int i) const {
+      int nslots = static_cast<int> (lost_time.size());
+      return (lost_head - i + nslots) % nslots;
+    }
+
     // private methods
     void accumulate_charge(std::vector<class Species*>&);
 };
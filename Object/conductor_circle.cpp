@@ -28,9 +28,13 @@ bool ConductorCircle::intersect(const Vector3& pbeg,
                                 const Vector3& pend,
                                 std::vector<Vector3>& pintsec) const
 {
-  bool is_intersected = false;
+  Real t;
+  if (!entry_param(pbeg, pend, t)) return false;
 
-  return is_intersected;
+  Real dx = pend[0]-pbeg[0], dy = pend[1]-pbeg[1];
+  pintsec.push_back({ pbeg[0] + t*dx, pbeg[1] + t*dy, pbeg[2] });
+
+  return true;
 }
 
 
@@ -39,10 +43,59 @@ bool ConductorCircle::intersect(const Vector3& pbeg,
 bool ConductorCircle::intersect(const Vector3& pbeg,
                                 const Vector3& pend) const
 {
-  std::vector<Vector3> pintsec;
-  return intersect(pbeg, pend, pintsec);
+  Real t;
+  return entry_param(pbeg, pend, t);
+}
+
+/* ------------------------------------------------------- */
+
+bool ConductorCircle::intersect(const Vector3& pbeg,
+                                const Vector3& pend,
+                                Real& t) const
+{
+  return entry_param(pbeg, pend, t);
+}
+
+/* ------------------------------------------------------- */
+
+void ConductorCircle::bounding_box(Vector3& lo, Vector3& hi) const
+{
+  lo = { center[0]-radius, center[1]-radius, center[2] };
+  hi = { center[0]+radius, center[1]+radius, center[2] };
 }
 
 
 
 /* ---------------- End Public Methods ---------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+/* ------------------------------------------------------- */
+
+bool ConductorCircle::entry_param(const Vector3& pbeg,
+                                  const Vector3& pend,
+                                  Real& t) const
+{
+  // circle only for 2D, solve |pbeg + t*(pend-pbeg) - center| = radius
+  Real dx = pend[0]-pbeg[0], dy = pend[1]-pbeg[1];
+  Real fx = pbeg[0]-center[0], fy = pbeg[1]-center[1];
+  Real a = dx*dx + dy*dy;
+  Real b = 2.*(fx*dx + fy*dy);
+  Real c = fx*fx + fy*fy - radius*radius;
+
+  if (c <= 0.) {  // pbeg is already inside
+    t = 0.;
+    return true;
+  }
+  if (a == 0.) return false;
+
+  Real disc = b*b - 4.*a*c;
+  if (disc < 0.) return false;
+
+  // pbeg is outside, so the smaller root is the entry point
+  t = (-b - sqrt(disc))/(2.*a);
+
+  return t >= 0. && t <= 1.;
+}
+
+/* ---------------- End Private Methods ---------------- */
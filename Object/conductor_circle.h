@@ -38,9 +38,16 @@ class ConductorCircle : public Conductor
     // a line segment (defined by two points) and object
     virtual bool intersect(const Vector3&, const Vector3&) const;
     virtual bool intersect(const Vector3&, const Vector3&, std::vector<Vector3>&) const;
+    virtual bool intersect(const Vector3&, const Vector3&, Real&) const;
+
+    // axis-aligned bounding box (lo, hi) enclosing this object
+    virtual void bounding_box(Vector3&, Vector3&) const;
 
   private:
     Real radius;
+
+    // segment parameter t in [0, 1] where the segment enters the circle
+    bool entry_param(const Vector3&, const Vector3&, Real&) const;
 };
 
 #endif
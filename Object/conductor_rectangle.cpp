@@ -1,5 +1,6 @@
 
 #include "conductor_rectangle.h"
+#include <algorithm>
 
 
 /* ---------------- Begin Public Methods ---------------- */
@@ -27,9 +28,17 @@ bool ConductorRectangle::intersect(const Vector3& pbeg,
                                    const Vector3& pend,
                                    std::vector<Vector3>& pintsec) const
 {
-  bool is_intersected = false;
+  Real tmin, tmax;
+  if (!clip_segment(pbeg, pend, tmin, tmax)) return false;
 
-  return is_intersected;
+  // entry point (pbeg itself if it is already inside) and exit point
+  Real dx = pend[0]-pbeg[0], dy = pend[1]-pbeg[1];
+  pintsec.push_back({ pbeg[0] + tmin*dx, pbeg[1] + tmin*dy, pbeg[2] });
+  if (tmax < 1. && tmax > tmin) {
+    pintsec.push_back({ pbeg[0] + tmax*dx, pbeg[1] + tmax*dy, pbeg[2] });
+  }
+
+  return true;
 }
 
 
@@ -38,10 +47,62 @@ bool ConductorRectangle::intersect(const Vector3& pbeg,
 bool ConductorRectangle::intersect(const Vector3& pbeg,
                                    const Vector3& pend) const
 {
-  std::vector<Vector3> pintsec;
-  return intersect(pbeg, pend, pintsec);
+  Real tmin, tmax;
+  return clip_segment(pbeg, pend, tmin, tmax);
+}
+
+/* ------------------------------------------------------- */
+
+bool ConductorRectangle::intersect(const Vector3& pbeg,
+                                   const Vector3& pend,
+                                   Real& t) const
+{
+  Real tmax;
+  return clip_segment(pbeg, pend, t, tmax);
+}
+
+/* ------------------------------------------------------- */
+
+void ConductorRectangle::bounding_box(Vector3& lo, Vector3& hi) const
+{
+  lo = blo;
+  hi = bhi;
 }
 
 
 
 /* ---------------- End Public Methods ---------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+/* ------------------------------------------------------- */
+
+bool ConductorRectangle::clip_segment(const Vector3& pbeg,
+                                      const Vector3& pend,
+                                      Real& tmin, Real& tmax) const
+{
+  // rectangle only for 2D, clip segment against [blo, bhi] (Liang-Barsky)
+  Real d[2] = { pend[0]-pbeg[0], pend[1]-pbeg[1] };
+  tmin = 0.;
+  tmax = 1.;
+
+  for (int a = 0; a < 2; a++) {
+    if (d[a] == 0.) {
+      // parallel to this pair of edges, must lie between them
+      if (pbeg[a] < blo[a] || pbeg[a] > bhi[a]) return false;
+    }
+    else {
+      Real dinv = 1./d[a];
+      Real t0 = (blo[a] - pbeg[a])*dinv;
+      Real t1 = (bhi[a] - pbeg[a])*dinv;
+      if (t0 > t1) std::swap(t0, t1);
+      tmin = std::max(tmin, t0);
+      tmax = std::min(tmax, t1);
+      if (tmin > tmax) return false;
+    }
+  }
+
+  return true;
+}
+
+/* ---------------- End Private Methods ---------------- */
@@ -8,7 +8,7 @@ class ConductorRectangleDef
   public:
     ConductorRectangleDef()
       : id(-1), type(1), flag_collectlp(0),
-        epsilon(1.), phi(0.), charge(0.)
+        epsilon(1.), phi(0.), charge(0.), rf(false)
     { }
 
     int id;
@@ -41,10 +41,17 @@ class ConductorRectangle : public Conductor
     // a line segment (defined by two points) and object
     virtual bool intersect(const Vector3&, const Vector3&) const;
     virtual bool intersect(const Vector3&, const Vector3&, std::vector<Vector3>&) const;
+    virtual bool intersect(const Vector3&, const Vector3&, Real&) const;
+
+    // axis-aligned bounding box (lo, hi) enclosing this object
+    virtual void bounding_box(Vector3&, Vector3&) const;
 
   private:
     Vector3 blo;    // boundary lo
     Vector3 bhi;    // boundary hi
+
+    // parametric range [tmin, tmax] of segment inside the rectangle
+    bool clip_segment(const Vector3&, const Vector3&, Real&, Real&) const;
 };
 
 #endif
@@ -47,6 +47,12 @@ class Object {
     virtual bool intersect(const Vector3&, const Vector3&) const = 0;
     virtual bool intersect(const Vector3&, const Vector3&,
                            std::vector<Vector3>&) const = 0;
+    // segment parameter t in [0, 1] of the first hit (0 if the
+    // segment starts inside)
+    virtual bool intersect(const Vector3&, const Vector3&, Real&) const = 0;
+
+    // axis-aligned bounding box (lo, hi) enclosing this object
+    virtual void bounding_box(Vector3&, Vector3&) const = 0;
 
   protected:
     static int current_id;
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 
 #include "espic_info.h"
@@ -7,10 +8,17 @@
 #include "species.h"
 #include "particles.h"
 
+#ifdef OMP
+#include <omp.h>
+#endif
+
 ESPIC::Random ranf;
 
 using namespace ESPIC;
 
+// # of particles loaded per block by one thread
+const int nblock = 256;
+
 /* ---------------- Begin Public Methods ---------------- */
 
 /* Constructor */
@@ -22,6 +30,11 @@ Ambient::Ambient(int dimension, const AmbientDef* const & ambdef, const SpeciesD
     weight (specdef->weight),
     bound_lo {ambdef->bound_lo[0], ambdef->bound_lo[1], ambdef->bound_lo[2]},
     bound_hi {ambdef->bound_hi[0], ambdef->bound_hi[1], ambdef->bound_hi[2]},
+    quiet (ambdef->quiet),
+    halton (6, static_cast<unsigned> (ranf()*4294967295.)),
+    rng_stream (ranf.get_state()),
+    qs_index (0),
+    window {std::numeric_limits<Real>::lowest(), std::numeric_limits<Real>::max()},
     ptr_gen_ambient(nullptr)
 {
   switch (dimension) {
@@ -37,6 +50,12 @@ Ambient::Ambient(int dimension, const AmbientDef* const & ambdef, const SpeciesD
     default:
       espic_error("Simulation must be performed in 2d, 3d or axisymmetric");
   }
+
+  int nthreads = 1;
+#ifdef OMP
+  nthreads = omp_get_max_threads();
+#endif
+  rng_arr.resize(nthreads);
 }
 
 /* ------------------------------------------------------- */
@@ -48,32 +67,27 @@ void Ambient::gen_ambient(int nc[3], Real bound_lo[3], Real bound_hi[3], Real dx
 
 void Ambient::gen_ambient_0d(Bigint np, Particles* &particles)
 {
-  // Bigint np = 10000;
-  Particles::size_type nparts, ipart;
+  Particles::size_type nparts = static_cast<Particles::size_type>(np);
   Real x_dim = (bound_hi[0]-bound_lo[0]), y_dim = (bound_hi[1]-bound_lo[1]);
-  std::vector<Real> x(np), vx(np);
-  std::vector<Real> y(np), vy(np);
-  std::vector<Real> z(np), vz(np);
-  Real vrf, trf;
-
-  nparts = static_cast<Particles::size_type>(np);
-  for (ipart = 0; ipart < nparts; ++ipart){
-    x[ipart] = bound_lo[0] + ranf()*x_dim;
-    y[ipart] = bound_lo[1] + ranf()*y_dim;
-    z[ipart] = 0.;
-  }
+  const Real xlo = bound_lo[0], ylo = bound_lo[1];
 
-  for (ipart = 0; ipart < nparts; ipart++) {
-    vrf = vth*ranf.normal_dist_factor();
-    trf = PI2*ranf();
-    vx[ipart] = vrf*cos(trf) + vel[0];
-    vy[ipart] = vrf*sin(trf) + vel[1];
+  const Real vsd = vth*sqrt(0.5);   // spread of each velocity component
+  load_particles(nparts, xlo, x_dim, 1, 2, 3, particles, 
+    [&](int nb, const Real* ru, const Real* rn, Particle* pblk) {
+#ifdef OMP
+#pragma omp simd
+#endif
+      for (int i = 0; i < nb; i++) {
+        Particle& particle = pblk[i];
+        particle.x() = xlo + ru[i]*x_dim;
+        particle.y() = ylo + ru[nb+i]*y_dim;
+        particle.z() = 0.;
 
-    vrf = vth * ranf.normal_dist_factor();
-    trf = PI2*ranf();
-    vz[ipart] = vrf*cos(trf) + vel[2];
-  }
-  particles->append(Particles(x, y, z, vx, vy, vz));
+        particle.vx() = vsd*rn[i] + vel[0];
+        particle.vy() = vsd*rn[nb+i] + vel[1];
+        particle.vz() = vsd*rn[2*nb+i] + vel[2];
+      }
+    });
 }
 
 
@@ -84,38 +98,159 @@ void Ambient::gen_ambient_0d(Bigint np, Particles* &particles)
 
 /* ------------------------------------------------------- */
 
+template<class BlockFn>
+void Ambient::load_particles(std::size_t nparts, Real xlo, Real x_dim, Index ncol,
+                             int npos, int nvel, Particles* &particles, BlockFn fill_block)
+{
+  if (nparts == 0) return;
+  const uint64_t iseq = qs_index;
+  qs_index += nparts;
+
+  // particles [first(c), first(c+1)) lie in column c, columns meeting
+  // the window are loaded
+  auto first = [nparts, ncol](Index c) {
+    return static_cast<uint64_t> (nparts)*c/ncol;
+  };
+  const Real colw = x_dim/ncol;
+  Index cbeg = 0, cend = ncol;
+  if (window[0] > xlo)
+    cbeg = static_cast<Index> (std::min<Real>(floor((window[0] - xlo)/colw), ncol));
+  if (window[1] < xlo + x_dim)
+    cend = static_cast<Index> (std::max<Real>(ceil((window[1] - xlo)/colw), 0.));
+  if (cend <= cbeg) return;
+
+  // blocks do not span columns
+  std::vector<std::pair<Index, uint64_t>> blk_arr;
+  for (Index c = cbeg; c < cend; c++)
+    for (uint64_t ip = first(c); ip < first(c+1); ip += nblock)
+      blk_arr.emplace_back(c, ip);
+
+  // final storage is grown once and filled in place
+  const uint64_t ioff = first(cbeg);
+  Particles::size_type ibeg = particles->grow(first(cend) - ioff);
+
+  // each thread fills a disjoint range of blocks, a block of nb particles
+  // takes npos*nb uniform numbers for positions and nvel*nb normal numbers
+  // for velocities, drawn from a stream keyed by the index of its first
+  // particle (independent of the # of threads and of the window) or, for
+  // quiet start, from the points of the low-discrepancy sequence matching
+  // particle index
+  int nthreads = static_cast<int> (rng_arr.size());
+  const std::size_t nblocks = blk_arr.size();
+#ifdef OMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+#endif
+  for (int ithrd = 0; ithrd < nthreads; ithrd++) {
+    const Random& rnd = rng_arr[ithrd];
+    std::size_t bbeg = nblocks*ithrd/nthreads;
+    std::size_t bend = nblocks*(ithrd+1)/nthreads;
+    std::vector<Real> ru(npos*nblock);
+    std::vector<Real> rn(nvel*nblock + 1);
+    std::vector<Particle> pblk(nblock);     // a block may span two chunks
+
+    for (std::size_t iblk = bbeg; iblk < bend; iblk++) {
+      const Index icol = blk_arr[iblk].first;
+      const uint64_t ib = blk_arr[iblk].second;
+      int nb = static_cast<int> (std::min<uint64_t>(nblock, first(icol+1) - ib));
+      if (quiet) {
+        // sequence starts from point 1, point 0 lies on the corner
+        for (int i = 0; i < nb; i++) {
+          uint64_t iq = iseq + ib + i + 1;
+          for (int d = 0; d < npos; d++) ru[d*nb+i] = halton(iq, d);
+          for (int c = 0; c < nvel; c++)
+            rn[c*nb+i] = inv_normal_cdf(halton(iq, npos+c));
+        }
+      }
+      else {
+        rnd.set_key(0, rng_stream, iseq + ib);
+        for (int i = 0; i < npos*nb; i++) ru[i] = rnd();
+        // Box-Muller gives normal numbers in pairs
+        for (int i = 0; i < nvel*nb; i += 2) {
+          Real vrf = sqrt(-2.*log(1. - rnd()));
+          Real trf = PI2*rnd();
+          rn[i] = vrf*cos(trf);
+          rn[i+1] = vrf*sin(trf);
+        }
+      }
+      // x within the column
+      for (int i = 0; i < nb; i++) ru[i] = (icol + ru[i])/ncol;
+
+      const Particles::size_type i0 = ibeg + (ib - ioff), i1 = i0 + nb - 1;
+      if ((i0 >> ParticlePool::chunk_shift) == (i1 >> ParticlePool::chunk_shift))
+        fill_block(nb, ru.data(), rn.data(), &(*particles)[i0]);
+      else {
+        for (int i = 0; i < nb; i++) pblk[i] = (*particles)[i0+i];
+        fill_block(nb, ru.data(), rn.data(), pblk.data());
+        for (int i = 0; i < nb; i++) (*particles)[i0+i] = pblk[i];
+      }
+    }
+  }   // end for (ithrd = 0; ithrd < nthreads; ithrd++)
+}
+
+/* ------------------------------------------------------- */
+
 void Ambient::gen_ambient_2d(int nc[3], Real bound_lo[3], Real bound_hi[3], Real dx[3], Particles* &particles)
 {
   Real fparts;
-  Particles::size_type nparts, ipart;
+  Particles::size_type nparts;
   Real x_dim = (bound_hi[0] - bound_lo[0]), y_dim = (bound_hi[1]-bound_lo[1]);
-  Real vrf, trf;
+  const Real xlo = bound_lo[0], ylo = bound_lo[1];
 
   fparts = ndens*x_dim*y_dim/weight;
   if (fparts <= 0.) return;
 
   nparts = static_cast<Particles::size_type>(fparts + ranf());
-  std::vector<Real> x(nparts), y(nparts), z(nparts), vx(nparts), vy(nparts), vz(nparts);
-  for (ipart = 0; ipart < nparts; ipart++) {
-    x[ipart] = bound_lo[0] + ranf()*x_dim;
-    y[ipart] = bound_lo[1] + ranf()*y_dim;
-  }
-
-  for (ipart = 0; ipart < nparts; ipart++) {
-//     vrf = vth*sqrt(-log(ranf() + SMALLREAL));
-    vrf = vth*ranf.normal_dist_factor();
-    trf = PI2*ranf();
-    vx[ipart] = vrf*cos(trf) + vel[0];
-    vy[ipart] = vrf*sin(trf) + vel[1];
-  }
+  const Real vsd = vth*sqrt(0.5);   // spread of each velocity component
+  const Index ncol = std::max(static_cast<Index> (x_dim/dx[0] + 0.5), 1);
+  load_particles(nparts, xlo, x_dim, ncol, 2, 2, particles, 
+    [&](int nb, const Real* ru, const Real* rn, Particle* pblk) {
+#ifdef OMP
+#pragma omp simd
+#endif
+      for (int i = 0; i < nb; i++) {
+        Particle& particle = pblk[i];
+        particle.x() = xlo + ru[i]*x_dim;
+        particle.y() = ylo + ru[nb+i]*y_dim;
 
-  particles->append(Particles(x, y, z, vx, vy, vz));
+        particle.vx() = vsd*rn[i] + vel[0];
+        particle.vy() = vsd*rn[nb+i] + vel[1];
+      }
+    });
 }
 
 /* ------------------------------------------------------- */
 
 void Ambient::gen_ambient_3d(int nc[3], Real bound_lo[3], Real bound_hi[3], Real dx[3], Particles* &particles)
 {
+  Real fparts;
+  Particles::size_type nparts;
+  Real x_dim = (bound_hi[0] - bound_lo[0]);
+  Real y_dim = (bound_hi[1] - bound_lo[1]);
+  Real z_dim = (bound_hi[2] - bound_lo[2]);
+  const Real xlo = bound_lo[0], ylo = bound_lo[1], zlo = bound_lo[2];
+
+  fparts = ndens*x_dim*y_dim*z_dim/weight;
+  if (fparts <= 0.) return;
+
+  nparts = static_cast<Particles::size_type>(fparts + ranf());
+  const Real vsd = vth*sqrt(0.5);   // spread of each velocity component
+  const Index ncol = std::max(static_cast<Index> (x_dim/dx[0] + 0.5), 1);
+  load_particles(nparts, xlo, x_dim, ncol, 3, 3, particles, 
+    [&](int nb, const Real* ru, const Real* rn, Particle* pblk) {
+#ifdef OMP
+#pragma omp simd
+#endif
+      for (int i = 0; i < nb; i++) {
+        Particle& particle = pblk[i];
+        particle.x() = xlo + ru[i]*x_dim;
+        particle.y() = ylo + ru[nb+i]*y_dim;
+        particle.z() = zlo + ru[2*nb+i]*z_dim;
+
+        particle.vx() = vsd*rn[i] + vel[0];
+        particle.vy() = vsd*rn[nb+i] + vel[1];
+        particle.vz() = vsd*rn[2*nb+i] + vel[2];
+      }
+    });
 }
 
 /* ------------------------------------------------------- */
@@ -123,36 +258,33 @@ void Ambient::gen_ambient_3d(int nc[3], Real bound_lo[3], Real bound_hi[3], Real
 void Ambient::gen_ambient_axi(int nc[3], Real bound_lo[3], Real bound_hi[3], Real dx[3], Particles* &particles)
 {
   Real fparts;
-  Particles::size_type nparts, ipart;
+  Particles::size_type nparts;
   Real x_dim = (bound_hi[0] - bound_lo[0]);
   Real r0sq = bound_lo[1]*bound_lo[1];
   Real r1sq = bound_hi[1]*bound_hi[1];
   Real drsq = r1sq - r0sq;
-  Real vrf, trf;
+  const Real xlo = bound_lo[0];
 
   fparts = PI*ndens*x_dim*drsq/weight;
   if (fparts <= 0.) return;
 
   nparts = static_cast<Particles::size_type>(fparts + ranf());
-  std::vector<Real> x(nparts), y(nparts), z(nparts, 0), vx(nparts), vy(nparts), vz(nparts, 0);
-  for (ipart = 0; ipart < nparts; ipart++) {
-    x[ipart] = bound_lo[0] + ranf()*x_dim;
-    y[ipart] = sqrt(r0sq + drsq*ranf());
-  }
-
-  for (ipart = 0; ipart < nparts; ipart++) {
-//     vrf = vth*sqrt(-log(ranf() + SMALLREAL));
-    vrf = vth*ranf.normal_dist_factor();
-    trf = PI2*ranf();
-    vx[ipart] = vrf*cos(trf) + vel[0];
-    vy[ipart] = vrf*sin(trf) + vel[1];
-
-//     vrf = vth*sqrt(-log(ranf() + SMALLREAL));
-    vrf = vth*ranf.normal_dist_factor();
-    trf = PI2*ranf();
-    vz[ipart] = vrf*cos(trf) + vel[2];
-  }
+  const Real vsd = vth*sqrt(0.5);   // spread of each velocity component
+  const Index ncol = std::max(static_cast<Index> (x_dim/dx[0] + 0.5), 1);
+  load_particles(nparts, xlo, x_dim, ncol, 2, 3, particles, 
+    [&](int nb, const Real* ru, const Real* rn, Particle* pblk) {
+#ifdef OMP
+#pragma omp simd
+#endif
+      for (int i = 0; i < nb; i++) {
+        Particle& particle = pblk[i];
+        particle.x() = xlo + ru[i]*x_dim;
+        particle.y() = sqrt(r0sq + drsq*ru[nb+i]);
 
-  particles->append(Particles(x, y, z, vx, vy, vz));
+        particle.vx() = vsd*rn[i] + vel[0];
+        particle.vy() = vsd*rn[nb+i] + vel[1];
+        particle.vz() = vsd*rn[2*nb+i] + vel[2];
+      }
+    });
 }
 
@@ -2,17 +2,22 @@
 #define _AMBIENT_H
 
 #
+#include <vector>
+#include <limits>
 #include "espic_type.h"
+#include "espic_math.h"
 
 class AmbientDef {
   public:
-    AmbientDef(int spid, Real n, Real T, Real v[3], Real blo[3], Real bhi[3])
+    AmbientDef(int spid, Real n, Real T, Real v[3], Real blo[3], Real bhi[3],
+               bool qs = false)
       : specid (spid),
         ndens (n),
         temp (T),
         vel {v[0], v[1], v[2]},
         bound_lo {blo[0], blo[1], blo[2]},
-        bound_hi {bhi[0], bhi[1], bhi[2]}
+        bound_hi {bhi[0], bhi[1], bhi[2]},
+        quiet (qs)
     {}
 
   int specid;
@@ -21,6 +26,7 @@ class AmbientDef {
   Real vel[3];
   Real bound_lo[3];
   Real bound_hi[3];
+  bool quiet;               // quiet start from a low-discrepancy sequence
 };
 
 class Ambient {
@@ -28,6 +34,7 @@ class Ambient {
     Ambient(int, const class AmbientDef* const&, const class SpeciesDef* const&);
 
     int species_id() const { return specid; }
+    bool is_quiet_start() const { return quiet; }
 
     Real xmin() const { return bound_lo[0]; }
     Real ymin() const { return bound_lo[1]; }
@@ -36,6 +43,11 @@ class Ambient {
     Real ymax() const { return bound_hi[1]; }
     Real zmax() const { return bound_hi[2]; }
 
+    // load only columns of the region along x (one per cell) that meet
+    // [xlo, xhi], e.g. the slab of this process; particles of columns
+    // are the same for any window
+    void set_window(Real xlo, Real xhi) { window[0] = xlo; window[1] = xhi; }
+
     void gen_ambient (int [3], Real [3], Real [3], Real [3], class Particles* &);
     void gen_ambient_0d(Bigint n, class Particles* &);
 
@@ -47,6 +59,12 @@ class Ambient {
     Real weight;
     Real bound_lo[3];
     Real bound_hi[3];
+    std::vector<ESPIC::Random> rng_arr;   // one random stream per thread
+    bool quiet;
+    ESPIC::Halton halton;     // (x, v) sequence used by quiet start
+    uint64_t rng_stream;      // keys blocks by (ambient, first particle)
+    uint64_t qs_index;        // # of sequence points consumed so far
+    Real window[2];           // x-range of columns loaded
 
     typedef void (Ambient::*PtrGenAmbient)(
         int [3], Real [3], Real [3], Real [3], class Particles* &);
@@ -55,6 +73,14 @@ class Ambient {
     void gen_ambient_2d (int [3], Real [3], Real [3], Real [3], class Particles* &);
     void gen_ambient_3d (int [3], Real [3], Real [3], Real [3], class Particles* &);
     void gen_ambient_axi(int [3], Real [3], Real [3], Real [3], class Particles* &);
+
+    // load n particles over a region of x-length x_dim split into ncol
+    // columns, those of the columns in the window are filled in place by
+    // all threads; each block gets npos uniform (the first one for x,
+    // over the whole region) and nvel standard normal numbers per particle
+    template<class BlockFn>
+    void load_particles(std::size_t, Real xlo, Real x_dim, Index ncol, int, int,
+                        class Particles* &, BlockFn);
 };
 
 #endif
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+
+#include "espic_info.h"
+#include "parse.h"
+#include "mesh.h"
+#include "background_field.h"
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+BackgroundField::BackgroundField(const Mesh* mesh, const CrossSection::Background* bg)
+  : ndim(mesh->dimension()),
+    nn {mesh->num_nodes(0), mesh->num_nodes(1), mesh->num_nodes(2)},
+    nc {mesh->num_cells(0), mesh->num_cells(1), mesh->num_cells(2)},
+    tnc {mesh->tile_num_cells(0), mesh->tile_num_cells(1), mesh->tile_num_cells(2)},
+    lo {mesh->xmin(), mesh->ymin(), mesh->zmin()},
+    hinv {1./mesh->dx(), 1./mesh->dy(), 1./mesh->dz()},
+    uniform(CrossSection::Background::Profile::uniform == bg->nprof.kind
+            && CrossSection::Background::Profile::uniform == bg->tprof.kind)
+{
+  if (3 != ndim) nn[2] = nc[2] = tnc[2] = 1;
+  for (int a = 0; a < 3; a++) ntile[a] = (nc[a] + tnc[a] - 1)/tnc[a];
+
+  fill(ndens, bg->nprof, bg->ndens, mesh);
+  fill(vth, bg->tprof, bg->temp, mesh);
+  for (Real& v : vth) v = sqrt(2.*v/bg->mass);
+
+  // interpolation never exceeds the nodes of the cells of a tile
+  nmax_tile.assign(num_tiles(), 0.);
+  for (Index kt = 0; kt < ntile[2]; kt++)
+    for (Index jt = 0; jt < ntile[1]; jt++)
+      for (Index it = 0; it < ntile[0]; it++) {
+        Real& nmax = nmax_tile[(kt*ntile[1] + jt)*ntile[0] + it];
+        Index kend = (3 == ndim) ? std::min((kt+1)*tnc[2], nc[2]) : 0;
+        Index jend = std::min((jt+1)*tnc[1], nc[1]);
+        Index iend = std::min((it+1)*tnc[0], nc[0]);
+        for (Index k = kt*tnc[2]; k <= kend; k++)
+          for (Index j = jt*tnc[1]; j <= jend; j++)
+            for (Index i = it*tnc[0]; i <= iend; i++)
+              nmax = std::max(nmax, ndens[node(i, j, k)]);
+      }
+}
+
+/* ------------------------------------------------------- */
+
+BackgroundField::~BackgroundField()
+{
+}
+
+/* ------------------------------------------------------- */
+
+template <typename T>
+void BackgroundField::at(const T pos[3], Real& n, Real& v) const
+{
+  if (uniform) {
+    n = ndens[0];
+    v = vth[0];
+    return;
+  }
+
+  Index ic[3] = {0, 0, 0};
+  Real w[3] = {0., 0., 0.};
+  const int nd = (3 == ndim) ? 3 : 2;
+  for (int a = 0; a < nd; a++) {
+    Real s = (pos[a] - lo[a])*hinv[a];
+    ic[a] = std::min(std::max(static_cast<Index> (floor(s)), 0), nc[a]-1);
+    w[a] = std::min(std::max(s - ic[a], 0.), 1.);
+  }
+
+  n = v = 0.;
+  for (int dk = 0; dk < (3 == ndim ? 2 : 1); dk++)
+    for (int dj = 0; dj < 2; dj++)
+      for (int di = 0; di < 2; di++) {
+        Real wt = (di ? w[0] : 1.-w[0])*(dj ? w[1] : 1.-w[1])
+                * (3 == ndim ? (dk ? w[2] : 1.-w[2]) : 1.);
+        Index m = node(ic[0]+di, ic[1]+dj, ic[2]+dk);
+        n += wt*ndens[m];
+        v += wt*vth[m];
+      }
+}
+
+template void BackgroundField::at<float>(const float*, Real&, Real&) const;
+template void BackgroundField::at<double>(const double*, Real&, Real&) const;
+
+/* ------------------------------------------------------- */
+
+template <typename T>
+Index BackgroundField::tile_index(const T pos[3]) const
+{
+  Index it[3] = {0, 0, 0};
+  const int nd = (3 == ndim) ? 3 : 2;
+  for (int a = 0; a < nd; a++) {
+    Index c = std::min(std::max(static_cast<Index> ((pos[a] - lo[a])*hinv[a]), 0), nc[a]-1);
+    it[a] = c/tnc[a];
+  }
+  return (it[2]*ntile[1] + it[1])*ntile[0] + it[0];
+}
+
+template Index BackgroundField::tile_index<float>(const float*) const;
+template Index BackgroundField::tile_index<double>(const double*) const;
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void BackgroundField::fill(std::vector<Real>& val, const CrossSection::Background::Profile& prof,
+                           Real base, const Mesh* mesh) const
+{
+  typedef CrossSection::Background::Profile Profile;
+  const Index nnode = nn[0]*nn[1]*nn[2];
+  val.assign(nnode, base);
+  if (Profile::uniform == prof.kind) return;
+
+  if (Profile::file == prof.kind) {
+    // factors on nodes, x fastest, any number per line
+    FILE* fp = fopen(prof.fname.c_str(), "r");
+    if (NULL == fp) espic_error("Cannot read file [" + prof.fname + "]");
+    std::vector<std::string> word;
+    Index m = 0;
+    while (ParseLine(word, fp)) {
+      for (const std::string& w : word) {
+        if (m == nnode) espic_error("Too many node values in [" + prof.fname + "]");
+        val[m++] = base*atof(w.c_str());
+      }
+    }
+    fclose(fp);
+    if (m != nnode) espic_error("Too few node values in [" + prof.fname + "]");
+  }
+  else {
+    for (Index k = 0; k < nn[2]; k++)
+      for (Index j = 0; j < nn[1]; j++)
+        for (Index i = 0; i < nn[0]; i++) {
+          Real x[3] = { mesh->x(i, j, k), mesh->y(i, j, k), mesh->z(i, j, k) };
+          Real s = x[prof.axis], f;
+          if (Profile::linear == prof.kind) {
+            Real t = std::min(std::max((s - prof.x0)/(prof.x1 - prof.x0), 0.), 1.);
+            f = prof.f0 + t*(prof.f1 - prof.f0);
+          }
+          else {
+            f = exp(-(s - prof.x0)/prof.len);
+          }
+          val[node(i, j, k)] = base*f;
+        }
+  }
+
+  for (Real v : val) {
+    if (v < 0.) espic_error("Negative background density or temperature in profile");
+  }
+}
+
+/* ----------------- End Private Methods ----------------- */
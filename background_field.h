@@ -0,0 +1,53 @@
+#ifndef _BACKGROUND_FIELD_H
+#define _BACKGROUND_FIELD_H
+
+#include <vector>
+#include "espic_type.h"
+#include "cross_section.h"
+
+// density and thermal speed of the background gas on mesh nodes, from the
+// profiles given in csection.in, and the largest density in each tile of
+// cells used as majorant of the null-collision method
+class BackgroundField {
+  public:
+    /* Constructor */
+    BackgroundField(const class Mesh*, const CrossSection::Background*);
+
+    ~BackgroundField();
+
+    /* Public methods */
+    // density and thermal speed at a point, interpolated from nodes
+    template <typename T>
+    void at(const T pos[3], Real& n, Real& vth) const;
+
+    // tile containing a point (out-of-domain points go to the nearest)
+    template <typename T>
+    Index tile_index(const T pos[3]) const;
+
+    Index num_tiles() const { return ntile[0]*ntile[1]*ntile[2]; }
+    Index num_tiles(int a) const { return ntile[a]; }
+
+    Real tile_max_ndens(Index itile) const { return nmax_tile[itile]; }
+
+    bool is_uniform() const { return uniform; }
+
+  private:
+    int ndim;
+    Index nn[3];                  // # of nodes in x, y and z
+    Index nc[3];                  // # of cells in x, y and z
+    int tnc[3];                   // # of cells in a tile
+    Index ntile[3];               // # of tiles in x, y and z
+    Real lo[3], hinv[3];
+    bool uniform;
+
+    std::vector<Real> ndens;      // on nodes
+    std::vector<Real> vth;
+    std::vector<Real> nmax_tile;
+
+    Index node(Index i, Index j, Index k) const { return (k*nn[1] + j)*nn[0] + i; }
+
+    void fill(std::vector<Real>&, const CrossSection::Background::Profile&,
+              Real, const class Mesh*) const;
+};
+
+#endif
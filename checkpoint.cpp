@@ -0,0 +1,326 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "espic_info.h"
+#include "espic_math.h"
+#include "espic_memory.h"
+#include "species.h"
+#include "particles.h"
+#include "field.h"
+#include "tile.h"
+#include "checkpoint.h"
+
+#ifdef OMP
+#include <omp.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+
+const char ckpt_magic[8] = {'E', 'S', 'P', 'I', 'C', 'C', 'K', 'P'};
+const uint32_t ckpt_version = 3;
+const uint64_t ckpt_align = 64;
+
+struct CkptHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t nspecies;
+  int64_t step;
+  double time;
+  uint64_t nnodes;
+  uint64_t phi_offset;
+  uint32_t particle_bytes;
+  uint32_t real_bytes;
+  char particle_fields[64];       // layout of one particle record
+  int64_t seed;                   // seed of random streams
+  uint32_t nrng;                  // # of random stream states
+  uint32_t reproducible;
+  uint64_t rng_offset;
+};
+
+struct CkptSpecies {
+  char name[32];
+  double mass;
+  double charge;
+  double weight;
+  uint64_t np;
+  uint64_t offset;
+  double energy;                  // incremental kinetic energy
+  int32_t nsub;                   // pushed every nsub steps
+  int32_t nsum;                   // solves in the averaged field
+  uint32_t has_prev;              // previous frozen density is set
+  uint32_t unused;
+  uint64_t slot_offset;           // frozen densities and summed field
+                                  // of a sub-cycled species, 0 if none
+};
+
+inline uint64_t align_up(uint64_t n) { return (n + ckpt_align - 1)/ckpt_align*ckpt_align; }
+
+}
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Checkpoint::Checkpoint(const std::string& file)
+  : outfile(file),
+    image(nullptr),
+    image_bytes(0),
+    failed(false),
+    tstall(0.),
+    phi_read(false)
+{
+}
+
+/* ------------------------------------------------------- */
+
+Checkpoint::~Checkpoint()
+{
+  wait_writer();
+  if (failed) espic_warning("Failed to write checkpoint [" + outfile + "]");
+}
+
+/* ------------------------------------------------------- */
+
+std::size_t Checkpoint::write(int step, Real time, Tile* tile, const Field* field)
+{
+  const int nspecies = tile->num_species();
+  const Field::NodeArray& phi = field->get_potential();
+
+  // layout
+  CkptHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, ckpt_magic, sizeof(ckpt_magic));
+  header.version = ckpt_version;
+  header.nspecies = static_cast<uint32_t> (nspecies);
+  header.step = step;
+  header.time = time;
+  header.nnodes = phi.size();
+  header.particle_bytes = sizeof(Particle);
+  header.real_bytes = sizeof(Real);
+  std::snprintf(header.particle_fields, sizeof(header.particle_fields),
+                "x y z vx vy vz w, position %d bytes, velocity %d bytes",
+                static_cast<int> (sizeof(PosReal)), static_cast<int> (sizeof(VelReal)));
+
+  std::vector<CkptSpecies> table(nspecies);
+  uint64_t off = align_up(sizeof(CkptHeader) + nspecies*sizeof(CkptSpecies));
+  std::size_t ncopy = 0;
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    const Species* species = tile->get_species(ispec);
+    CkptSpecies& entry = table[ispec];
+    std::memset(&entry, 0, sizeof(entry));
+    std::strncpy(entry.name, species->name.c_str(), sizeof(entry.name)-1);
+    entry.mass = species->mass;
+    entry.charge = species->charge;
+    entry.weight = species->weight;
+    entry.np = species->num_particles();
+    entry.offset = off;
+    entry.energy = species->toten;
+    off = align_up(off + entry.np*sizeof(Particle));
+    ncopy += entry.np;
+  }
+  header.phi_offset = off;
+  off = align_up(off + phi.size()*sizeof(Real));
+
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    CkptSpecies& entry = table[ispec];
+    entry.nsub = tile->subcycle(ispec);
+    if (tile->subcycle_slot_id(ispec) < 0) continue;
+    entry.slot_offset = off;
+    off = align_up(off + field->slot_size()*sizeof(Real));
+  }
+
+  std::vector<uint64_t> rng_state;
+  tile->GetRandomState(rng_state);
+  header.seed = ESPIC::Random::get_seed();
+  header.reproducible = ESPIC::Random::is_reproducible() ? 1 : 0;
+  header.nrng = static_cast<uint32_t> (rng_state.size());
+  header.rng_offset = off;
+  off += rng_state.size()*sizeof(uint64_t);
+
+  // the image of the last checkpoint is released when written
+  wait_writer();
+  if (failed) espic_error("Failed to write checkpoint [" + outfile + "]");
+
+  image_bytes = off;
+  image = static_cast<char*> (ESPIC::Memory::allocate(image_bytes));
+  std::memcpy(image, &header, sizeof(header));
+  std::memcpy(image + header.phi_offset, phi.data(), phi.size()*sizeof(Real));
+  std::memcpy(image + header.rng_offset, rng_state.data(), rng_state.size()*sizeof(uint64_t));
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    CkptSpecies& entry = table[ispec];
+    if (0 == entry.slot_offset) continue;
+    int nsum;
+    bool has_prev;
+    field->get_slot(tile->subcycle_slot_id(ispec),
+                    reinterpret_cast<Real*> (image + entry.slot_offset), nsum, has_prev);
+    entry.nsum = nsum;
+    entry.has_prev = has_prev ? 1 : 0;
+  }
+  std::memcpy(image + sizeof(header), table.data(), nspecies*sizeof(CkptSpecies));
+
+  // particle chunks are copied by all threads
+  std::vector<std::pair<const Particle*, char*>> copy_arr;
+  std::vector<std::size_t> count_arr;
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    const Particles& pts = *(tile->get_species(ispec)->particles);
+    char* dst = image + table[ispec].offset;
+    for (Particles::size_type ic = 0; ic < pts.num_chunks(); ic++) {
+      copy_arr.emplace_back(pts.chunk(ic), dst);
+      count_arr.push_back(pts.chunk_count(ic));
+      dst += pts.chunk_count(ic)*sizeof(Particle);
+    }
+  }
+  const long ncopy_chunk = static_cast<long> (copy_arr.size());
+#ifdef OMP
+#pragma omp parallel for schedule(dynamic, 4)
+#endif
+  for (long i = 0; i < ncopy_chunk; i++)
+    std::memcpy(copy_arr[i].second, copy_arr[i].first, count_arr[i]*sizeof(Particle));
+
+  writer = std::thread(&Checkpoint::write_file, this);
+  return ncopy;
+}
+
+/* ------------------------------------------------------- */
+
+int Checkpoint::read(const std::string& file, Tile* tile, Field* field, Real& time)
+{
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) espic_error("Cannot read file [" + file + "]");
+
+  struct stat st;
+  fstat(fd, &st);
+  std::size_t fsize = static_cast<std::size_t> (st.st_size);
+  if (fsize < sizeof(CkptHeader)) espic_error("Corrupted checkpoint [" + file + "]");
+
+  void* map = mmap(nullptr, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map) espic_error("Cannot map file [" + file + "]");
+  const char* base = static_cast<const char*> (map);
+
+  CkptHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (0 != std::memcmp(header.magic, ckpt_magic, sizeof(ckpt_magic)))
+    espic_error("Not a checkpoint file [" + file + "]");
+  if (ckpt_version != header.version)
+    espic_error("Unsupported checkpoint version in [" + file + "]");
+  if (sizeof(Particle) != header.particle_bytes || sizeof(Real) != header.real_bytes)
+    espic_error("Particle layout in [" + file + "] differs from this build");
+
+  if (header.nspecies > (fsize - sizeof(header))/sizeof(CkptSpecies))
+    espic_error("Corrupted checkpoint [" + file + "]");
+  std::vector<CkptSpecies> table(header.nspecies);
+  std::memcpy(table.data(), base + sizeof(header), header.nspecies*sizeof(CkptSpecies));
+
+  cout << "Read checkpoint [" << file << "] at step " << header.step
+    << ", t = " << header.time << endl;
+
+  for (const CkptSpecies& entry : table) {
+    int ispec = 0;
+    while (ispec < tile->num_species() && tile->get_species(ispec)->name != entry.name) ispec++;
+    if (ispec == tile->num_species()) {
+      espic_warning(std::string("Species [") + entry.name + "] in checkpoint not defined, skipped");
+      continue;
+    }
+    if (entry.offset > fsize || entry.np > (fsize - entry.offset)/sizeof(Particle))
+      espic_error("Corrupted checkpoint [" + file + "]");
+
+    // pages of the map are faulted in by all threads
+    Particles& pts = *(tile->get_species(ispec)->particles);
+    pts.pop_back(pts.size());
+    pts.grow(entry.np);
+    const char* src = base + entry.offset;
+    const int64_t np = static_cast<int64_t> (entry.np);
+#ifdef OMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t ip = 0; ip < np; ip++) {
+      std::memcpy(static_cast<void*> (&pts[ip]), src + ip*sizeof(Particle), sizeof(Particle));
+    }
+    // the energy goes on as kept, a sweep would differ in round-off
+    tile->get_species(ispec)->toten = entry.energy;
+    cout << "  species " << entry.name << ": " << entry.np << " particles" << endl;
+  }
+
+  phi_read = (header.nnodes == field->get_potential().size()
+              && header.phi_offset + header.nnodes*sizeof(Real) <= fsize);
+  if (phi_read) {
+    field->set_potential(reinterpret_cast<const Real*> (base + header.phi_offset));
+  }
+  else
+    espic_warning("Mesh of checkpoint [" + file + "] differs, potential not restored");
+
+  // sub-cycling goes on with the same # of steps, frozen densities and
+  // averaged field instead of being set up again from this step
+  for (const CkptSpecies& entry : table) {
+    int ispec = 0;
+    while (ispec < tile->num_species() && tile->get_species(ispec)->name != entry.name) ispec++;
+    if (ispec == tile->num_species() || !phi_read || entry.nsub <= 1) continue;
+
+    const std::size_t nslot = field->slot_size();
+    if (entry.slot_offset > fsize || nslot > (fsize - entry.slot_offset)/sizeof(Real))
+      espic_error("Corrupted checkpoint [" + file + "]");
+    tile->SetSubcycle(ispec, entry.nsub, field);
+    field->set_slot(tile->subcycle_slot_id(ispec),
+                    reinterpret_cast<const Real*> (base + entry.slot_offset),
+                    entry.nsum, 0 != entry.has_prev);
+    cout << "  species " << entry.name << ": pushed every " << entry.nsub << " steps" << endl;
+  }
+
+  // random streams go on where they stopped, keyed ones follow the step
+  if (header.rng_offset > fsize || header.nrng > (fsize - header.rng_offset)/sizeof(uint64_t))
+    espic_error("Corrupted checkpoint [" + file + "]");
+  ESPIC::Random::set_seed(header.seed);
+  if (header.reproducible) ESPIC::Random::set_reproducible(true);
+  std::vector<uint64_t> rng_state(header.nrng);
+  std::memcpy(rng_state.data(), base + header.rng_offset, header.nrng*sizeof(uint64_t));
+  tile->SetRandomState(rng_state);
+
+  munmap(map, fsize);
+  time = header.time;
+  return static_cast<int> (header.step);
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void Checkpoint::write_file()
+{
+  std::string tmpfile = outfile + ".tmp";
+
+  FILE* fp = fopen(tmpfile.c_str(), "wb");
+  bool ok = (NULL != fp);
+  if (ok) {
+    ok = (image_bytes == fwrite(image, sizeof(char), image_bytes, fp));
+    ok = (0 == fclose(fp)) && ok;
+  }
+  if (ok) ok = (0 == std::rename(tmpfile.c_str(), outfile.c_str()));
+  if (!ok) failed = true;
+
+  ESPIC::Memory::deallocate(image, image_bytes);
+  image = nullptr;
+}
+
+/* ------------------------------------------------------- */
+
+void Checkpoint::wait_writer()
+{
+  if (!writer.joinable()) return;
+
+  auto t0 = std::chrono::steady_clock::now();
+  writer.join();
+  std::chrono::duration<Real> elapsed = std::chrono::steady_clock::now() - t0;
+  tstall += elapsed.count();
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,68 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include "espic_type.h"
+
+// checkpoint/restart of particles, potential and random streams
+//
+// A checkpoint is first copied into a memory image by all threads (the
+// only part done in the time loop), then written to disk by a background
+// thread while the run goes on. The image is released when the write is
+// done, so it is held only between a snapshot and the end of its write;
+// the next snapshot waits if that write has not finished yet. The file
+// is written to <file>.tmp and renamed when complete, so <file> is
+// always a full one.
+//
+// File layout (version 3, native byte order):
+//   header      magic "ESPICCKP", version, # of species, step, time,
+//               # of nodes and offset of potential, particle record
+//               size and its field list, random seed, # and offset of
+//               random stream states
+//   species[n]  name, mass, charge, weight, # of particles, offset,
+//               kinetic energy, sub-cycle steps and offset of its
+//               frozen densities and summed field
+//   data        particle records of each species, potential, sub-cycle
+//               state of sub-cycled species and random stream states (global stream, then fill #,
+//               residual and cursor of each injection), each aligned
+//               to 64 bytes
+class Checkpoint {
+  public:
+    /* Constructor */
+    explicit Checkpoint(const std::string& file = "restart.ckpt");
+
+    // wait for the last write
+    ~Checkpoint();
+
+    /* Public methods */
+    // snapshot particles of all species and potential at a step, write in
+    // background, return # of particles copied
+    std::size_t write(int step, Real time, class Tile*, const class Field*);
+
+    // read a checkpoint file to species with the same names (replacing
+    // their particles) and potential, return the step
+    int read(const std::string& file, class Tile*, class Field*, Real& time);
+
+    // seconds spent waiting for the background writer
+    Real stall_time() const { return tstall; }
+
+    // whether the last read restored the potential and the sub-cycle
+    // state (same mesh)
+    bool read_field() const { return phi_read; }
+
+  private:
+    std::string outfile;
+    char* image;                  // being written, nullptr when none
+    std::size_t image_bytes;
+    std::thread writer;
+    bool failed;                  // set by writer, reported on main thread
+    Real tstall;
+    bool phi_read;
+
+    void write_file();
+    void wait_writer();
+};
+
+#endif
@@ -2,8 +2,9 @@
 #include <fstream>
 
 // In class all velocity except for the Update part are relative velocity 
-Collisionpair::Collisionpair(Particle& particle, VrArr& vr, Real vel, Real m1, Real m2, Real vtb)
-: pt(particle), 
+Collisionpair::Collisionpair(Particle& particle, VrArr& vr, Real vel, Real m1, Real m2, Real vtb,
+                             const ESPIC::Random& rnd)
+: pt(particle), rng(rnd),
 mr(m1*m2/(m1+m2)), vth(vtb),
 gx(vr[0]), gy(vr[1]), gz(vr[2]),
 g(vel), energy(0.5*vel*vel*mr),
@@ -27,8 +28,8 @@ Collisionpair::~Collisionpair()
 
 void Collisionpair::ParticleElasticCollision() 
 { 
-    chi = acos(1.0 - 2.0*RG01());
-    eta = ESPIC::PI2 * RG01();
+    chi = acos(1.0 - 2.0*rng());
+    eta = ESPIC::PI2 * rng();
     Real sc(sin(chi)), cc(cos(chi));
     Real se(sin(eta)), ce(cos(eta));
     cp = gy / gyz;
@@ -52,8 +53,8 @@ void Collisionpair::ParticleExcitatinCollision(Real th)
     FindEulerAngle();
     energy = fabs(energy - th);
     g1 = sqrt(2.0 * energy / mr);
-    chi = acos(1.0 - 2.0 * RG01());
-    eta = ESPIC::PI2 * RG01();
+    chi = acos(1.0 - 2.0 * rng());
+    eta = ESPIC::PI2 * rng();
     UpdateParticleVelInfo();
 
     // of << " after: " << pt.velsqr()*mr << std::endl;
@@ -70,17 +71,18 @@ void Collisionpair::ParticleIonizationCollision(Real th)
     // std::ofstream of("ion.dat", std::ofstream::app);
 
     energy = fabs(energy - th);
-    en_ej = w * tan(RG01() * atan(0.5*energy/w));
+    en_ej = w * tan(rng() * atan(0.5*energy/w));
     en_sc = fabs(energy - en_ej);
     g1 = sqrt(2.0 * en_sc/mr);
     g_ej = sqrt(2.0 * en_ej/mr);
     chi = acos(sqrt(en_sc / energy));
     chi_ej = acos(sqrt(en_ej / energy));
-    eta = ESPIC::PI2 * RG01();
+    eta = ESPIC::PI2 * rng();
     eta_ej = eta + ESPIC::PI;
 
     Particle e_ej = Particle(pt.x(), pt.y(), pt.z());
     Particle p_ej = Particle(pt.x(), pt.y(), pt.z());
+    e_ej.w() = p_ej.w() = pt.w();
 
     FindEulerAngle();
     UpdateParticleVelInfo();
@@ -104,8 +106,8 @@ void Collisionpair::ParticleIonizationCollision(Real th)
 
 void Collisionpair::ParticleIsotropicCollision()
 {
-    chi = acos(1.0 - 2.0*RG01());
-    eta = PI2 * RG01();
+    chi = acos(1.0 - 2.0*rng());
+    eta = PI2 * rng();
     FindEulerAngle();
     UpdateParticleVelInfo();
 }
@@ -113,7 +115,7 @@ void Collisionpair::ParticleIsotropicCollision()
 void Collisionpair::ParticleBackwardCollision()
 {
     chi = PI;
-    eta = PI2 * RG01();
+    eta = PI2 * rng();
     FindEulerAngle();
     UpdateParticleVelInfo();
 }
@@ -165,7 +167,7 @@ void Collisionpair::UpdateParticleVelInfo()
 void Collisionpair::EjectIonReaction(Particle& particle)
 {
     Real vx, vy, vz;
-    VelBoltzDistr(vth, vx, vy, vz);
+    VelBoltzDistr(vth, vx, vy, vz, rng);
     particle.vx() = vx; 
     particle.vy() = vy; 
     particle.vz() = vz;
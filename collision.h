@@ -13,9 +13,11 @@ extern Real kTe0;
 using namespace ESPIC;
 
 class Collisionpair {
-friend class Particle;
+friend Particle;
 public:    // In class all velocity except for the Update part are relative velocity 
-    Collisionpair(Particle& particle, VrArr& vr, Real vel, Real m1, Real m2, Real vtb);
+    // (random numbers are drawn from rng, e.g. a stream keyed by tile)
+    Collisionpair(Particle& particle, VrArr& vr, Real vel, Real m1, Real m2, Real vtb,
+                  const ESPIC::Random& rng = ranf);
 
     ~Collisionpair();
 
@@ -42,6 +44,7 @@ private:
 
 
     Particle& pt;
+    const ESPIC::Random& rng;
     const Real mr;
     const Real vth;
     Real gx, gy, gz, gyz, g1;    // relative-velocity
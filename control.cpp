@@ -0,0 +1,346 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "espic_info.h"
+#include "espic_math.h"
+#include "espic_memory.h"
+#include "parse.h"
+#include "control.h"
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+using std::ostringstream;
+
+/* ---------------- Begin Public Methods ---------------- */
+
+Control::Control(const string& file)
+  : infile(file),
+    dt(0.1),
+    nsteps(0),
+    nreport(0),
+    ndiag(1),
+    diagfmt(Diagnostics::text),
+    nflush(1000),
+    nsweep(0),
+    collision(true),
+    tol(1e-6),
+    maxiter(10000),
+    omega(1.8),
+    subcycle_auto(false),
+    nsub_max(1000),
+    balance_thres(1.1),
+    cost_cand(8.),
+    ncheck(0),
+    ckptfile("restart.ckpt"),
+    seed(-1),
+    huge_pages(false),
+    bind_threads(false)
+{
+  init();
+  ESPIC::Memory::init(huge_pages, bind_threads);
+
+  cout << "Set run control: dt = " << dt << ", # of steps = " << nsteps
+    << ", report every " << nreport << " steps"
+    << ", diagnostics every " << ndiag << " steps"
+    << " (" << (Diagnostics::binary == diagfmt ? "binary"
+                : Diagnostics::csv == diagfmt ? "csv" : "text")
+    << ", " << nflush << " rows per write"
+    << (nsweep > 0 ? ", energy sweep every " + std::to_string(nsweep) + " steps" : "") << ")"
+    << ", collision " << (collision ? "on" : "off") << ".\n";
+  cout << "Set field solver: SOR, tol = " << tol << ", max_iter = " << maxiter
+    << ", omega = " << omega << "." << endl;
+  if (subcycle_auto)
+    cout << "Set push sub-cycling: auto, at most " << nsub_max << " steps." << endl;
+  for (const auto& sub : subcycle_arr)
+    cout << "Set push sub-cycling: species " << sub.first
+      << " every " << sub.second << " steps." << endl;
+  for (const PopulationDef& pop : popdef_arr)
+    cout << "Set population control: species " << pop.species
+      << ", " << pop.nmin << " to " << pop.nmax << " particles per cell"
+      << ", every " << pop.every << " steps." << endl;
+  if (ncheck > 0)
+    cout << "Set checkpoint: [" << ckptfile << "] every " << ncheck << " steps." << endl;
+  if (!restartfile.empty())
+    cout << "Set restart from [" << restartfile << "]." << endl;
+  if (seed >= 0)
+    cout << "Set random seed: " << seed << ", reproducible run." << endl;
+  cout << "Set memory placement: " << ESPIC::Memory::summary() << "." << endl;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void Control::init()
+{
+  FILE *fp = fopen(infile.c_str(), "r");
+
+  if (NULL == fp) {
+    ostringstream oss;
+    oss << "Cannot read file [" << infile << "]";
+    espic_error(oss.str());
+  }
+  else
+    cout << "Read run control commands from [" << infile << "]" << endl;
+
+  vector<string> word;
+  while (ParseLine(word, fp)) {
+    if (word.empty()) continue;     // this is a comment line
+
+         if ("time_step"    == word.at(0)) proc_time_step(word);
+    else if ("num_steps"    == word.at(0)) proc_num_steps(word);
+    else if ("report"       == word.at(0)) proc_report(word);
+    else if ("diag"         == word.at(0)) proc_diag(word);
+    else if ("collision"    == word.at(0)) proc_collision(word);
+    else if ("field_solver" == word.at(0)) proc_field_solver(word);
+    else if ("subcycle"     == word.at(0)) proc_subcycle(word);
+    else if ("population"   == word.at(0)) proc_population(word);
+    else if ("balance"      == word.at(0)) proc_balance(word);
+    else if ("checkpoint"   == word.at(0)) proc_checkpoint(word);
+    else if ("restart"      == word.at(0)) proc_restart(word);
+    else if ("seed"         == word.at(0)) proc_seed(word);
+    else if ("memory"       == word.at(0)) proc_memory(word);
+    else espic_error(unknown_cmd_info(word.at(0), infile));
+  }
+  fclose(fp);
+
+  if (nsteps < 1) {
+    espic_error("Number of steps must be at least 1 in [" + infile + "]");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_time_step(vector<string>& word)
+{
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  dt = (Real)atof(word[1].c_str());
+  if (dt <= 0.) espic_error(illegal_cmd_info(cmd, infile));
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_num_steps(vector<string>& word)
+{
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  nsteps = atoi(word[1].c_str());
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_report(vector<string>& word)
+{
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  nreport = atoi(word[1].c_str());
+  if (nreport < 0) espic_error(illegal_cmd_info(cmd, infile));
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_diag(vector<string>& word)
+{
+  // diag N [format text|csv|binary] [flush rows] [energy_sweep steps]
+  string cmd(word[0]);
+  if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+
+  ndiag = atoi(word[1].c_str());
+  if (ndiag < 1) espic_error(illegal_cmd_info(cmd, infile));
+  word.erase(word.begin(), word.begin()+2);
+
+  while (!word.empty()) {
+    if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+
+    if ("format" == word[0]) {
+           if ("text"   == word[1]) diagfmt = Diagnostics::text;
+      else if ("csv"    == word[1]) diagfmt = Diagnostics::csv;
+      else if ("binary" == word[1]) diagfmt = Diagnostics::binary;
+      else espic_error(illegal_cmd_info(cmd, infile));
+    }
+    else if ("flush" == word[0]) {
+      nflush = atoi(word[1].c_str());
+      if (nflush < 1) espic_error(illegal_cmd_info(cmd, infile));
+    }
+    else if ("energy_sweep" == word[0]) {
+      nsweep = atoi(word[1].c_str());
+      if (nsweep < 0) espic_error(illegal_cmd_info(cmd, infile));
+    }
+    else espic_error(illegal_cmd_info(cmd, infile));
+
+    word.erase(word.begin(), word.begin()+2);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_collision(vector<string>& word)
+{
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+       if ("on"  == word[1]) collision = true;
+  else if ("off" == word[1]) collision = false;
+  else espic_error(illegal_cmd_info(cmd, infile));
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_field_solver(vector<string>& word)
+{
+  string cmd(word[0]);
+  word.erase(word.begin());
+
+  while (!word.empty()) {
+    if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+
+         if ("tol"      == word[0]) tol = (Real)atof(word[1].c_str());
+    else if ("max_iter" == word[0]) maxiter = atoi(word[1].c_str());
+    else if ("omega"    == word[0]) omega = (Real)atof(word[1].c_str());
+    else espic_error(illegal_cmd_info(cmd, infile));
+
+    word.erase(word.begin(), word.begin()+2);
+  }
+
+  if (omega <= 0. || omega >= 2.) {
+    espic_error("Over-relaxation factor omega must be in (0, 2) in [" + infile + "]");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_subcycle(vector<string>& word)
+{
+  // subcycle auto [max N] | subcycle species N
+  string cmd(word[0]);
+  if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+
+  if ("auto" == word[1]) {
+    subcycle_auto = true;
+    if (2 == word.size()) return;
+    if (4 != word.size() || "max" != word[2]) espic_error(illegal_cmd_info(cmd, infile));
+    nsub_max = atoi(word[3].c_str());
+    if (nsub_max < 1) espic_error(illegal_cmd_info(cmd, infile));
+  }
+  else {
+    if (3 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+    int nsub = atoi(word[2].c_str());
+    if (nsub < 1) espic_error(illegal_cmd_info(cmd, infile));
+    subcycle_arr.push_back(std::make_pair(word[1], nsub));
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_population(vector<string>& word)
+{
+  // population species min max [every N]
+  string cmd(word[0]);
+  if (4 != word.size() && 6 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  int nmin = atoi(word[2].c_str());
+  int nmax = atoi(word[3].c_str());
+  int every = 10;
+  if (6 == word.size()) {
+    if ("every" != word[4]) espic_error(illegal_cmd_info(cmd, infile));
+    every = atoi(word[5].c_str());
+  }
+  if (nmin < 1 || nmax < 2*nmin || every < 1) {
+    espic_error(illegal_cmd_info(cmd, infile));
+  }
+  popdef_arr.push_back(PopulationDef(word[1], nmin, nmax, every));
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_balance(vector<string>& word)
+{
+  // balance threshold T [candidate C] | balance species C
+  string cmd(word[0]);
+  if (3 != word.size() && 5 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  if ("threshold" == word[1]) {
+    balance_thres = atof(word[2].c_str());
+    if (5 == word.size()) {
+      if ("candidate" != word[3]) espic_error(illegal_cmd_info(cmd, infile));
+      cost_cand = atof(word[4].c_str());
+    }
+    if (balance_thres < 1. || cost_cand < 0.) espic_error(illegal_cmd_info(cmd, infile));
+  }
+  else {
+    if (3 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+    Real c = atof(word[2].c_str());
+    if (c < 0.) espic_error(illegal_cmd_info(cmd, infile));
+    costspec_arr.push_back(std::make_pair(word[1], c));
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_checkpoint(vector<string>& word)
+{
+  // checkpoint every N [file name]
+  string cmd(word[0]);
+  if (3 != word.size() && 5 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+  if ("every" != word[1]) espic_error(illegal_cmd_info(cmd, infile));
+
+  ncheck = atoi(word[2].c_str());
+  if (ncheck < 0) espic_error(illegal_cmd_info(cmd, infile));
+  if (5 == word.size()) {
+    if ("file" != word[3]) espic_error(illegal_cmd_info(cmd, infile));
+    ckptfile = word[4];
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_restart(vector<string>& word)
+{
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  restartfile = word[1];
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_seed(vector<string>& word)
+{
+  // seed N, every random stream is derived from N and no draw comes from
+  // random_device or the clock, so runs repeat bit by bit
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+
+  seed = atoi(word[1].c_str());
+  if (seed < 0) espic_error(illegal_cmd_info(cmd, infile));
+  ESPIC::Random::set_seed(seed);
+  ESPIC::Random::set_reproducible(true);
+  // global stream was made before the seed was read, key it anew
+  ranf.set_key(0, ESPIC::Random::global_stream, 0);
+}
+
+/* ------------------------------------------------------- */
+
+void Control::proc_memory(vector<string>& word)
+{
+  // memory [huge_pages on|off] [bind on|off]
+  string cmd(word[0]);
+  if (word.size() < 3 || 0 == word.size()%2) espic_error(illegal_cmd_info(cmd, infile));
+
+  for (std::size_t i = 1; i < word.size(); i += 2) {
+    if ("on" != word[i+1] && "off" != word[i+1]) espic_error(illegal_cmd_info(cmd, infile));
+    bool on = ("on" == word[i+1]);
+         if ("huge_pages" == word[i]) huge_pages = on;
+    else if ("bind"       == word[i]) bind_threads = on;
+    else espic_error(illegal_cmd_info(cmd, infile));
+  }
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,118 @@
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "espic_type.h"
+#include "diagnostics.h"
+
+// per-cell population band of one species
+class PopulationDef {
+  public:
+    PopulationDef(const std::string& spec, int n0, int n1, int n)
+      : species(spec), nmin(n0), nmax(n1), every(n) { }
+
+    std::string species;
+    int nmin, nmax;             // # of particles per cell
+    int every;                  // # of steps between two controls
+};
+
+class Control {
+  public:
+    /* Constructors */
+    explicit Control(const std::string& file="control.in");
+
+    /* Public methods */
+    Real time_step() const { return dt; }
+    int num_steps() const { return nsteps; }
+
+    // # of steps between two performance reports (0 - at the end only)
+    int report_interval() const { return nreport; }
+
+    // # of steps between two diagnostic outputs
+    int diag_interval() const { return ndiag; }
+    Diagnostics::Format diag_format() const { return diagfmt; }
+    // # of rows buffered per diagnostics file before writing
+    int diag_flush() const { return nflush; }
+    // # of steps between full sweeps of the kinetic energy, which is
+    // otherwise kept incrementally (0 - never)
+    int energy_sweep() const { return nsweep; }
+
+    bool is_collision_on() const { return collision; }
+
+    Real solver_tol() const { return tol; }
+    int solver_max_iter() const { return maxiter; }
+    Real solver_omega() const { return omega; }
+
+    // push sub-cycling: chosen from mass ratio and CFL if auto,
+    // explicit (species name, # of steps) pairs override it
+    bool is_subcycle_auto() const { return subcycle_auto; }
+    int subcycle_max() const { return nsub_max; }
+    const std::vector<std::pair<std::string, int>>& subcycle_list() const
+    { return subcycle_arr; }
+
+    const std::vector<PopulationDef>& population_list() const { return popdef_arr; }
+
+    // tiles are reassigned to threads above this max/mean cost per thread,
+    // cost of a collision candidate and of a particle of listed species
+    // (others 1)
+    Real balance_threshold() const { return balance_thres; }
+    Real candidate_cost() const { return cost_cand; }
+    const std::vector<std::pair<std::string, Real>>& particle_cost_list() const
+    { return costspec_arr; }
+
+    // # of steps between two checkpoints (0 - none) and file to write
+    int checkpoint_interval() const { return ncheck; }
+    const std::string& checkpoint_file() const { return ckptfile; }
+
+    // checkpoint to restart from (empty - start new)
+    const std::string& restart_file() const { return restartfile; }
+
+    // seed of a reproducible run (-1 - not given)
+    int random_seed() const { return seed; }
+
+  private:
+    std::string infile;
+    Real dt;
+    int nsteps;
+    int nreport;
+    int ndiag;
+    Diagnostics::Format diagfmt;
+    int nflush;
+    int nsweep;
+    bool collision;
+    Real tol;
+    int maxiter;
+    Real omega;
+    bool subcycle_auto;
+    int nsub_max;
+    std::vector<std::pair<std::string, int>> subcycle_arr;
+    std::vector<PopulationDef> popdef_arr;
+    Real balance_thres;
+    Real cost_cand;
+    std::vector<std::pair<std::string, Real>> costspec_arr;
+    int ncheck;
+    std::string ckptfile;
+    std::string restartfile;
+    int seed;
+    bool huge_pages;
+    bool bind_threads;
+
+    void init();
+    void proc_time_step(std::vector<std::string>&);
+    void proc_num_steps(std::vector<std::string>&);
+    void proc_report(std::vector<std::string>&);
+    void proc_diag(std::vector<std::string>&);
+    void proc_collision(std::vector<std::string>&);
+    void proc_field_solver(std::vector<std::string>&);
+    void proc_subcycle(std::vector<std::string>&);
+    void proc_population(std::vector<std::string>&);
+    void proc_balance(std::vector<std::string>&);
+    void proc_checkpoint(std::vector<std::string>&);
+    void proc_restart(std::vector<std::string>&);
+    void proc_seed(std::vector<std::string>&);
+    void proc_memory(std::vector<std::string>&);
+};
+
+#endif
@@ -6,23 +6,35 @@ using std::string;
 Real kTe0;
 
 CrossSection::CrossSection(const std::string &file)
-: infile(file),
+: background(NULL),
+  infile(file),
   pairs_number(0)
   {
     read_input_cross_section();
     reaction_arr.reserve(num_pairs()); 
     get_reaction();
 
+    // none needed if only particles collide with each other
+    if (background_arr.empty()) return;
+
     std::cout << "Set Background Species: \n";
-    std::cout << "background - (name = " << background->name;
-    std::cout << ", mass = " << background->mass;
-    std::cout << ", n = " << background->ndens;
-    std::cout << ", T = " << background->temp << ")." << std::endl;
+    const char* kind[] = { "uniform", "linear", "exp", "file" };
+    for (const Background* bg : background_arr) {
+        std::cout << "background - (name = " << bg->name;
+        std::cout << ", mass = " << bg->mass;
+        std::cout << ", n = " << bg->ndens;
+        std::cout << ", T = " << bg->temp << ")." << std::endl;
+        if (Background::Profile::uniform != bg->nprof.kind
+            || Background::Profile::uniform != bg->tprof.kind)
+            std::cout << "background profile - (n: " << kind[bg->nprof.kind]
+                      << ", T: " << kind[bg->tprof.kind] << ")." << std::endl;
+    }
 }
 
 CrossSection::~CrossSection()
 {
-    delete background;
+    for(std::size_t ibg = 0; ibg < background_arr.size(); ++ibg)
+        delete background_arr[ibg];
     for(std::size_t irea = 0; irea < reaction_arr.size(); ++irea) 
         delete reaction_arr[irea];
     reaction_arr.clear();
@@ -30,6 +42,14 @@ CrossSection::~CrossSection()
 }
 
 
+int CrossSection::find_background(const std::string& name) const
+{
+    for (std::size_t ibg = 0; ibg < background_arr.size(); ++ibg)
+        if (background_arr[ibg]->name == name) return static_cast<int>(ibg);
+    return -1;
+}
+
+
     /*---------------------begin private method-----------------------*/
 
 
@@ -74,6 +94,9 @@ void CrossSection::read_input_cross_section()
               case 0:
                 espic_error("Insufficient Reactants");
               case 1:
+                if (background_arr.empty())
+                    espic_error("No background given before \"pairs 1 " + word[0]
+                                + "\" in [" + infile + "]");
                 reactant_arr.emplace_back(std::make_pair(word[0], bspname));
                 break;
               case 2:
@@ -91,6 +114,9 @@ void CrossSection::read_input_cross_section()
                 espic_error(unknown_cmd_info(cmd, infile));
             }
         }
+        else if ("profile" == word.at(0)) {
+            proc_profile(word);
+        }
         else if ("aid_param" == word.at(0)) {
             kTe0 = (Real)atof(word[1].c_str());
         } else {
@@ -106,9 +132,61 @@ void CrossSection::proc_background(vector<string>& word)
     string cmd(word[0]);
     if (6!=word.size()) espic_error(illegal_cmd_info(cmd, infile));
     bspname = word[1];
+    if (find_background(bspname) >= 0)
+        espic_error("Background [" + bspname + "] given twice in [" + infile + "]");
     Real mass = (Real)atof(word[2].c_str());
     Real charge = (Real)atof(word[3].c_str());
     Real ndens = (Real)atof(word[4].c_str());
     Real temp = (Real)atof(word[5].c_str());
-    background = new Background(bspname, mass, charge, ndens, temp);
+    background_arr.push_back(new Background(bspname, mass, charge, ndens, temp));
+    background = background_arr.front();
+}
+
+void CrossSection::proc_profile(vector<string>& word)
+{
+    // applies to the last background given
+    // profile ndens|temp linear x|y|z x0 f0 x1 f1
+    // profile ndens|temp exp x|y|z x0 len
+    // profile ndens|temp file name
+    string cmd(word[0]);
+    if (background_arr.empty())
+        espic_error("background must be given before profile in [" + infile + "]");
+    if (word.size() < 4) espic_error(illegal_cmd_info(cmd, infile));
+
+    Background::Profile* prof = NULL;
+    if ("ndens" == word[1]) prof = &background_arr.back()->nprof;
+    else if ("temp" == word[1]) prof = &background_arr.back()->tprof;
+    else espic_error(illegal_cmd_info(cmd, infile));
+
+    if ("file" == word[2]) {
+        if (4 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+        prof->kind = Background::Profile::file;
+        prof->fname = word[3];
+        return;
+    }
+
+    if ("x" == word[3]) prof->axis = 0;
+    else if ("y" == word[3]) prof->axis = 1;
+    else if ("z" == word[3]) prof->axis = 2;
+    else espic_error(illegal_cmd_info(cmd, infile));
+
+    if ("linear" == word[2]) {
+        if (8 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+        prof->kind = Background::Profile::linear;
+        prof->x0 = (Real)atof(word[4].c_str());
+        prof->f0 = (Real)atof(word[5].c_str());
+        prof->x1 = (Real)atof(word[6].c_str());
+        prof->f1 = (Real)atof(word[7].c_str());
+        if (prof->x1 <= prof->x0 || prof->f0 < 0. || prof->f1 < 0.)
+            espic_error(illegal_cmd_info(cmd, infile));
+    }
+    else if ("exp" == word[2]) {
+        if (6 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+        prof->kind = Background::Profile::exponential;
+        prof->x0 = (Real)atof(word[4].c_str());
+        prof->len = (Real)atof(word[5].c_str());
+        if (0. == prof->len) espic_error(illegal_cmd_info(cmd, infile));
+    }
+    else
+        espic_error(illegal_cmd_info(cmd, infile));
 }
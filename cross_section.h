@@ -7,7 +7,7 @@ class CrossSection
 {
     friend class Reaction;
 public:
-    CrossSection(const std::string file="csection.in");
+    CrossSection(const std::string& file="csection.in");
     ~CrossSection();
 
     class Background {
@@ -17,18 +17,37 @@ public:
         charge(q), ndens(n), temp(T), vth(sqrt(2.*T/m))
         {}
 
+        // spatial variation of ndens or temp as a factor of the values
+        // above: linear from f0 at x0 to f1 at x1 (constant outside),
+        // exp(-(x - x0)/len), or node values read from a file
+        class Profile {
+            public:
+            enum Kind { uniform, linear, exponential, file };
+
+            Profile() : kind(uniform), axis(0), x0(0.), f0(1.), x1(0.), f1(1.), len(1.) {}
+
+            Kind kind;
+            int axis;
+            Real x0, f0, x1, f1, len;
+            std::string fname;
+        };
+
         const std::string name;
         const Real mass;
         const Real charge;
         const Real ndens;
         const Real temp;
         const Real vth;
+        Profile nprof, tprof;
     };
 
     std::vector<class Reaction*> reaction_arr;
     std::vector<ReactPair> reactant_arr;
     
-    Background* background;
+    // gases of a mixture, "pairs 1 A" collides A with the last background
+    // given before it, "pairs 2 A gas" with a named one
+    std::vector<Background*> background_arr;
+    Background* background;     // first gas
     // Real kTe0;
 
     // const std::vector<std::string>& name_species() { return name; }
@@ -36,6 +55,8 @@ public:
     // const std::vector<int>& num_react() const { return reaction_type_number; }
     int num_pairs() const { return pairs_number; }
     const std::string& get_bkname() const { return bspname; }
+    // index in background_arr, -1 if not a background gas
+    int find_background(const std::string&) const;
 
 private:
     const std::string infile;
@@ -51,6 +72,7 @@ private:
     void get_reaction();
     void read_input_cross_section();
     void proc_background(vector<string>& word);
+    void proc_profile(vector<string>& word);
 
 };
 
@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "espic_info.h"
+#include "diagnostics.h"
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Diagnostics::Diagnostics(Format fmt, int _nflush, const std::string& _suffix)
+  : format(fmt),
+    nflush(_nflush),
+    suffix(_suffix),
+    failed(false)
+{
+  if (nflush < 1) espic_error("Diagnostics flush size must be at least 1 row");
+}
+
+/* ------------------------------------------------------- */
+
+Diagnostics::~Diagnostics()
+{
+  flush();
+  wait_writer();
+  if (failed) espic_warning("Failed to write diagnostics");
+}
+
+/* ------------------------------------------------------- */
+
+int Diagnostics::add_channel(const std::string& file,
+                             const std::vector<std::string>& columns, int every)
+{
+  Channel ch;
+  ch.file = file + suffix;
+  ch.columns = columns;
+  ch.every = std::max(every, 1);
+  ch.started = false;
+  ch.rows.reserve(nflush*columns.size());
+  channel_arr.push_back(ch);
+  return static_cast<int> (channel_arr.size()) - 1;
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::record(int ich, int step, std::initializer_list<Real> values)
+{
+  if (!is_due(ich, step)) return;
+  append_row(ich, values.begin(), values.size());
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::record(int ich, int step, const std::vector<Real>& values)
+{
+  if (!is_due(ich, step)) return;
+  append_row(ich, values.data(), values.size());
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::flush()
+{
+  wait_writer();
+  if (failed) espic_error("Failed to write diagnostics");
+
+  pending.clear();
+  for (int ich = 0; ich < static_cast<int> (channel_arr.size()); ich++) {
+    Channel& ch = channel_arr[ich];
+    if (ch.rows.empty()) continue;    // files are created at first rows
+    Block blk;
+    blk.ich = ich;
+    blk.create = !ch.started;
+    blk.rows.swap(ch.rows);
+    ch.rows.reserve(nflush*ch.columns.size());
+    ch.started = true;
+    pending.push_back(std::move(blk));
+  }
+  if (!pending.empty()) writer = std::thread(&Diagnostics::write_blocks, this);
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void Diagnostics::append_row(int ich, const Real* values, std::size_t n)
+{
+  Channel& ch = channel_arr[ich];
+  if (n != ch.columns.size())
+    espic_error("Wrong # of values for diagnostics [" + ch.file + "]");
+
+  ch.rows.insert(ch.rows.end(), values, values + n);
+  if (ch.rows.size() >= nflush*ch.columns.size()) flush();
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::write_blocks()
+{
+  // channel names and columns are not changed while writing
+  for (const Block& blk : pending) {
+    const Channel& ch = channel_arr[blk.ich];
+    const char* mode = blk.create ? (binary == format ? "wb" : "w")
+                                  : (binary == format ? "ab" : "a");
+    FILE* fp = fopen(ch.file.c_str(), mode);
+    if (NULL == fp) {
+      failed = true;
+      continue;
+    }
+    if (blk.create) write_header(fp, ch);
+
+    const std::size_t ncol = ch.columns.size();
+    const std::size_t nrow = blk.rows.size()/ncol;
+    if (binary == format) {
+      if (nrow*ncol != fwrite(blk.rows.data(), sizeof(Real), nrow*ncol, fp)) failed = true;
+    }
+    else {
+      const char sep = (csv == format) ? ',' : ' ';
+      for (std::size_t r = 0; r < nrow; r++) {
+        const Real* row = blk.rows.data() + r*ncol;
+        for (std::size_t c = 0; c < ncol; c++) {
+          fprintf(fp, c + 1 < ncol ? "%.10g%c" : "%.10g\n", row[c], sep);
+        }
+      }
+    }
+    if (0 != fclose(fp)) failed = true;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::write_header(FILE* fp, const Channel& ch) const
+{
+  if (binary == format) {
+    const char magic[8] = {'E', 'S', 'P', 'I', 'C', 'D', 'I', 'A'};
+    uint32_t ncol = static_cast<uint32_t> (ch.columns.size());
+    fwrite(magic, sizeof(char), sizeof(magic), fp);
+    fwrite(&ncol, sizeof(ncol), 1, fp);
+    for (const std::string& col : ch.columns) {
+      char name[32];
+      std::memset(name, 0, sizeof(name));
+      std::strncpy(name, col.c_str(), sizeof(name)-1);
+      fwrite(name, sizeof(char), sizeof(name), fp);
+    }
+    return;
+  }
+
+  const char* sep = (csv == format) ? "," : " ";
+  if (text == format) fprintf(fp, "# ");
+  for (std::size_t c = 0; c < ch.columns.size(); c++) {
+    fprintf(fp, "%s%s", ch.columns[c].c_str(), c + 1 < ch.columns.size() ? sep : "\n");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Diagnostics::wait_writer()
+{
+  if (writer.joinable()) writer.join();
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,77 @@
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <initializer_list>
+#include "espic_type.h"
+
+// time-series output
+//
+// Channels (one file each) are registered with their column names and
+// an output cadence. Rows are kept in memory and handed to a background
+// thread in blocks of nflush rows, which appends them to the files as
+// text (space separated, '#' header), csv, or binary (header of magic
+// "ESPICDIA", # of columns and their names, then rows of doubles).
+class Diagnostics {
+  public:
+    enum Format { text, csv, binary };
+
+    /* Constructor */
+    // (file format, # of rows a channel buffers before a flush,
+    // suffix appended to file names)
+    explicit Diagnostics(Format fmt = text, int nflush = 1000,
+                         const std::string& suffix = "");
+
+    // flush remaining rows and wait for the writer
+    ~Diagnostics();
+
+    /* Public methods */
+    // register a channel written every n steps, return its id
+    int add_channel(const std::string& file,
+                    const std::vector<std::string>& columns, int every = 1);
+
+    // add a row of a channel at a step, ignored off its cadence
+    void record(int ich, int step, std::initializer_list<Real> values);
+    void record(int ich, int step, const std::vector<Real>& values);
+
+    // true if a channel takes a row at this step
+    bool is_due(int ich, int step) const { return 0 == step%channel_arr[ich].every; }
+
+    // hand all buffered rows to the writer
+    void flush();
+
+  private:
+    class Channel {
+      public:
+        std::string file;
+        std::vector<std::string> columns;
+        int every;
+        bool started;               // file created and header written
+        std::vector<Real> rows;     // buffered rows
+    };
+
+    // rows of one channel being written
+    class Block {
+      public:
+        int ich;
+        bool create;
+        std::vector<Real> rows;
+    };
+
+    Format format;
+    int nflush;
+    std::string suffix;
+    std::vector<Channel> channel_arr;
+    std::vector<Block> pending;     // owned by writer while it runs
+    std::thread writer;
+    bool failed;
+
+    void append_row(int, const Real*, std::size_t);
+    void write_blocks();
+    void write_header(FILE*, const Channel&) const;
+    void wait_writer();
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include "espic_info.h"
+#include "mesh.h"
+#include "domain.h"
+
+#ifdef USE_MPI
+namespace {
+
+inline MPI_Datatype mpi_real() { return sizeof(Real) == sizeof(double) ? MPI_DOUBLE : MPI_FLOAT; }
+
+}
+#endif
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Domain::Domain(const Mesh* mesh)
+  : irank(0),
+    nrank(1),
+    nn {mesh->num_nodes(0), mesh->num_nodes(1), mesh->num_nodes(2)},
+    ncx(mesh->num_cells(0)),
+    xlo(mesh->xmin()),
+    dxinv(1./mesh->dx()),
+    left(-1),
+    right(-1)
+{
+#ifdef USE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &irank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nrank);
+#endif
+  if (3 != mesh->dimension()) nn[2] = 1;
+  if (ncx < nrank) espic_error("Fewer cells along x than processes");
+
+  // equal # of cells per slab
+  cell_begin.resize(nrank+1);
+  for (int r = 0; r <= nrank; r++)
+    cell_begin[r] = static_cast<Index> (static_cast<long> (ncx)*r/nrank);
+
+  // the last node along a periodic x is a copy of the first one and not
+  // solved, the first slab's left neighbor is then the last slab
+  const bool periodic = (Mesh::FBCType::periodic == mesh->fbc_type(0));
+  const bool last = (irank == nrank-1);
+  ibeg = cell_begin[irank];
+  iend = last ? (periodic ? nn[0]-1 : nn[0]) : cell_begin[irank+1];
+  if (nrank > 1) {
+    left = (irank > 0) ? irank-1 : (periodic ? nrank-1 : -1);
+    right = !last ? irank+1 : (periodic ? 0 : -1);
+  }
+  ghost_lo = (periodic && 0 == irank) ? nn[0]-2 : ibeg-1;
+  ghost_hi = (periodic && last) ? 0 : iend;
+}
+
+/* ------------------------------------------------------- */
+
+Domain::~Domain()
+{
+}
+
+/* ------------------------------------------------------- */
+
+int Domain::owner(Real x) const
+{
+  if (1 == nrank) return 0;
+  Index c = std::min(std::max(static_cast<Index> (floor((x - xlo)*dxinv)), 0), ncx-1);
+  return static_cast<int> (std::upper_bound(cell_begin.begin(), cell_begin.end(), c)
+                           - cell_begin.begin()) - 1;
+}
+
+/* ------------------------------------------------------- */
+
+Particles::size_type Domain::select(Particles& pts) const
+{
+  if (!is_decomposed()) return pts.size();
+
+  Particles::size_type ip = 0;
+  while (ip < pts.size()) {
+    if (owns(pts[ip])) ip++;
+    else pts.erase(ip);       // last particle moved in
+  }
+  return pts.size();
+}
+
+/* ------------------------------------------------------- */
+
+void Domain::select(std::vector<Particle>& pts, Real xa, Real xb) const
+{
+  if (!is_decomposed()) return;
+
+  const int ra = owner(xa), rb = owner(xb);
+  auto keep = [this, ra, rb](const Particle& p) {
+    int r = owner(p.x());
+    return r == irank || (r < ra && irank == ra) || (r > rb && irank == rb);
+  };
+  pts.erase(std::remove_if(pts.begin(), pts.end(),
+                           [&keep](const Particle& p) { return !keep(p); }),
+            pts.end());
+}
+
+/* ------------------------------------------------------- */
+
+Particles::size_type Domain::migrate(const std::vector<Particles*>& pts_arr, std::vector<Real>& dke)
+{
+  const int nspec = static_cast<int> (pts_arr.size());
+  dke.assign(nspec, 0.);
+  if (!is_decomposed()) return 0;
+
+  Particles::size_type nsent = 0;
+#ifdef USE_MPI
+  // leaving particles by (destination, species)
+  outgoing.resize(nrank*nspec);
+  for (std::vector<Particle>& out : outgoing) out.clear();
+  for (int ispec = 0; ispec < nspec; ispec++) {
+    Particles& pts = *(pts_arr[ispec]);
+    Particles::size_type ip = 0;
+    while (ip < pts.size()) {
+      const Particle& p = pts[ip];
+      int r = owner(p.x());
+      if (r == irank) {
+        ip++;
+        continue;
+      }
+      outgoing[r*nspec + ispec].push_back(p);
+      dke[ispec] -= p.w()*(p.vx()*p.vx() + p.vy()*p.vy() + p.vz()*p.vz());
+      pts.erase(ip);
+      nsent++;
+    }
+  }
+
+  std::vector<int> nsend(nrank*nspec), nrecv(nrank*nspec);
+  for (int i = 0; i < nrank*nspec; i++) nsend[i] = static_cast<int> (outgoing[i].size());
+  MPI_Alltoall(nsend.data(), nspec, MPI_INT, nrecv.data(), nspec, MPI_INT, MPI_COMM_WORLD);
+
+  // one message per process, species after species, each one as
+  // arrays of x, y, z, vx, vy, vz and w
+  const int nfield = 7;
+  std::vector<int> scount(nrank), sdispl(nrank), rcount(nrank), rdispl(nrank);
+  int stot = 0, rtot = 0;
+  for (int r = 0; r < nrank; r++) {
+    int ns = 0, nr = 0;
+    for (int ispec = 0; ispec < nspec; ispec++) {
+      ns += nsend[r*nspec + ispec];
+      nr += nrecv[r*nspec + ispec];
+    }
+    scount[r] = nfield*ns;
+    rcount[r] = nfield*nr;
+    sdispl[r] = stot;
+    rdispl[r] = rtot;
+    stot += scount[r];
+    rtot += rcount[r];
+  }
+
+  sendbuf.resize(std::max(stot, 1));
+  recvbuf.resize(std::max(rtot, 1));
+  Real* out = sendbuf.data();
+  for (int i = 0; i < nrank*nspec; i++) {
+    const std::vector<Particle>& src = outgoing[i];
+    const std::size_t n = src.size();
+    for (std::size_t ip = 0; ip < n; ip++) {
+      const Particle& p = src[ip];
+      out[ip] = p.x();
+      out[n+ip] = p.y();
+      out[2*n+ip] = p.z();
+      out[3*n+ip] = p.vx();
+      out[4*n+ip] = p.vy();
+      out[5*n+ip] = p.vz();
+      out[6*n+ip] = p.w();
+    }
+    out += nfield*n;
+  }
+
+  MPI_Alltoallv(sendbuf.data(), scount.data(), sdispl.data(), mpi_real(),
+                recvbuf.data(), rcount.data(), rdispl.data(), mpi_real(), MPI_COMM_WORLD);
+
+  const Real* in = recvbuf.data();
+  for (int i = 0; i < nrank*nspec; i++) {
+    const std::size_t n = static_cast<std::size_t> (nrecv[i]);
+    if (0 == n) continue;
+    const int ispec = i%nspec;
+    Particles& pts = *(pts_arr[ispec]);
+    Particles::size_type i0 = pts.grow(n);
+    for (std::size_t ip = 0; ip < n; ip++) {
+      Particle& p = pts[i0+ip];
+      p.x() = in[ip];
+      p.y() = in[n+ip];
+      p.z() = in[2*n+ip];
+      p.vx() = in[3*n+ip];
+      p.vy() = in[4*n+ip];
+      p.vz() = in[5*n+ip];
+      p.w() = in[6*n+ip];
+      dke[ispec] += p.w()*(p.vx()*p.vx() + p.vy()*p.vy() + p.vz()*p.vz());
+    }
+    in += nfield*n;
+  }
+#endif
+  return nsent;
+}
+
+/* ------------------------------------------------------- */
+
+void Domain::exchange_halo(Real* f) const
+{
+  if (!is_decomposed()) return;
+
+  // first plane to the left, the right neighbor's one comes in
+  if (shift_plane(f, ibeg, left, right, 1)) {
+    for (Index k = 0; k < nn[2]; k++)
+      for (Index j = 0; j < nn[1]; j++)
+        f[node(ghost_hi, j, k)] = recvbuf[k*nn[1] + j];
+  }
+  // last plane to the right
+  if (shift_plane(f, iend-1, right, left, 2)) {
+    for (Index k = 0; k < nn[2]; k++)
+      for (Index j = 0; j < nn[1]; j++)
+        f[node(ghost_lo, j, k)] = recvbuf[k*nn[1] + j];
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Domain::sum_halo(Real* f) const
+{
+  if (!is_decomposed()) return;
+
+  // particles of a slab deposit to its nodes and the right neighbor's
+  // first plane
+  if (shift_plane(f, ghost_hi, right, left, 3)) {
+    for (Index k = 0; k < nn[2]; k++)
+      for (Index j = 0; j < nn[1]; j++)
+        f[node(ibeg, j, k)] += recvbuf[k*nn[1] + j];
+  }
+}
+
+/* ------------------------------------------------------- */
+
+Real Domain::max(Real v) const
+{
+#ifdef USE_MPI
+  if (is_decomposed())
+    MPI_Allreduce(MPI_IN_PLACE, &v, 1, mpi_real(), MPI_MAX, MPI_COMM_WORLD);
+#endif
+  return v;
+}
+
+/* ------------------------------------------------------- */
+
+Real Domain::min(Real v) const
+{
+#ifdef USE_MPI
+  if (is_decomposed())
+    MPI_Allreduce(MPI_IN_PLACE, &v, 1, mpi_real(), MPI_MIN, MPI_COMM_WORLD);
+#endif
+  return v;
+}
+
+/* ------------------------------------------------------- */
+
+long Domain::sum(long v) const
+{
+#ifdef USE_MPI
+  if (is_decomposed())
+    MPI_Allreduce(MPI_IN_PLACE, &v, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  return v;
+}
+
+/* ------------------------------------------------------- */
+
+void Domain::sum(std::vector<Real>& v) const
+{
+#ifdef USE_MPI
+  if (is_decomposed())
+    MPI_Allreduce(MPI_IN_PLACE, v.data(), static_cast<int> (v.size()), mpi_real(),
+                  MPI_SUM, MPI_COMM_WORLD);
+#endif
+}
+
+/* ------------------------------------------------------- */
+
+std::string Domain::file_suffix() const
+{
+  return is_decomposed() ? "." + std::to_string(irank) : "";
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+bool Domain::shift_plane(const Real* f, Index isend, int to, int from, int tag) const
+{
+#ifdef USE_MPI
+  const int np = static_cast<int> (nn[1]*nn[2]);
+  sendbuf.resize(np);
+  recvbuf.resize(np);
+  if (to >= 0) {
+    for (Index k = 0; k < nn[2]; k++)
+      for (Index j = 0; j < nn[1]; j++)
+        sendbuf[k*nn[1] + j] = f[node(isend, j, k)];
+  }
+  MPI_Sendrecv(sendbuf.data(), to >= 0 ? np : 0, mpi_real(), to >= 0 ? to : MPI_PROC_NULL, tag,
+               recvbuf.data(), np, mpi_real(), from >= 0 ? from : MPI_PROC_NULL, tag,
+               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  return from >= 0;
+#else
+  return false;
+#endif
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,95 @@
+#ifndef _DOMAIN_H
+#define _DOMAIN_H
+
+#include <string>
+#include <vector>
+#include "espic_type.h"
+#include "particles.h"
+
+// decomposition of the mesh into slabs of cells along x, one per process
+// (MPI, built with -DUSE_MPI)
+//
+// Every process keeps the node arrays of the whole mesh but solves and
+// pushes in its own slab only. Node planes at slab ends are exchanged
+// with the neighbors (charge summed, potential and field copied), and
+// particles that leave a slab are sent to its owner once per step, all
+// species packed in one message per process. Without MPI there is one
+// slab owning the mesh and all exchanges do nothing.
+class Domain {
+  public:
+    /* Constructor */
+    // (MPI must be initialized)
+    explicit Domain(const class Mesh*);
+
+    ~Domain();
+
+    /* Public methods */
+    int rank() const { return irank; }
+    int num_ranks() const { return nrank; }
+    bool is_root() const { return 0 == irank; }
+    bool is_decomposed() const { return nrank > 1; }
+
+    // nodes along x solved by this process, [node_begin, node_end)
+    Index node_begin() const { return ibeg; }
+    Index node_end() const { return iend; }
+
+    // x-range of the cells of this slab
+    Real xmin() const { return xlo + cell_begin[irank]/dxinv; }
+    Real xmax() const { return xlo + cell_begin[irank+1]/dxinv; }
+
+    // process owning the cell of x (out-of-domain points go to the nearest)
+    int owner(Real x) const;
+    bool owns(const Particle& p) const { return irank == owner(p.x()); }
+
+    // drop particles of other slabs from a set every process holds in
+    // full (initial load), return # kept
+    Particles::size_type select(Particles&) const;
+
+    // drop particles of other slabs from a set generated in full by the
+    // processes whose slabs meet [xa, xb]; those beyond these slabs stay
+    // with the process at that end and migrate after the push
+    void select(std::vector<Particle>&, Real xa, Real xb) const;
+
+    // send particles that left this slab to their owners and append
+    // those arriving, dke[ispec] gets the change of sum of w*v^2,
+    // return # of particles sent
+    Particles::size_type migrate(const std::vector<Particles*>&, std::vector<Real>& dke);
+
+    // copy the boundary node planes of the neighbors to the ghost planes
+    // of a node array
+    void exchange_halo(Real*) const;
+
+    // add charge deposited to the first plane of the right neighbor
+    void sum_halo(Real*) const;
+
+    // reductions over all processes
+    Real max(Real) const;
+    Real min(Real) const;
+    long sum(long) const;
+    void sum(std::vector<Real>&) const;
+
+    // "" for a single process, ".<rank>" otherwise, appended to names of
+    // files written by each process
+    std::string file_suffix() const;
+
+  private:
+    int irank, nrank;
+    Index nn[3];                  // # of nodes in x, y and z
+    Index ncx;                    // # of cells in x
+    Real xlo, dxinv;
+    std::vector<Index> cell_begin;  // first cell of each slab, nrank+1
+    Index ibeg, iend;
+    Index ghost_lo, ghost_hi;     // planes of the neighbors' boundary nodes
+    int left, right;              // neighbor ranks, -1 if none
+
+    mutable std::vector<Real> sendbuf, recvbuf;
+    std::vector<std::vector<Particle>> outgoing;   // by destination, species
+
+    Index node(Index i, Index j, Index k) const { return (k*nn[1] + j)*nn[0] + i; }
+
+    // send node plane isend to rank "to", receive a plane from rank
+    // "from" to recvbuf, return true if one is received
+    bool shift_plane(const Real*, Index isend, int to, int from, int tag) const;
+};
+
+#endif
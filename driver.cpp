@@ -0,0 +1,365 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "espic_info.h"
+#include "espic_memory.h"
+#include "control.h"
+#include "mesh.h"
+#include "species.h"
+#include "particles.h"
+#include "field.h"
+#include "tile.h"
+#include "checkpoint.h"
+#include "diagnostics.h"
+#include "domain.h"
+#include "tile_schedule.h"
+#include "driver.h"
+
+using std::cout;
+using std::endl;
+using std::setw;
+
+// name and unit of work counted in each phase
+static const char* phase_name[] = {
+  "inject", "push", "migrate", "resample", "deposit", "solve", "collide", "diag", "ckpt"
+};
+static const char* phase_unit[] = {
+  "particles", "particles", "particles", "particles", "particles", "iterations",
+  "collisions", "rows", "particles"
+};
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Driver::Driver(const Control* ctrl, Mesh* msh, Tile* tl, Field* fld, Diagnostics* diag,
+               const Domain* dom)
+  : control(ctrl),
+    mesh(msh),
+    tile(tl),
+    field(fld),
+    checkpoint(new Checkpoint(ctrl->checkpoint_file() + dom->file_suffix())),
+    diagnostics(diag),
+    domain(dom),
+    istart(0),
+    step0(0)
+{
+  std::vector<std::string> columns = { "step", "time" };
+  for (int ispec = 0; ispec < tile->num_species(); ispec++) {
+    const std::string& name = tile->get_species(ispec)->name;
+    columns.push_back("np(" + name + ")");
+    columns.push_back("ke(" + name + ")");
+  }
+  history = diagnostics->add_channel("history.dat", columns, control->diag_interval());
+  tile->SetDiagnostics(diagnostics, control->diag_interval());
+}
+
+/* ------------------------------------------------------- */
+
+Driver::~Driver()
+{
+  delete checkpoint;
+}
+
+/* ------------------------------------------------------- */
+
+void Driver::run()
+{
+  const Real dt = control->time_step();
+  const int nsteps = control->num_steps();
+  const int nreport = control->report_interval();
+  const int ndiag = control->diag_interval();
+  const int nsweep = control->energy_sweep();
+  Real curr_time = 0.;
+
+  init_population();
+  init_balance();
+
+  // kinetic energy is kept up to date by the push, collisions,
+  // injection and losses from here on
+  for (int ispec = 0; ispec < tile->num_species(); ispec++)
+    tile->get_species(ispec)->get_particles_energy();
+
+  // continue from a checkpoint, which keeps the energy of its species,
+  // the potential they were last pushed in and the sub-cycle state
+  bool restored = false;
+  if (!control->restart_file().empty()) {
+    istart = checkpoint->read(control->restart_file() + domain->file_suffix(),
+                              tile, field, curr_time);
+    restored = checkpoint->read_field();
+  }
+  step0 = istart;
+
+  if (!restored) {
+    // field of the initial particles
+    tile->DepositCharge(field);
+    field->solve();
+
+    // sub-cycled species start their frozen density and averaged field
+    init_subcycle(dt);
+  }
+
+  cout << "Time loop starts with dt = " << dt << " for " << nsteps << " steps" << endl;
+  wall0 = wall_report = std::chrono::steady_clock::now();
+
+  const int iend = istart + nsteps;
+  for (int istep = istart+1; istep <= iend; istep++) {
+    timer[inject].start();
+    long ninj = static_cast<long> (tile->InjectParticles(dt));
+    timer[inject].stop(ninj);
+
+    timer[push].start();
+    long npush = static_cast<long> (tile->ParticlePush(dt, field, istep));
+    tile->ReduceLostParticles(curr_time + dt);
+    timer[push].stop(npush);
+
+    timer[migrate].start();
+    long nmig = static_cast<long> (tile->MigrateParticles(istep));
+    timer[migrate].stop(nmig);
+
+    curr_time += dt;
+
+    timer[resample].start();
+    long nres = static_cast<long> (tile->ControlPopulation(istep));
+    timer[resample].stop(nres);
+
+    timer[deposit].start();
+    long ndep = static_cast<long> (tile->DepositCharge(field, istep));
+    timer[deposit].stop(ndep);
+
+    timer[solve].start();
+    long niter = field->solve();
+    timer[solve].stop(niter);
+
+    timer[collide].start();
+    long ncoll = 0;
+    if (control->is_collision_on())
+      ncoll = static_cast<long> (tile->ParticleCollisioninTiles(dt, istep));
+    timer[collide].stop(ncoll);
+
+    timer[diag].start();
+    long nrow = 0;
+    // drop round-off accumulated by the incremental energy, on request
+    // only, so the energies do not depend on the report interval
+    if (nsweep > 0 && 0 == istep%nsweep) {
+      for (int ispec = 0; ispec < tile->num_species(); ispec++)
+        tile->get_species(ispec)->get_particles_energy();
+    }
+    if (0 == istep%ndiag) {
+      write_diag(istep, curr_time);
+      nrow++;
+    }
+    timer[diag].stop(nrow);
+
+    // only the snapshot is in the time loop, the file is written in background
+    timer[ckpt].start();
+    long nsnap = 0;
+    if (control->checkpoint_interval() > 0 && 0 == istep%control->checkpoint_interval())
+      nsnap = static_cast<long> (checkpoint->write(istep, curr_time, tile, field));
+    timer[ckpt].stop(nsnap);
+
+    if (nreport > 0 && 0 == istep%nreport && istep < iend)
+      report(istep, curr_time, false);
+  }
+
+  report(iend, curr_time, true);
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void Driver::init_population()
+{
+  for (const PopulationDef& pop : control->population_list()) {
+    int ispec = 0;
+    while (ispec < tile->num_species() && tile->get_species(ispec)->name != pop.species) ispec++;
+    if (ispec == tile->num_species())
+      espic_error("Unknown species [" + pop.species + "] in population command");
+    tile->SetPopulation(ispec, pop.nmin, pop.nmax, pop.every);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Driver::init_balance()
+{
+  tile->SetBalance(control->balance_threshold(), control->candidate_cost());
+  for (const auto& cost : control->particle_cost_list()) {
+    int ispec = 0;
+    while (ispec < tile->num_species() && tile->get_species(ispec)->name != cost.first) ispec++;
+    if (ispec == tile->num_species())
+      espic_error("Unknown species [" + cost.first + "] in balance command");
+    tile->SetParticleCost(ispec, cost.second);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Driver::init_subcycle(Real dt)
+{
+  const int nspecies = tile->num_species();
+  std::vector<int> nsub(nspecies, 1);
+
+  if (control->is_subcycle_auto()) {
+    // heavy species are pushed every sqrt(m/m_min) steps, limited so that
+    // they move at most half a cell per push at the speed of the fastest
+    // particle accelerated through the whole potential drop
+    const Real cfl = 0.5;
+    const Real hmin = (3 == mesh->dimension())
+      ? std::min(std::min(mesh->dx(), mesh->dy()), mesh->dz())
+      : std::min(mesh->dx(), mesh->dy());
+    const Real dphi = field->potential_range();
+
+    Real mmin = 0.;
+    for (int ispec = 0; ispec < nspecies; ispec++) {
+      const Species* species = tile->get_species(ispec);
+      if (0. == species->charge) continue;
+      if (0. == mmin || species->mass < mmin) mmin = species->mass;
+    }
+
+    for (int ispec = 0; ispec < nspecies && mmin > 0.; ispec++) {
+      Species* species = tile->get_species(ispec);
+      if (0. == species->charge) continue;
+
+      Real v2max = 0.;
+      const Particles& pts = *(species->particles);
+      for (Particles::size_type ip = 0; ip < pts.size(); ip++) {
+        const Particle& pt = pts[ip];
+        v2max = std::max(v2max, Real(pt.vx())*pt.vx() + Real(pt.vy())*pt.vy()
+                                + Real(pt.vz())*pt.vz());
+      }
+      Real vmax = sqrt(v2max + 2.*fabs(species->charge)*dphi/species->mass);
+
+      Real nmass = sqrt(species->mass/mmin);
+      Real ncfl = vmax > 0. ? cfl*hmin/(vmax*dt) : nmass;
+      Real n = std::min(std::min(nmass, ncfl), static_cast<Real> (control->subcycle_max()));
+      nsub[ispec] = std::max(static_cast<int> (n), 1);
+    }
+  }
+
+  for (const auto& sub : control->subcycle_list()) {
+    int ispec = 0;
+    while (ispec < nspecies && tile->get_species(ispec)->name != sub.first) ispec++;
+    if (ispec == nspecies)
+      espic_error("Unknown species [" + sub.first + "] in subcycle command");
+    nsub[ispec] = sub.second;
+  }
+
+  bool any = false;
+  for (int ispec = 0; ispec < nspecies; ispec++) {
+    if (1 == nsub[ispec]) continue;
+    tile->SetSubcycle(ispec, nsub[ispec], field);
+    any = true;
+    cout << "Push species " << tile->get_species(ispec)->name
+      << " every " << nsub[ispec] << " steps" << endl;
+  }
+
+  // restart from the frozen density of the sub-cycled species
+  if (any) {
+    tile->DepositCharge(field, 0);
+    field->solve();
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Driver::write_diag(int istep, Real curr_time)
+{
+  // totals over all processes, written by the first one
+  std::vector<Real> row = { static_cast<Real> (istep), curr_time };
+  for (int ispec = 0; ispec < tile->num_species(); ispec++) {
+    Species* species = tile->get_species(ispec);
+    row.push_back(static_cast<Real> (species->num_particles()));
+    row.push_back(species->toten*species->weight);
+  }
+  std::vector<Real> total(row.begin()+2, row.end());
+  domain->sum(total);
+  std::copy(total.begin(), total.end(), row.begin()+2);
+  if (domain->is_root()) diagnostics->record(history, istep, row);
+}
+
+/* ------------------------------------------------------- */
+
+void Driver::report(int istep, Real curr_time, bool final)
+{
+  // rates over the last interval for a periodic report,
+  // over the whole run for the final one
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<Real> wall = now - (final ? wall0 : wall_report);
+  int nstep = final ? istep - istart : istep - step0;
+
+  Real tphase = 0.;
+  for (int p = 0; p < nphases; p++)
+    tphase += final ? timer[p].time : timer[p].time - timer[p].time0;
+
+  long nparts = 0;
+  for (int ispec = 0; ispec < tile->num_species(); ispec++)
+    nparts += static_cast<long> (tile->get_species(ispec)->num_particles());
+  nparts = domain->sum(nparts);
+  long nlost = domain->sum(static_cast<long> (tile->num_lost()));
+
+  std::ios_base::fmtflags flags = cout.flags();
+  std::streamsize prec = cout.precision();
+
+  cout << (final ? "End of run" : "Performance") << " at step " << istep
+    << ", t = " << curr_time << ", " << nparts << " particles, "
+    << nstep << " steps in " << wall.count() << " s ("
+    << 1e3*wall.count()/std::max(nstep, 1) << " ms/step)\n";
+  cout << "  " << std::left << setw(9) << "phase" << std::right
+    << setw(12) << "time(s)" << setw(8) << "share"
+    << setw(14) << "count" << setw(14) << "rate(/s)" << "  unit\n";
+
+  for (int p = 0; p < nphases; p++) {
+    const PhaseTimer& t = timer[p];
+    Real time = final ? t.time : t.time - t.time0;
+    long count = final ? t.count : t.count - t.count0;
+    cout << "  " << std::left << setw(9) << phase_name[p] << std::right
+      << std::fixed << std::setprecision(4) << setw(12) << time
+      << std::setprecision(1) << setw(7) << 100.*time/std::max(tphase, 1e-30) << "%"
+      << setw(14) << count
+      << std::scientific << std::setprecision(3)
+      << setw(14) << (time > 0. ? count/time : 0.)
+      << "  " << phase_unit[p] << "\n";
+    cout.flags(flags);
+  }
+  cout.precision(prec);
+
+  cout << "  field solve: " << static_cast<Real> (final ? timer[solve].count
+                                 : timer[solve].count - timer[solve].count0)/std::max(nstep, 1)
+    << " iterations/step, last residual " << field->last_residual()
+    << "; particles lost in last push: " << nlost << endl;
+  if (final) {
+    // high-water mark of resident memory (ru_maxrss is in bytes on macOS)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    Real peak = usage.ru_maxrss/1048576.;
+#else
+    Real peak = usage.ru_maxrss/1024.;
+#endif
+    cout << "  peak memory: " << peak << " MB" << endl;
+    cout << "  memory placement: " << ESPIC::Memory::summary() << endl;
+  }
+  const TileSchedule* schedule = tile->tile_schedule();
+  if (nullptr != schedule && control->is_collision_on())
+    cout << "  tiles on " << schedule->num_threads() << " threads: imbalance (max/mean cost) "
+      << schedule->imbalance() << " in last step, " << schedule->max_imbalance()
+      << " at most, " << schedule->num_reassign() << " reassignments" << endl;
+  if (domain->is_decomposed())
+    cout << "  " << domain->num_ranks() << " processes, phase times of process 0" << endl;
+  if (control->checkpoint_interval() > 0)
+    cout << "  checkpoint: " << checkpoint->stall_time()
+      << " s waited for background writer in total" << endl;
+
+  if (!final) {
+    for (int p = 0; p < nphases; p++) timer[p].checkpoint();
+    step0 = istep;
+    wall_report = now;
+  }
+}
+
+/* ----------------- End Private Methods ----------------- */
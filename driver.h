@@ -0,0 +1,70 @@
+#ifndef _DRIVER_H
+#define _DRIVER_H
+
+#include <chrono>
+#include "espic_type.h"
+
+class Driver {
+  public:
+    /* Constructor */
+    Driver(const class Control*, class Mesh*, class Tile*, class Field*,
+           class Diagnostics*, const class Domain*);
+
+    ~Driver();
+
+    /* Public methods */
+    // run the time loop, one step is
+    // inject -> push/scrape -> migrate -> merge/split -> deposit
+    // -> field solve -> collide -> diagnostics -> checkpoint
+    void run();
+
+  private:
+    enum Phase { inject, push, migrate, resample, deposit, solve, collide, diag, ckpt, nphases };
+
+    // wall time and work count of one phase
+    class PhaseTimer {
+      public:
+        PhaseTimer() : ncalls(0), count(0), time(0.), count0(0), time0(0.) { }
+
+        void start() { t0 = std::chrono::steady_clock::now(); }
+
+        void stop(long n) {
+          std::chrono::duration<Real> elapsed = std::chrono::steady_clock::now() - t0;
+          time += elapsed.count();
+          count += n;
+          ncalls++;
+        }
+
+        // mark the start of a new report interval
+        void checkpoint() { count0 = count; time0 = time; }
+
+        std::chrono::steady_clock::time_point t0;
+        long ncalls;
+        long count;       // particles, iterations or collisions
+        Real time;        // seconds
+        long count0;      // count and time at last report
+        Real time0;
+    };
+
+    const class Control* control;
+    class Mesh* mesh;
+    class Tile* tile;
+    class Field* field;
+    class Checkpoint* checkpoint;
+    class Diagnostics* diagnostics;
+    const class Domain* domain;
+    int history;                  // channel of history.dat
+
+    PhaseTimer timer[nphases];
+    int istart;                   // step the run starts from
+    int step0;                    // step of last report
+    std::chrono::steady_clock::time_point wall0, wall_report;
+
+    void init_subcycle(Real);
+    void init_population();
+    void init_balance();
+    void write_diag(int, Real);
+    void report(int, Real, bool);
+};
+
+#endif
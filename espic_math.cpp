@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include "espic_info.h"
 #include "espic_math.h"
 
 using namespace ESPIC;
@@ -33,6 +35,72 @@ Real newton_raphson(const std::function< Real(Real) >& f,
 
 // define and initialize global seed for random number generator
 Bigint Random::seed = 0;
+uint64_t Random::nstream = 0;
+bool Random::reproducible = false;
+
+uint64_t Random::global_seed()
+{
+  if (seed < 0) {
+    std::random_device rd;
+    seed = static_cast<Bigint> (rd() & 0x7fffffff);
+  }
+  return static_cast<uint64_t> (seed);
+}
+
+/* ------------------------------------------------------- */
+
+Halton::Halton(int ndim, unsigned seed)
+{
+  const int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19 };
+  const int nprimes = sizeof(primes)/sizeof(int);
+  if (ndim > nprimes) espic_error("Halton sequence supports up to 8 dimensions");
+
+  std::mt19937 g(seed);
+  base.assign(primes, primes+ndim);
+  perm.resize(ndim);
+  for (int d = 0; d < ndim; d++) {
+    // digit 0 stays fixed so trailing zeros contribute nothing
+    perm[d].resize(base[d]);
+    for (int k = 0; k < base[d]; k++) perm[d][k] = k;
+    std::shuffle(perm[d].begin()+1, perm[d].end(), g);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+Real inv_normal_cdf(Real p)
+{
+  // rational approximation by P. J. Acklam, relative error < 1.2e-9
+  static const Real a[6] = { -3.969683028665376e+01,  2.209460984245205e+02,
+                             -2.759285104469687e+02,  1.383577518672690e+02,
+                             -3.066479806614716e+01,  2.506628277459239e+00 };
+  static const Real b[5] = { -5.447609879822406e+01,  1.615858368580409e+02,
+                             -1.556989798598866e+02,  6.680131188771972e+01,
+                             -1.328068155288572e+01 };
+  static const Real c[6] = { -7.784894002430293e-03, -3.223964580411365e-01,
+                             -2.400758277161838e+00, -2.549732539343734e+00,
+                              4.374664141464968e+00,  2.938163982698783e+00 };
+  static const Real d[4] = {  7.784695709041462e-03,  3.224671290700398e-01,
+                              2.445134137142996e+00,  3.754408661907416e+00 };
+  const Real plow = 0.02425, phigh = 1. - plow;
+  Real q, r;
+
+  if (p < plow) {
+    q = sqrt(-2.*log(p));
+    return (((((c[0]*q+c[1])*q+c[2])*q+c[3])*q+c[4])*q+c[5]) /
+            ((((d[0]*q+d[1])*q+d[2])*q+d[3])*q+1.);
+  }
+  else if (p > phigh) {
+    q = sqrt(-2.*log(1.-p));
+    return -(((((c[0]*q+c[1])*q+c[2])*q+c[3])*q+c[4])*q+c[5]) /
+             ((((d[0]*q+d[1])*q+d[2])*q+d[3])*q+1.);
+  }
+  
+  q = p - 0.5;
+  r = q*q;
+  return (((((a[0]*r+a[1])*r+a[2])*r+a[3])*r+a[4])*r+a[5])*q /
+         (((((b[0]*r+b[1])*r+b[2])*r+b[3])*r+b[4])*r+1.);
+}
 
 
 }
@@ -4,6 +4,7 @@
 #include <functional>
 #include <limits>
 #include <random>
+#include <vector>
 #include <cmath>
 
 #include "espic_type.h"
@@ -22,51 +23,100 @@ namespace ESPIC{
   static std::vector<Real> velbuffer; // Store Random Vel bd
 
   /* class of random number generators */
-  /* generate uniform distributions in [0, 1)*/
+  /* generate uniform distributions in [0, 1) by SplitMix64 */
+  /* a stream is either the next one of the global seed (in order of */
+  /* construction), or keyed by (step, stream, id) with set_key, so the */
+  /* numbers of a parallel loop do not depend on which thread draws them */
   class Random {
     public :
       /* Constructor */
-      Random() : p{0.0, 1.0} 
-      {
-        if (seed < 0) {
-          auto rs = std::bind(std::uniform_int_distribution<> (), 
-                              std::default_random_engine ());
-          seed = rs();
-        }
-        else {
-          auto rs = std::bind(std::uniform_int_distribution<> (), 
-                              std::default_random_engine (seed));
-          seed = rs();
-        }
-        
-        rf = std::bind(std::uniform_real_distribution<Real> {p},
-            std::default_random_engine(seed));
-      }
+      Random() : state(mix(global_seed() + PHI*(++nstream))) { }
 
-      Real operator() () const { return rf(); }     // generator a random number
+      Real operator() () const { return uniform_dist(); }     // generator a random number
 
-      Real uniform_dist() const { return rf(); }
+      Real uniform_dist() const { return (next() >> 11)*0x1.0p-53; }
 
       Real normal_dist_factor() const {
-        Real r = rf();
+        Real r = uniform_dist();
         while(r <= SMALLREAL) {
-          r = rf();
+          r = uniform_dist();
         }
         return sqrt(-log(r));
       }
 
-      Bigint get_seed() const   { return seed; }
+      // restart the stream from a key, e.g. (step, species, particle or
+      // cell index) of a parallel loop
+      void set_key(uint64_t step, uint64_t stream, uint64_t id) const {
+        state = mix(mix(mix(global_seed() ^ step) + stream) + id);
+      }
+
+      // stream part of the keys of generators made outside the parallel
+      // loops, apart from the reaction indices keying collisions
+      enum StreamTag : uint64_t { global_stream = 0x474c4f42ULL, inject_stream = 0x494e4aULL,
+                                 population_stream = 0x504f50ULL };
+
+      // state to carry over a restart
+      uint64_t get_state() const { return state; }
+      void set_state(uint64_t s) { state = s; }
+
+      static Bigint get_seed() { return static_cast<Bigint> (global_seed()); }
 
       static void set_seed(Bigint s) { seed = s; }
 
-      
+      // draw from seeded streams only (no random_device or clock),
+      // set by "seed" of control.in
+      static bool is_reproducible() { return reproducible; }
+      static void set_reproducible(bool r) { reproducible = r; }
 
     private :
+      static const uint64_t PHI = 0x9e3779b97f4a7c15ULL;
       static Bigint seed;
-      std::uniform_real_distribution<Real>::param_type p;
-      std::function<Real()> rf;
+      static uint64_t nstream;
+      static bool reproducible;
+      mutable uint64_t state;
+
+      static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+      }
+
+      uint64_t next() const { return mix(state += PHI); }
+
+      // a negative seed is replaced by a random one at first use
+      static uint64_t global_seed();
   };
 
+  /* scrambled Halton sequence (low-discrepancy) for quiet start */
+  /* point i in dimension d is the radical inverse of i in the d-th */
+  /* prime base with randomly permuted non-zero digits, in (0, 1) for i > 0 */
+  class Halton {
+    public :
+      /* Constructor */
+      Halton(int ndim, unsigned seed);
+
+      Real operator() (uint64_t i, int d) const {
+        const int b = base[d];
+        const int* p = perm[d].data();
+        Real binv = 1./b, f = 1., r = 0.;
+        while (i > 0) {
+          f *= binv;
+          r += f*p[i % b];
+          i /= b;
+        }
+        return r;
+      }
+
+      int dimension() const { return static_cast<int> (base.size()); }
+
+    private :
+      std::vector<int> base;
+      std::vector<std::vector<int> > perm;
+  };
+
+  // inverse of the standard normal cumulative distribution
+  Real inv_normal_cdf(Real);
+
 inline void cross_prod(const Real vecA[3], const Real vecB[3], Real vecC[3])                                      
 {
   double temp[3];
@@ -83,16 +133,16 @@ inline void cross_prod(const Real vecA[3], const Real vecB[3], Real vecC[3])
 extern ESPIC::Random ranf;
 
 
-inline void VelBoltzDistr(Real vth, Real& vx, Real& vy, Real& vz)
+inline void VelBoltzDistr(Real vth, Real& vx, Real& vy, Real& vz,
+                          const ESPIC::Random& rnd = ranf)
 {
-    ESPIC::Random ranf;
-    Real vrf = vth * ranf.normal_dist_factor();
-    Real trf = ESPIC::PI2 * ranf();
+    Real vrf = vth * rnd.normal_dist_factor();
+    Real trf = ESPIC::PI2 * rnd();
     vx = vrf * cos(trf);
     vy = vrf * sin(trf);
     
-    vrf = vth * ranf.normal_dist_factor();
-    trf = ESPIC::PI2 * ranf();
+    vrf = vth * rnd.normal_dist_factor();
+    trf = ESPIC::PI2 * rnd();
     vz = vrf * cos(trf);
     // velbuffer.emplace_back(vrf*sin(trf));
 }
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#ifdef OMP
+#include <omp.h>
+#endif
+
+#include "espic_info.h"
+#include "espic_memory.h"
+
+using namespace ESPIC;
+
+std::vector<std::vector<int>> Memory::node_cpus(1);
+bool Memory::huge = false;
+bool Memory::bound = false;
+
+namespace {
+
+const std::size_t huge_page_bytes = 2 << 20;
+
+// "0-3,8-11" to a list of cpus
+std::vector<int> parse_cpulist(const std::string& s)
+{
+  std::vector<int> cpus;
+  std::stringstream ss(s);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || '\n' == range[0]) continue;
+    std::size_t dash = range.find('-');
+    int lo = std::stoi(range.substr(0, dash));
+    int hi = (std::string::npos == dash) ? lo : std::stoi(range.substr(dash+1));
+    for (int c = lo; c <= hi; c++) cpus.push_back(c);
+  }
+  return cpus;
+}
+
+}
+
+/* ---------------- Begin Public Methods ---------------- */
+
+void Memory::init(bool huge_pages, bool bind)
+{
+  huge = huge_pages;
+
+  node_cpus.clear();
+#ifdef __linux__
+  for (int n = 0; ; n++) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+    if (!in) break;
+    std::string line;
+    std::getline(in, line);
+    node_cpus.push_back(parse_cpulist(line));
+  }
+#endif
+  if (node_cpus.empty()) node_cpus.resize(1);
+
+  if (bind) bind_threads();
+}
+
+/* ------------------------------------------------------- */
+
+int Memory::thread_node(int ithrd, int nthreads)
+{
+  return static_cast<int> (static_cast<long> (ithrd)*num_nodes()/std::max(nthreads, 1));
+}
+
+/* ------------------------------------------------------- */
+
+void* Memory::allocate(std::size_t bytes)
+{
+  if (bytes < large_bytes) return ::operator new(bytes);
+
+  // huge pages need a mapping aligned to them, map more and trim
+  const std::size_t len = (bytes + page_bytes() - 1)/page_bytes()*page_bytes();
+  const std::size_t pad = huge ? huge_page_bytes : 0;
+  void* map = mmap(nullptr, len + pad, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == map) throw std::bad_alloc();
+
+  char* p = static_cast<char*> (map);
+  if (huge) {
+    std::size_t head = (huge_page_bytes - reinterpret_cast<std::size_t> (p)%huge_page_bytes)
+                       %huge_page_bytes;
+    if (head > 0) munmap(p, head);
+    if (pad > head) munmap(p + head + len, pad - head);
+    p += head;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+  }
+  return p;
+}
+
+/* ------------------------------------------------------- */
+
+void Memory::deallocate(void* p, std::size_t bytes)
+{
+  if (nullptr == p) return;
+  if (bytes < large_bytes) {
+    ::operator delete(p);
+    return;
+  }
+  const std::size_t len = (bytes + page_bytes() - 1)/page_bytes()*page_bytes();
+  munmap(p, len);
+}
+
+/* ------------------------------------------------------- */
+
+std::string Memory::summary()
+{
+  std::string s = std::to_string(num_nodes()) + (1 == num_nodes() ? " node" : " nodes");
+  s += huge ? ", huge pages" : "";
+  s += bound ? ", threads bound" : "";
+  return s;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+std::size_t Memory::page_bytes()
+{
+  static const std::size_t bytes = static_cast<std::size_t> (sysconf(_SC_PAGESIZE));
+  return bytes;
+}
+
+/* ------------------------------------------------------- */
+
+void Memory::bind_threads()
+{
+#if defined(__linux__) && defined(OMP)
+  bool ok = true;
+#pragma omp parallel reduction(&&:ok)
+  {
+    const std::vector<int>& cpus = node_cpus[thread_node(omp_get_thread_num(), omp_get_num_threads())];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) CPU_SET(c, &set);
+    ok = !cpus.empty() && 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+  bound = ok;
+  if (!bound) espic_warning("Failed to bind threads to NUMA nodes");
+#else
+  espic_warning("Binding threads to NUMA nodes needs OpenMP on Linux, ignored");
+#endif
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,74 @@
+#ifndef _ESPIC_MEMORY_H
+#define _ESPIC_MEMORY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "espic_type.h"
+
+namespace ESPIC {
+
+  // placement of large particle and field arrays on NUMA nodes
+  //
+  // Arrays of at least large_bytes are mapped directly, optionally on
+  // huge pages. Their pages are placed by the first thread to write them;
+  // push, deposit and the field solve are serial, so they stay on the
+  // node of the main thread. Threads may be bound to the nodes (in
+  // thread order, an equal share per node); tiles then stay on the node
+  // of the thread their run of the tile schedule belongs to. Nodes and
+  // their cpus are read from /sys on Linux, elsewhere there is one node
+  // and binding does nothing.
+  class Memory {
+    public:
+      static const std::size_t large_bytes = 1 << 20;
+
+      // read node layout, set the policy (call before large arrays are
+      // allocated, binding needs the OpenMP thread pool)
+      static void init(bool huge_pages, bool bind);
+
+      static int num_nodes() { return static_cast<int> (node_cpus.size()); }
+      static bool huge_pages() { return huge; }
+      static bool threads_bound() { return bound; }
+
+      // node thread ithrd of nthreads is bound to (expected to run on)
+      static int thread_node(int ithrd, int nthreads);
+
+      static void* allocate(std::size_t bytes);
+      static void deallocate(void*, std::size_t bytes);
+
+      // e.g. "2 nodes, threads bound, huge pages"
+      static std::string summary();
+
+    private:
+      static std::vector<std::vector<int>> node_cpus;
+      static bool huge, bound;
+
+      static std::size_t page_bytes();
+      static void bind_threads();
+  };
+
+  // allocator of containers that hold particle and field arrays
+  template <typename T>
+  class NumaAllocator {
+    public:
+      typedef T value_type;
+
+      NumaAllocator() noexcept { }
+      template <typename U> NumaAllocator(const NumaAllocator<U>&) noexcept { }
+
+      T* allocate(std::size_t n) {
+        return static_cast<T*> (Memory::allocate(n*sizeof(T)));
+      }
+      void deallocate(T* p, std::size_t n) noexcept {
+        Memory::deallocate(static_cast<void*> (p), n*sizeof(T));
+      }
+  };
+
+  template <typename T, typename U>
+  bool operator==(const NumaAllocator<T>&, const NumaAllocator<U>&) { return true; }
+  template <typename T, typename U>
+  bool operator!=(const NumaAllocator<T>&, const NumaAllocator<U>&) { return false; }
+
+}
+
+#endif
@@ -13,6 +13,20 @@
 typedef double Real;
 //typedef float Real;
 
+// scalars of particle storage, fields and sums stay in Real:
+// -DPARTICLE_MIXED stores velocity and weight in float,
+// -DPARTICLE_SINGLE position too
+#if defined(PARTICLE_SINGLE)
+typedef float PosReal;
+typedef float VelReal;
+#elif defined(PARTICLE_MIXED)
+typedef double PosReal;
+typedef float VelReal;
+#else
+typedef Real PosReal;
+typedef Real VelReal;
+#endif
+
 typedef int Smallint;
 typedef int Bigint;
 
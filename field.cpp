@@ -0,0 +1,581 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "espic_info.h"
+#include "espic_math.h"
+#include "mesh.h"
+#include "particles.h"
+#include "domain.h"
+#include "field.h"
+#include "geometry.h"
+
+using namespace ESPIC;
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Field::Field(const Mesh* msh, Real _tol, int _maxiter, Real _omega)
+  : mesh(msh),
+    domain(nullptr),
+    ndim(msh->dimension()),
+    axi(5 == msh->dimension()),
+    nn {msh->num_nodes(0), msh->num_nodes(1), msh->num_nodes(2)},
+    lo {msh->xmin(), msh->ymin(), msh->zmin()},
+    hi {msh->xmax(), msh->ymax(), msh->zmax()},
+    h {msh->dx(), msh->dy(), msh->dz()},
+    tol(_tol),
+    maxiter(_maxiter),
+    omega(_omega),
+    residual(0.)
+{
+  for (int a = 0; a < 3; a++) {
+    hinv[a] = 1./h[a];
+    periodic[a] = (Mesh::FBCType::periodic == mesh->fbc_type(2*a));
+  }
+  if (3 != ndim) periodic[2] = false;
+  ibeg = 0;
+  iend = periodic[0] ? nn[0]-1 : nn[0];
+
+  Index nnd = mesh->num_nodes();
+  rho.assign(nnd, 0.);
+  phi.assign(nnd, 0.);
+  ex.assign(nnd, 0.);
+  ey.assign(nnd, 0.);
+  ez.assign(nnd, 0.);
+  fixed.assign(nnd, 0);
+
+  init_boundary();
+  init_volume();
+
+  with_geometry(ndim, [this](auto g) { ptr_deposit = &Field::deposit_to<decltype(g)>; });
+}
+
+/* ------------------------------------------------------- */
+
+Field::~Field()
+{
+}
+
+/* ------------------------------------------------------- */
+
+void Field::decompose(const Domain* dom)
+{
+  if (!dom->is_decomposed()) return;
+  domain = dom;
+  ibeg = domain->node_begin();
+  iend = domain->node_end();
+}
+
+/* ------------------------------------------------------- */
+
+void Field::reset_charge()
+{
+  std::fill(rho.begin(), rho.end(), 0.);
+}
+
+/* ------------------------------------------------------- */
+
+void Field::deposit(const Particles& particles, Real qw)
+{
+  (this->*ptr_deposit)(rho, particles, qw);
+}
+
+/* ------------------------------------------------------- */
+
+void Field::finalize_charge()
+{
+  fold_periodic(rho);
+  if (nullptr != domain) domain->sum_halo(rho.data());
+  for (std::size_t n = 0; n < rho.size(); n++) rho[n] *= volinv[n];
+}
+
+/* ------------------------------------------------------- */
+
+int Field::solve()
+{
+  int iter = 0;
+  residual = 0.;
+
+  while (iter < maxiter) {
+    residual = 0.;
+    sweep(0);
+    if (nullptr != domain) domain->exchange_halo(phi.data());
+    sweep(1);
+    if (nullptr != domain) domain->exchange_halo(phi.data());
+    copy_periodic(phi);
+    iter++;
+
+    Real phimax = max_abs_potential();
+    if (nullptr != domain) {
+      residual = domain->max(residual);
+      phimax = domain->max(phimax);
+    }
+    if (residual <= tol*std::max(phimax, 1.)) break;
+  }
+
+  calc_efield();
+
+  // sub-cycled species are pushed with the field averaged over solves
+  for (SubcycleSlot& slot : slot_arr) {
+    for (std::size_t n = 0; n < ex.size(); n++) {
+      slot.exsum[n] += ex[n];
+      slot.eysum[n] += ey[n];
+      slot.ezsum[n] += ez[n];
+    }
+    slot.nsum++;
+  }
+
+  return iter;
+}
+
+/* ------------------------------------------------------- */
+
+template <class G, typename T>
+void Field::gather(const T pos[3], Real E[3]) const
+{
+  interpolate<G>(ex.data(), ey.data(), ez.data(), 1., pos, E);
+}
+
+template void Field::gather<Cartesian2D, PosReal>(const PosReal*, Real*) const;
+template void Field::gather<Cartesian3D, PosReal>(const PosReal*, Real*) const;
+template void Field::gather<Axisymmetric, PosReal>(const PosReal*, Real*) const;
+
+/* ------------------------------------------------------- */
+
+Real Field::potential_range() const
+{
+  if (nullptr == domain) {
+    auto mm = std::minmax_element(phi.begin(), phi.end());
+    return *mm.second - *mm.first;
+  }
+
+  Real pmin = phi[node(ibeg, 0, 0)], pmax = pmin;
+  for (Index k = 0; k < nn[2]; k++)
+    for (Index j = 0; j < nn[1]; j++)
+      for (Index i = ibeg; i < iend; i++) {
+        pmin = std::min(pmin, phi[node(i, j, k)]);
+        pmax = std::max(pmax, phi[node(i, j, k)]);
+      }
+  return domain->max(pmax) - domain->min(pmin);
+}
+
+/* ------------------------------------------------------- */
+
+int Field::add_subcycle_slot()
+{
+  Index nnd = mesh->num_nodes();
+  slot_arr.push_back(SubcycleSlot());
+  SubcycleSlot& slot = slot_arr.back();
+  slot.rho_prev.assign(nnd, 0.);
+  slot.rho_curr.assign(nnd, 0.);
+  slot.exsum.assign(nnd, 0.);
+  slot.eysum.assign(nnd, 0.);
+  slot.ezsum.assign(nnd, 0.);
+  return static_cast<int> (slot_arr.size()) - 1;
+}
+
+/* ------------------------------------------------------- */
+
+void Field::deposit_frozen(const Particles& particles, Real qw, int islot)
+{
+  SubcycleSlot& slot = slot_arr[islot];
+  slot.rho_prev.swap(slot.rho_curr);
+  std::fill(slot.rho_curr.begin(), slot.rho_curr.end(), 0.);
+
+  (this->*ptr_deposit)(slot.rho_curr, particles, qw);
+  fold_periodic(slot.rho_curr);
+  if (nullptr != domain) domain->sum_halo(slot.rho_curr.data());
+  for (std::size_t n = 0; n < slot.rho_curr.size(); n++) slot.rho_curr[n] *= volinv[n];
+
+  // nothing to extrapolate from at the first deposit
+  if (!slot.has_prev) slot.rho_prev = slot.rho_curr;
+  slot.has_prev = true;
+}
+
+/* ------------------------------------------------------- */
+
+void Field::add_frozen_charge(int islot, Real frac)
+{
+  // density at a time between two pushes is extrapolated linearly
+  // from the last two pushes, so it is centered at the field solve
+  const SubcycleSlot& slot = slot_arr[islot];
+  for (std::size_t n = 0; n < rho.size(); n++)
+    rho[n] += slot.rho_curr[n] + frac*(slot.rho_curr[n] - slot.rho_prev[n]);
+}
+
+/* ------------------------------------------------------- */
+
+template <class G, typename T>
+void Field::gather_average(int islot, const T pos[3], Real E[3]) const
+{
+  const SubcycleSlot& slot = slot_arr[islot];
+  if (0 == slot.nsum) {
+    gather<G>(pos, E);
+    return;
+  }
+  interpolate<G>(slot.exsum.data(), slot.eysum.data(), slot.ezsum.data(),
+              1./slot.nsum, pos, E);
+}
+
+template void Field::gather_average<Cartesian2D, PosReal>(int, const PosReal*, Real*) const;
+template void Field::gather_average<Cartesian3D, PosReal>(int, const PosReal*, Real*) const;
+template void Field::gather_average<Axisymmetric, PosReal>(int, const PosReal*, Real*) const;
+
+/* ------------------------------------------------------- */
+
+void Field::reset_average(int islot)
+{
+  SubcycleSlot& slot = slot_arr[islot];
+  std::fill(slot.exsum.begin(), slot.exsum.end(), 0.);
+  std::fill(slot.eysum.begin(), slot.eysum.end(), 0.);
+  std::fill(slot.ezsum.begin(), slot.ezsum.end(), 0.);
+  slot.nsum = 0;
+}
+
+/* ------------------------------------------------------- */
+
+void Field::get_slot(int islot, Real* data, int& nsum, bool& has_prev) const
+{
+  const SubcycleSlot& slot = slot_arr[islot];
+  const NodeArray* arr[5] = { &slot.rho_prev, &slot.rho_curr, &slot.exsum, &slot.eysum, &slot.ezsum };
+  for (int a = 0; a < 5; a++)
+    std::copy(arr[a]->begin(), arr[a]->end(), data + a*phi.size());
+  nsum = slot.nsum;
+  has_prev = slot.has_prev;
+}
+
+/* ------------------------------------------------------- */
+
+void Field::set_slot(int islot, const Real* data, int nsum, bool has_prev)
+{
+  SubcycleSlot& slot = slot_arr[islot];
+  NodeArray* arr[5] = { &slot.rho_prev, &slot.rho_curr, &slot.exsum, &slot.eysum, &slot.ezsum };
+  for (int a = 0; a < 5; a++)
+    arr[a]->assign(data + a*phi.size(), data + (a+1)*phi.size());
+  slot.nsum = nsum;
+  slot.has_prev = has_prev;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+/* ------------------------------------------------------- */
+
+template <class G>
+void Field::deposit_to(NodeArray& dens, const Particles& particles, Real qw) const
+{
+  Real* const rh = dens.data();
+
+  // particles of a chunk are contiguous
+  for (Particles::size_type ich = 0; ich < particles.num_chunks(); ich++) {
+    const Particle* pc = particles.chunk(ich);
+    const Particles::size_type np = particles.chunk_count(ich);
+    if constexpr (3 == G::nd) {
+      for (Particles::size_type ip = 0; ip < np; ip++) {
+        const Particle& p = pc[ip];
+        Real s[3] = { (p.x()-lo[0])*hinv[0], (p.y()-lo[1])*hinv[1], (p.z()-lo[2])*hinv[2] };
+        Index ic[3];
+        Real w[3];
+        for (int a = 0; a < 3; a++) {
+          ic[a] = std::min(std::max(static_cast<Index> (s[a]), 0), nn[a]-2);
+          w[a] = std::min(std::max(s[a] - ic[a], 0.), 1.);
+        }
+        Index n0 = node(ic[0], ic[1], ic[2]);
+        Index nxy = nn[0]*nn[1];
+        Real qwp = qw*p.w();
+        Real wz[2] = { qwp*(1.-w[2]), qwp*w[2] };
+        for (int kk = 0; kk < 2; kk++) {
+          Index n = n0 + kk*nxy;
+          rh[n]         += (1.-w[0])*(1.-w[1])*wz[kk];
+          rh[n+1]       += w[0]*(1.-w[1])*wz[kk];
+          rh[n+nn[0]]   += (1.-w[0])*w[1]*wz[kk];
+          rh[n+nn[0]+1] += w[0]*w[1]*wz[kk];
+        }
+      }
+    }
+    else {
+      for (Particles::size_type ip = 0; ip < np; ip++) {
+        const Particle& p = pc[ip];
+        Real sx = (p.x()-lo[0])*hinv[0], sy = (p.y()-lo[1])*hinv[1];
+        Index i = std::min(std::max(static_cast<Index> (sx), 0), nn[0]-2);
+        Index j = std::min(std::max(static_cast<Index> (sy), 0), nn[1]-2);
+        Real wx = std::min(std::max(sx - i, 0.), 1.);
+        Real wy = std::min(std::max(sy - j, 0.), 1.);
+        Index n = j*nn[0] + i;
+        Real qwp = qw*p.w();
+        rh[n]         += qwp*(1.-wx)*(1.-wy);
+        rh[n+1]       += qwp*wx*(1.-wy);
+        rh[n+nn[0]]   += qwp*(1.-wx)*wy;
+        rh[n+nn[0]+1] += qwp*wx*wy;
+      }
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+template <class G, typename T>
+void Field::interpolate(const Real* fx, const Real* fy, const Real* fz, Real scale,
+                        const T pos[3], Real E[3]) const
+{
+  // offsets from the mesh origin in Real whatever the position scalar
+  Real sx = (pos[0]-lo[0])*hinv[0], sy = (pos[1]-lo[1])*hinv[1];
+  Index i = std::min(std::max(static_cast<Index> (sx), 0), nn[0]-2);
+  Index j = std::min(std::max(static_cast<Index> (sy), 0), nn[1]-2);
+  Real wx = std::min(std::max(sx - i, 0.), 1.);
+  Real wy = std::min(std::max(sy - j, 0.), 1.);
+
+  if constexpr (3 == G::nd) {
+    Real sz = (pos[2]-lo[2])*hinv[2];
+    Index k = std::min(std::max(static_cast<Index> (sz), 0), nn[2]-2);
+    Real wz = std::min(std::max(sz - k, 0.), 1.);
+    Real w[8] = { (1.-wx)*(1.-wy)*(1.-wz), wx*(1.-wy)*(1.-wz),
+                  (1.-wx)*wy*(1.-wz),      wx*wy*(1.-wz),
+                  (1.-wx)*(1.-wy)*wz,      wx*(1.-wy)*wz,
+                  (1.-wx)*wy*wz,           wx*wy*wz };
+    Index n0 = node(i, j, k), nxy = nn[0]*nn[1];
+    Index n[8] = { n0, n0+1, n0+nn[0], n0+nn[0]+1,
+                   n0+nxy, n0+nxy+1, n0+nxy+nn[0], n0+nxy+nn[0]+1 };
+    for (int c = 0; c < 8; c++) w[c] *= scale;
+    E[0] = E[1] = E[2] = 0.;
+    for (int c = 0; c < 8; c++) {
+      E[0] += w[c]*fx[n[c]];
+      E[1] += w[c]*fy[n[c]];
+      E[2] += w[c]*fz[n[c]];
+    }
+  }
+  else {
+    Index n = j*nn[0] + i;
+    Real w00 = (1.-wx)*(1.-wy)*scale, w10 = wx*(1.-wy)*scale;
+    Real w01 = (1.-wx)*wy*scale, w11 = wx*wy*scale;
+    E[0] = w00*fx[n] + w10*fx[n+1] + w01*fx[n+nn[0]] + w11*fx[n+nn[0]+1];
+    E[1] = w00*fy[n] + w10*fy[n+1] + w01*fy[n+nn[0]] + w11*fy[n+nn[0]+1];
+    E[2] = 0.;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Field::init_boundary()
+{
+  // nodes on Dirichlet faces
+  int nd = (3 == ndim ? 3 : 2);
+  for (int a = 0; a < nd; a++) {
+    for (int side = 0; side < 2; side++) {
+      if (Mesh::FBCType::dirichlet != mesh->fbc_type(2*a+side)) continue;
+      Real value = mesh->fbc_value(2*a+side);
+      Index ilo[3] = {0, 0, 0}, ihi[3] = {nn[0]-1, nn[1]-1, nn[2]-1};
+      ilo[a] = ihi[a] = (0 == side ? 0 : nn[a]-1);
+      for (Index k = ilo[2]; k <= ihi[2]; k++)
+        for (Index j = ilo[1]; j <= ihi[1]; j++)
+          for (Index i = ilo[0]; i <= ihi[0]; i++) {
+            fixed[node(i, j, k)] = 1;
+            phi[node(i, j, k)] = value;
+          }
+    }
+  }
+
+  // nodes occupied by conductors
+  const Real* condid_field = mesh->get_condid_field();
+  if (condid_field != nullptr) {
+    for (Index n = 0; n < mesh->num_nodes(); n++) {
+      int condid = static_cast<int> (condid_field[n]+0.0001);
+      if (condid < 1) continue;
+      fixed[n] = 1;
+      phi[n] = mesh->get_conductor(condid)->get_potential();
+    }
+  }
+
+  if (std::find(fixed.begin(), fixed.end(), 1) == fixed.end())
+    espic_warning("No node has fixed potential, potential is determined up to a constant");
+}
+
+/* ------------------------------------------------------- */
+
+void Field::init_volume()
+{
+  // control volume of a node is halved on non-periodic boundaries,
+  // annulus of the node's radial extent for axi-symmetric
+  volinv.resize(mesh->num_nodes());
+  cym.resize(nn[1]);
+  cyp.resize(nn[1]);
+
+  auto width = [&](int a, Index i) {
+    if (periodic[a] || (i > 0 && i < nn[a]-1)) return h[a];
+    return 0.5*h[a];
+  };
+
+  std::vector<Real> wy(nn[1]);
+  for (Index j = 0; j < nn[1]; j++) {
+    if (axi) {
+      Real r = lo[1] + j*h[1];
+      Real rlo = std::max(r - 0.5*h[1], lo[1]), rhi = std::min(r + 0.5*h[1], hi[1]);
+      wy[j] = PI*(rhi*rhi - rlo*rlo);
+      if (r < 0.5*h[1]) {     // on axis, 4*(phi1 - phi0)/dr^2
+        cym[j] = 0.;
+        cyp[j] = 4.*hinv[1]*hinv[1];
+      }
+      else {
+        cym[j] = (r - 0.5*h[1])/r*hinv[1]*hinv[1];
+        cyp[j] = (r + 0.5*h[1])/r*hinv[1]*hinv[1];
+      }
+    }
+    else {
+      wy[j] = width(1, j);
+      cym[j] = cyp[j] = hinv[1]*hinv[1];
+    }
+  }
+
+  for (Index k = 0; k < nn[2]; k++) {
+    Real wz = (3 == ndim ? width(2, k) : (axi ? 1. : h[2]));
+    for (Index j = 0; j < nn[1]; j++)
+      for (Index i = 0; i < nn[0]; i++)
+        volinv[node(i, j, k)] = 1./(width(0, i)*wy[j]*wz);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Field::sweep(int color)
+{
+  // red-black SOR, a neighbor outside the domain is the mirror node
+  // (Neumann/symmetric) or the node across a periodic boundary
+  const Real ax = hinv[0]*hinv[0], az = hinv[2]*hinv[2];
+  Index jend = periodic[1] ? nn[1]-1 : nn[1];
+  Index kend = periodic[2] ? nn[2]-1 : nn[2];
+
+  auto lower = [&](int a, Index i) {
+    return i > 0 ? i-1 : (periodic[a] ? nn[a]-2 : 1);
+  };
+  auto upper = [&](int a, Index i) {
+    if (periodic[a] && i == nn[a]-2) return 0;
+    return i < nn[a]-1 ? i+1 : nn[a]-2;
+  };
+
+  for (Index k = 0; k < kend; k++) {
+    for (Index j = 0; j < jend; j++) {
+      Index jm = lower(1, j), jp = upper(1, j);
+      for (Index i = ibeg + (ibeg+j+k+color)%2; i < iend; i += 2) {
+        Index n = node(i, j, k);
+        if (fixed[n]) continue;
+
+        Index im = lower(0, i), ip = upper(0, i);
+        Real sum = rho[n] + ax*(phi[node(im, j, k)] + phi[node(ip, j, k)])
+                 + cym[j]*phi[node(i, jm, k)] + cyp[j]*phi[node(i, jp, k)];
+        Real diag = 2.*ax + cym[j] + cyp[j];
+        if (3 == ndim) {
+          Index km = lower(2, k), kp = upper(2, k);
+          sum += az*(phi[node(i, j, km)] + phi[node(i, j, kp)]);
+          diag += 2.*az;
+        }
+
+        Real dphi = omega*(sum/diag - phi[n]);
+        phi[n] += dphi;
+        residual = std::max(residual, fabs(dphi));
+      }
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Field::copy_periodic(NodeArray& f) const
+{
+  // last node along a periodic direction is a copy of the first one
+  for (int a = 0; a < 3; a++) {
+    if (!periodic[a]) continue;
+    Index ilo[3] = {0, 0, 0}, ihi[3] = {nn[0]-1, nn[1]-1, nn[2]-1};
+    ilo[a] = ihi[a] = nn[a]-1;
+    Index shift = (nn[a]-1)*(0 == a ? 1 : (1 == a ? nn[0] : nn[0]*nn[1]));
+    for (Index k = ilo[2]; k <= ihi[2]; k++)
+      for (Index j = ilo[1]; j <= ihi[1]; j++)
+        for (Index i = ilo[0]; i <= ihi[0]; i++)
+          f[node(i, j, k)] = f[node(i, j, k)-shift];
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Field::fold_periodic(NodeArray& f) const
+{
+  // charge deposited to the last node along a periodic direction
+  // belongs to the first one
+  for (int a = 0; a < 3; a++) {
+    if (!periodic[a]) continue;
+    Index ilo[3] = {0, 0, 0}, ihi[3] = {nn[0]-1, nn[1]-1, nn[2]-1};
+    ilo[a] = ihi[a] = nn[a]-1;
+    Index shift = (nn[a]-1)*(0 == a ? 1 : (1 == a ? nn[0] : nn[0]*nn[1]));
+    for (Index k = ilo[2]; k <= ihi[2]; k++)
+      for (Index j = ilo[1]; j <= ihi[1]; j++)
+        for (Index i = ilo[0]; i <= ihi[0]; i++) {
+          Index n = node(i, j, k);
+          f[n-shift] += f[n];
+          f[n] = f[n-shift];
+        }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Field::calc_efield()
+{
+  // E = -grad(phi), central difference inside and across periodic
+  // boundaries, one-sided on other boundaries, E_r = 0 on axis
+  Index stride[3] = {1, nn[0], nn[0]*nn[1]};
+  NodeArray* e[3] = {&ex, &ey, &ez};
+  int nd = (3 == ndim ? 3 : 2);
+  Index i0 = (nullptr == domain) ? 0 : ibeg;
+  Index i1 = (nullptr == domain) ? nn[0] : iend;
+
+  for (Index k = 0; k < nn[2]; k++) {
+    for (Index j = 0; j < nn[1]; j++) {
+      for (Index i = i0; i < i1; i++) {
+        Index n = node(i, j, k);
+        Index idx[3] = {i, j, k};
+        for (int a = 0; a < nd; a++) {
+          Index ia = idx[a], s = stride[a];
+          Real val;
+          if (ia > 0 && ia < nn[a]-1)
+            val = -(phi[n+s] - phi[n-s])*0.5*hinv[a];
+          else if (periodic[a])
+            val = (0 == ia) ? -(phi[n+s] - phi[n+(nn[a]-2)*s])*0.5*hinv[a]
+                            : -(phi[n-(nn[a]-2)*s] - phi[n-s])*0.5*hinv[a];
+          else if (0 == ia)
+            val = (axi && 1 == a && lo[1] < 0.5*h[1]) ? 0. : -(phi[n+s] - phi[n])*hinv[a];
+          else
+            val = -(phi[n] - phi[n-s])*hinv[a];
+          (*e[a])[n] = val;
+        }
+      }
+    }
+  }
+
+  // nodes at the slab ends are interpolated from by particles of this
+  // slab, the last one along a periodic x is the first node
+  if (nullptr != domain) {
+    for (int a = 0; a < 3; a++) {
+      domain->exchange_halo(e[a]->data());
+      copy_periodic(*e[a]);
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+Real Field::max_abs_potential() const
+{
+  Real phimax = 0.;
+  if (nullptr == domain) {
+    for (const Real& p : phi) phimax = std::max(phimax, fabs(p));
+    return phimax;
+  }
+  for (Index k = 0; k < nn[2]; k++)
+    for (Index j = 0; j < nn[1]; j++)
+      for (Index i = ibeg; i < iend; i++)
+        phimax = std::max(phimax, fabs(phi[node(i, j, k)]));
+  return phimax;
+}
+
+/* ----------------- End Private Methods ----------------- */
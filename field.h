@@ -0,0 +1,140 @@
+#ifndef _FIELD_H
+#define _FIELD_H
+
+#include <vector>
+#include "espic_type.h"
+#include "espic_memory.h"
+
+class Field {
+  public:
+    // values on all nodes of the mesh, pages placed as ESPIC::Memory sets
+    typedef std::vector<Real, ESPIC::NumaAllocator<Real>> NodeArray;
+
+    /* Constructor */
+    // (mesh, convergence tolerance, max # of iterations, over-relaxation factor)
+    Field(const class Mesh*, Real tol = 1e-6, int maxiter = 10000, Real omega = 1.8);
+
+    ~Field();
+
+    /* Public methods */
+    // solve nodes of the slab of a process only, exchanging node planes
+    // at slab ends with its neighbors (by default the whole mesh)
+    void decompose(const class Domain*);
+
+    // zero charge density before deposit
+    void reset_charge();
+
+    // deposit charge (charge*species weight, times the weight of each
+    // particle) of particles to nodes
+    void deposit(const class Particles&, Real);
+
+    // convert deposited charge to density (called once after all deposits)
+    void finalize_charge();
+
+    // solve Poisson's equation by SOR, return # of iterations
+    int solve();
+
+    // electric field at a point interpolated from nodes, G the geometry
+    // policy of the mesh (see geometry.h), instantiated for positions
+    // in PosReal
+    template <class G, typename T>
+    void gather(const T pos[3], Real E[3]) const;
+
+    Real last_residual() const { return residual; }
+
+    // max - min of potential
+    Real potential_range() const;
+
+    /* sub-cycled (heavy) species */
+    // add a slot holding the frozen charge density and the time-averaged
+    // field of a sub-cycled species, return slot id
+    int add_subcycle_slot();
+
+    // deposit a sub-cycled species after its push, the previous frozen
+    // density is kept for extrapolation
+    void deposit_frozen(const class Particles&, Real, int);
+
+    // add frozen density of a slot extrapolated by frac of a sub-cycle
+    // (call after finalize_charge)
+    void add_frozen_charge(int, Real);
+
+    // field averaged over solves since last reset
+    template <class G, typename T>
+    void gather_average(int, const T pos[3], Real E[3]) const;
+
+    void reset_average(int);
+
+    // state of a slot kept in checkpoints: frozen densities of the last
+    // two pushes and the summed field, slot_size() Reals, then # of
+    // solves summed and whether there is a previous density
+    std::size_t slot_size() const { return 5*phi.size(); }
+    void get_slot(int, Real*, int& nsum, bool& has_prev) const;
+    void set_slot(int, const Real*, int nsum, bool has_prev);
+
+    const NodeArray& get_potential() const { return phi; }
+    // restore potential (e.g. from a checkpoint) and its field, also the
+    // initial guess of the next solve
+    void set_potential(const Real* p) {
+      phi.assign(p, p + phi.size());
+      calc_efield();
+    }
+    const NodeArray& get_charge_density() const { return rho; }
+
+  private:
+    const class Mesh* mesh;
+    const class Domain* domain;   // nullptr if not decomposed
+    int ndim;
+    bool axi;
+    Index nn[3];                  // # of nodes in x, y and z
+    Real lo[3], hi[3];
+    Real h[3], hinv[3];           // cell size
+    bool periodic[3];
+    Index ibeg, iend;             // nodes along x solved, [ibeg, iend)
+
+    Real tol;
+    int maxiter;
+    Real omega;
+    Real residual;                // max change of phi in last sweep
+
+    NodeArray rho;                // charge density
+    NodeArray phi;                // potential
+    NodeArray ex, ey, ez;         // electric field on nodes
+    NodeArray volinv;             // inverse of node (control) volume
+    std::vector<char> fixed;      // potential fixed by BC or conductor
+
+    class SubcycleSlot {
+      public:
+        SubcycleSlot() : nsum(0), has_prev(false) { }
+
+        NodeArray rho_prev, rho_curr;   // density at last two pushes
+        NodeArray exsum, eysum, ezsum;  // field summed over solves
+        int nsum;
+        bool has_prev;
+    };
+    std::vector<SubcycleSlot> slot_arr;
+
+    // stencil coefficients of the lower/upper neighbor along y
+    // (differ along y only for axi-symmetric)
+    std::vector<Real> cym, cyp;
+
+    Index node(Index i, Index j, Index k) const { return (k*nn[1] + j)*nn[0] + i; }
+
+    // deposit kernel of the mesh geometry, chosen at construction
+    typedef void (Field::*DepositFn)(NodeArray&, const class Particles&, Real) const;
+    DepositFn ptr_deposit;
+
+    template <class G>
+    void deposit_to(NodeArray&, const class Particles&, Real) const;
+    template <class G, typename T>
+    void interpolate(const Real*, const Real*, const Real*, Real,
+                     const T pos[3], Real E[3]) const;
+    void init_boundary();
+    void init_volume();
+    void sweep(int color);
+    void copy_periodic(NodeArray&) const;
+    void fold_periodic(NodeArray&) const;
+    void calc_efield();
+    Real max_abs_potential() const;
+};
+
+#endif
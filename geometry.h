@@ -0,0 +1,54 @@
+#ifndef _GEOMETRY_H
+#define _GEOMETRY_H
+
+#include "espic_info.h"
+
+// geometry of the mesh as a compile-time policy of the particle kernels
+// (push, boundaries, gather, deposit and cell lookup)
+//
+// Mesh::dimension() picks one at startup through with_geometry, the
+// kernels instantiated for it then have no dimension branches in their
+// loops over particles.
+class Cartesian2D {
+  public:
+    static constexpr int dimension = 2;
+    static constexpr int nd = 2;        // position components on the mesh
+    static constexpr bool axi = false;
+};
+
+class Cartesian3D {
+  public:
+    static constexpr int dimension = 3;
+    static constexpr int nd = 3;
+    static constexpr bool axi = false;
+};
+
+// (x, r) plane, particles carry 3 velocity components and are rotated
+// back to the plane after each move
+class Axisymmetric {
+  public:
+    static constexpr int dimension = 5;
+    static constexpr int nd = 2;
+    static constexpr bool axi = true;
+};
+
+// call fn(G()) with the policy G of a dimension given in mesh.in
+template <class Fn>
+inline void with_geometry(int dimension, Fn&& fn)
+{
+  switch (dimension) {
+    case Cartesian2D::dimension:
+      fn(Cartesian2D());
+      break;
+    case Cartesian3D::dimension:
+      fn(Cartesian3D());
+      break;
+    case Axisymmetric::dimension:
+      fn(Axisymmetric());
+      break;
+    default:
+      espic_error("Simulation must be performed in 2d, 3d or axisymmetric");
+  }
+}
+
+#endif
@@ -2,40 +2,57 @@
 #include "param_particle.h"
 #include "mesh.h"
 #include "tile.h"
+#include "control.h"
+#include "field.h"
+#include "driver.h"
+#include "diagnostics.h"
+#include "domain.h"
 #include <fstream>
 
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
 using std::cout;
 using std::endl;
 
 int main(int argc, char** argv)
 {
-    Real dt = 0.1;
-    Real curr_time = 0.;
-    Real ntime = 100;
-    bool Loop = true;
+#ifdef USE_MPI
+    // only the first process prints, all of them read the same input
+    MPI_Init(&argc, &argv);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank > 0) cout.rdbuf(nullptr);
+#endif
+
+    Control* control = new Control("control.in");
     Mesh* mesh = new Mesh("mesh.in");
+    Domain* domain = new Domain(mesh);
     ParamParticle* param_particle = new ParamParticle("particle.in", mesh);
     CrossSection* cross_section = new CrossSection("csection.in");
-    Tile* tile = new Tile(mesh, param_particle, cross_section);
+    Tile* tile = new Tile(mesh, param_particle, cross_section, domain);
+    Field* field = new Field(mesh, control->solver_tol(),
+                             control->solver_max_iter(), control->solver_omega());
+    field->decompose(domain);
+    Diagnostics* diagnostics = new Diagnostics(control->diag_format(), control->diag_flush(),
+                                               domain->is_root() ? "" : domain->file_suffix());
+    Driver* driver = new Driver(control, mesh, tile, field, diagnostics, domain);
 
-    // std::ofstream of1("e.dat"), of2("Ar+.dat");
-    // std::ofstream of3("ion.dat"), of4("exc.dat"), of5("ela.dat");
-    // of1.close(); of2.close(); 
-    // of3.close(); of4.close(); of5.close();
+    driver->run();
 
-    // cout << "MCC loop Start---------------------------------------------------------\n"; 
-    // while(Loop) {
-    //     tile->ParticleCollisioninTiles(dt);
-    //     curr_time += dt;
-    //     if(curr_time >= ntime) 
-    //         Loop = false;
-    // }
-    // cout << "MCC loop ends----------------------------------------------------------\n";
+    delete driver;
+    delete diagnostics;
+    delete field;
+    delete tile;
+    delete domain;
     delete mesh;
     delete cross_section;
     delete param_particle;
-    delete tile;
+    delete control;
 
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
     return 0;
 }
-
@@ -4,11 +4,13 @@
 #include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <limits>
 
 // #include "control.h"
 #include "espic_info.h"
 #include "espic_math.h"
 #include "mesh.h"
+#include "geometry.h"
 #include "parse.h"
 
 using namespace ESPIC;
@@ -40,7 +42,7 @@ Mesh::Mesh(const string& file)
 
   cout << "Set simulation domain: (xmin, ymin, zmin) = (" << xmin() << ", " << ymin() << ", " << zmin() << "), ";
   cout << "(xmax, ymax, zmax) = (" << xmax() << ", " << ymax() << ", " << zmax() << ")\n";
-  cout << "Set mesh: ";
+  cout << "Set mesh: " << (5 == ndim ? "axi-symmetric" : 3 == ndim ? "3d" : "2d") << ", ";
   cout << "# of cells (nx, ny, nz) = (" << num_cells(0) << ", " << num_cells(1) << ", " << num_cells(2) << "), ";
   cout << "# of cells in a tile set to be (" << tile_num_cells(0)
     << ", " << tile_num_cells(1) << ", " << tile_num_cells(2) << "), ";
@@ -82,7 +84,8 @@ void Mesh::init()
   while (ParseLine(word, fp)) {
     if (word.empty()) continue;     // this is a comment or blank line
 
-         if ("domain"    == word.at(0)) proc_domain(word);
+         if ("dimension" == word.at(0)) proc_dimension(word);
+    else if ("domain"    == word.at(0)) proc_domain(word);
     else if ("num_cells" == word.at(0)) proc_num_cells(word);
     else if ("tile"      == word.at(0)) proc_tile(word);
     else if ("field_bc"  == word.at(0)) proc_field_bc(word);
@@ -113,19 +116,25 @@ void Mesh::init_condid()
   condid_field = new Real[num_nodes()];
   for (Index i = 0; i < num_nodes(); i++) condid_field[i] = 0;
 
+  // only nodes inside the bounding box of a conductor are tested
   Real px, py, pz;
   Index iznxy, off;
+  Index ilo[3], ihi[3];
+  Vector3 blo, bhi;
   for (int icond = 0; icond < num_conductors(); icond++) {
     Conductor* & conductor = conductor_arr[icond];
     Real condid = static_cast<Real> (conductor->get_id());
 
-    for (Index k = 0; k < num_nodes(2); k++) {
+    conductor->bounding_box(blo, bhi);
+    bbox_node_range(blo, bhi, ilo, ihi);
+
+    for (Index k = ilo[2]; k <= ihi[2]; k++) {
       pz = z(0, 0, k);
       iznxy = k*num_nodes(0)*num_nodes(1);
-      for (Index j = 0; j < num_nodes(1); j++) {
+      for (Index j = ilo[1]; j <= ihi[1]; j++) {
         py = y(0, j, 0);
         off = iznxy + j*num_nodes(0);
-        for (Index i = 0; i < num_nodes(0); i++) {
+        for (Index i = ilo[0]; i <= ihi[0]; i++) {
           px = x(i, 0, 0);
 
           if (conductor->is_inside(px, py, pz)) condid_field[off + i] += condid;
@@ -135,20 +144,29 @@ void Mesh::init_condid()
 
   } // end for (int icond = 0; icond < num_conductors(); icond++)
 
-  if (dimension() == 3) {
-    Index kknxy, off1, node_indx;
-    
-    // neigboring nodes of conductor for interior points
-    for (Index k = 1; k < num_cells(2); k++) {
+  // neigboring nodes of conductor for interior points,
+  // searched within the bounding box of each conductor
+  Index kknxy, off1, node_indx;
+  int kext = (dimension() == 3 ? 1 : 0);
+  for (int icond = 0; icond < num_conductors(); icond++) {
+    conductor_arr[icond]->bounding_box(blo, bhi);
+    bbox_node_range(blo, bhi, ilo, ihi);
+    for (int a = 0; a < 3; a++) {
+      ilo[a] = std::max(ilo[a], 1);
+      ihi[a] = std::min(ihi[a], num_cells(a)-1);
+    }
+    if (dimension() != 3) ilo[2] = ihi[2] = 0;
+
+    for (Index k = ilo[2]; k <= ihi[2]; k++) {
       iznxy = k*num_nodes(0)*num_nodes(1);
 
-      for (Index j = 1; j < num_cells(1); j++) {
+      for (Index j = ilo[1]; j <= ihi[1]; j++) {
         off = iznxy + j*num_nodes(0);
 
-        for (Index i = 1; i < num_cells(0); i++) {
+        for (Index i = ilo[0]; i <= ihi[0]; i++) {
 
           if (condid_field[off+i] > 0.5) {
-            for (int kk = -1; kk < 2; kk++) {
+            for (int kk = -kext; kk <= kext; kk++) {
               kknxy = (k+kk)*num_nodes(0)*num_nodes(1);
               for (int jj = -1; jj < 2; jj++) {
                 off1 = kknxy + (j+jj)*num_nodes(0);
@@ -163,38 +181,108 @@ void Mesh::init_condid()
 
         }
       }
-    } // end for (Index k = 1; k < num_cells(2); k++)
+    }
 
+  } // end for (int icond = 0; icond < num_conductors(); icond++)
+
+  for (int icond = 0; icond < num_conductors(); icond++) {
+    Conductor*& conductor = conductor_arr[icond];
+    map_condid_arrid[conductor->get_id()] = icond;
   }
-  else {
-    Index off1, node_indx;
 
-    // neigboring nodes of conductor for interior points
-    for (Index j = 1; j < num_cells(1); j++) {
-      off = j*num_nodes(0);
+  init_conductor_cells();
+}
 
-      for (Index i = 1; i < num_cells(0); i++) {
+/* ------------------------------------------------------- */
+
+void Mesh::init_conductor_cells()
+{
+  // bin conductors to the cells near their surface (uniform grid),
+  // each cell is expanded by one layer so a particle moving less
+  // than one cell per step can only hit conductors binned to
+  // the cell it starts or ends in
+  std::vector<std::pair<Index, int>> cell_cond;
+  Index ilo[3], ihi[3];
+  Vector3 blo, bhi;
+  int kext = (dimension() == 3 ? 1 : 0);
 
-        if (condid_field[off+i] > 0.5) {
-          for (int jj = -1; jj < 2; jj++) {
-            off1 = (j+jj)*num_nodes(0);
-            for (int ii = -1; ii < 2; ii++) {
-              node_indx = off1 + i+ii;
-              if (condid_field[node_indx] >= 0.5) continue;
-              condid_field[node_indx] = 0.5;
+  for (int icond = 0; icond < num_conductors(); icond++) {
+    const Conductor* conductor = conductor_arr[icond];
+    conductor->bounding_box(blo, bhi);
+
+    for (int a = 0; a < 3; a++) {
+      Real dinv = 1./cell_size[a];
+      ilo[a] = static_cast<Index> (floor((blo[a]-bound_lo[a])*dinv)) - 1;
+      ihi[a] = static_cast<Index> (floor((bhi[a]-bound_lo[a])*dinv)) + 1;
+      ilo[a] = std::max(ilo[a], 0);
+      ihi[a] = std::min(ihi[a], num_cells(a)-1);
+    }
+    if (dimension() != 3) ilo[2] = ihi[2] = 0;
+
+    for (Index k = ilo[2]; k <= ihi[2]; k++) {
+      for (Index j = ilo[1]; j <= ihi[1]; j++) {
+        for (Index i = ilo[0]; i <= ihi[0]; i++) {
+
+          // skip cells buried in the conductor, all corners of the
+          // expanded cell inside means the (convex) shape covers it
+          bool buried = true;
+          for (int kk = -kext; buried && kk <= kext+kext; kk += 1+2*kext) {
+            for (int jj = -1; buried && jj <= 2; jj += 3) {
+              for (int ii = -1; buried && ii <= 2; ii += 3) {
+                buried = conductor->is_inside(x(i+ii, 0, 0), y(0, j+jj, 0), z(0, 0, k+kk));
+              }
             }
           }
-        } // end if (c_temp > 0.5)
 
+          if (!buried) {
+            cell_cond.push_back(std::make_pair((k*num_cells(1)+j)*num_cells(0)+i, icond));
+          }
+        }
       }
-    } // end for (Index j = 1; j < num_cells(1); j++)
-    
-  } // end if (dimension() == 3) else
+    }
+  } // end for (int icond = 0; icond < num_conductors(); icond++)
 
-  for (int icond = 0; icond < num_conductors(); icond++) {
-    Conductor*& conductor = conductor_arr[icond];
-    map_condid_arrid[conductor->get_id()] = icond;
+  // compressed (CSR) list of conductors per cell
+  cellcond_offset.assign(num_cells()+1, 0);
+  for (const auto& cc : cell_cond) cellcond_offset[cc.first+1]++;
+  for (Index ic = 0; ic < num_cells(); ic++) cellcond_offset[ic+1] += cellcond_offset[ic];
+
+  std::vector<Index> fill(cellcond_offset.begin(), cellcond_offset.end()-1);
+  cellcond_list.resize(cell_cond.size());
+  for (const auto& cc : cell_cond) cellcond_list[fill[cc.first]++] = cc.second;
+
+  cout << "Conductor surface binned to " << cell_cond.size() 
+    << " cells out of " << num_cells() << " cells" << endl;
+}
+
+/* ------------------------------------------------------- */
+
+void Mesh::bbox_node_range(const Vector3& blo, const Vector3& bhi, 
+                           Index ilo[3], Index ihi[3]) const
+{
+  for (int a = 0; a < 3; a++) {
+    Real dinv = 1./cell_size[a];
+    ilo[a] = static_cast<Index> (floor((blo[a]-bound_lo[a])*dinv));
+    ihi[a] = static_cast<Index> (ceil((bhi[a]-bound_lo[a])*dinv));
+    ilo[a] = std::max(ilo[a], 0);
+    ihi[a] = std::min(ihi[a], num_nodes(a)-1);
   }
+  if (dimension() != 3) ilo[2] = ihi[2] = 0;
+}
+
+/* ------------------------------------------------------- */
+
+void Mesh::proc_dimension(vector<string>& word)
+{
+  // dimension 2|3|axi (2 by default), the first command in the file
+  string cmd(word[0]);
+  if (2 != word.size()) espic_error(illegal_cmd_info(cmd, infile));
+  if (-1 != nnd) espic_error("Command dimension must come before num_cells in [" + infile + "]");
+
+       if ("2"   == word[1]) ndim = 2;
+  else if ("3"   == word[1]) ndim = 3;
+  else if ("axi" == word[1]) ndim = 5;
+  else espic_error(illegal_cmd_info(cmd, infile));
 }
 
 /* ------------------------------------------------------- */
@@ -438,6 +526,11 @@ void Mesh::proc_conductor_rectangle(vector<string>& word)
       else cdef.rf = false;
       word.erase(word.begin(), word.begin()+2);
     }
+    else if ("count_lost" == word[0]) {
+      if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+      cdef.flag_collectlp = (word[1] == "true" ? 1 : 0);
+      word.erase(word.begin(), word.begin()+2);
+    }
     else espic_error(illegal_cmd_info(cmd, infile));
   }
 
@@ -510,6 +603,11 @@ void Mesh::proc_conductor_circle(vector<string>& word)
       cdef.radius = static_cast<Real> (atof(word[1].c_str()));
       word.erase(word.begin(), word.begin()+2);
     }
+    else if ("count_lost" == word[0]) {
+      if (word.size() < 2) espic_error(illegal_cmd_info(cmd, infile));
+      cdef.flag_collectlp = (word[1] == "true" ? 1 : 0);
+      word.erase(word.begin(), word.begin()+2);
+    }
     else espic_error(illegal_cmd_info(cmd, infile));
   }
 
@@ -570,3 +668,102 @@ bool Mesh::is_fixed_potential(int i, int j, int k) const
     return conductor_arr[map_condid_arrid.at(condid)]->is_fixed_potential();
     }
 }
+
+/* ------------------------------------------------------- */
+
+template <class G>
+Index Mesh::find_cell(const Vector3& pos) const
+{
+  Index ic[3] = {0, 0, 0};
+  for (int a = 0; a < G::nd; a++) {
+    Real s = (pos[a] - bound_lo[a])/cell_size[a];
+    if (s < 0. || s > ncells[a]) return -1;
+    ic[a] = std::min(static_cast<Index> (s), ncells[a]-1);
+  }
+  return (ic[2]*ncells[1] + ic[1])*ncells[0] + ic[0];
+}
+
+/* ------------------------------------------------------- */
+
+template <class G>
+Conductor* Mesh::find_scraping_conductor(const Vector3& pos_old,
+                                         const Vector3& pos_new)
+{
+  if (cellcond_list.empty()) return nullptr;
+
+  // the hit nearest to pos_old among conductors binned to a cell
+  Conductor* hit = nullptr;
+  Real thit = 2.;
+  auto test_cell = [&](Index cellid) {
+    if (!is_conductor_adjacent(cellid)) return;
+    for (Index n = cellcond_offset[cellid]; n < cellcond_offset[cellid+1]; n++) {
+      Conductor* conductor = conductor_arr[cellcond_list[n]];
+      Real t;
+      if (conductor->intersect(pos_old, pos_new, t) && t < thit) {
+        hit = conductor;
+        thit = t;
+      }
+    }
+  };
+
+  // position in cell units and displacement
+  Real s0[3], ds[3];
+  bool long_move = false;
+  for (int a = 0; a < G::nd; a++) {
+    s0[a] = (pos_old[a] - bound_lo[a])/cell_size[a];
+    ds[a] = (pos_new[a] - pos_old[a])/cell_size[a];
+    long_move = long_move || (std::fabs(ds[a]) > 1.);
+  }
+
+  // cells are binned with one extra layer, so a move within one cell
+  // can only hit conductors binned to the cell it starts or ends in
+  if (!long_move) {
+    Index cells[2] = { find_cell<G>(pos_old), find_cell<G>(pos_new) };
+    test_cell(cells[0]);
+    if (cells[1] != cells[0]) test_cell(cells[1]);
+    return hit;
+  }
+
+  // otherwise walk all cells crossed by the segment (DDA), a hit point
+  // is in a cell entered before it, so stop once past the nearest hit
+  Index ic[3] = {0, 0, 0};
+  int step[3] = {0, 0, 0};
+  Real tnext[3], tdelta[3];
+  for (int a = 0; a < 3; a++) {
+    tnext[a] = std::numeric_limits<Real>::max();
+    tdelta[a] = 0.;
+  }
+  for (int a = 0; a < G::nd; a++) {
+    if (s0[a] < 0. || s0[a] > ncells[a]) return nullptr;
+    ic[a] = std::min(static_cast<Index> (s0[a]), ncells[a]-1);
+    if (ds[a] > 0.) {
+      step[a] = 1;
+      tdelta[a] = 1./ds[a];
+      tnext[a] = (ic[a] + 1 - s0[a])*tdelta[a];
+    }
+    else if (ds[a] < 0.) {
+      step[a] = -1;
+      tdelta[a] = -1./ds[a];
+      tnext[a] = (s0[a] - ic[a])*tdelta[a];
+    }
+  }
+
+  Real tcell = 0.;    // where the segment enters cell ic
+  while (tcell <= 1. && tcell <= thit) {
+    test_cell((ic[2]*ncells[1] + ic[1])*ncells[0] + ic[0]);
+    int a = 0;
+    for (int b = 1; b < G::nd; b++) {
+      if (tnext[b] < tnext[a]) a = b;
+    }
+    tcell = tnext[a];
+    ic[a] += step[a];
+    if (ic[a] < 0 || ic[a] >= ncells[a]) break;
+    tnext[a] += tdelta[a];
+  }
+
+  return hit;
+}
+
+template Conductor* Mesh::find_scraping_conductor<Cartesian2D>(const Vector3&, const Vector3&);
+template Conductor* Mesh::find_scraping_conductor<Cartesian3D>(const Vector3&, const Vector3&);
+template Conductor* Mesh::find_scraping_conductor<Axisymmetric>(const Vector3&, const Vector3&);
@@ -110,6 +110,22 @@ class Mesh {
 
     bool is_fixed_potential(int i, int j, int k) const;
 
+    // index of the cell containing a point, -1 if out of the domain
+    // (G the geometry policy matching dimension(), see geometry.h)
+    template <class G>
+    Index find_cell(const Vector3&) const;
+
+    // whether conductor surfaces are binned to this cell
+    bool is_conductor_adjacent(Index cellid) const {
+      return cellid >= 0 && !cellcond_list.empty()
+          && cellcond_offset[cellid+1] > cellcond_offset[cellid];
+    }
+
+    // conductor first hit by a particle moving from pos_old to pos_new,
+    // nullptr if none, only conductor-adjacent cells on the way are tested
+    template <class G>
+    class Conductor* find_scraping_conductor(const Vector3&, const Vector3&);
+
   private: 
     /* data member */
     std::string infile;           // name of input file for mesh definition
@@ -136,12 +152,17 @@ class Mesh {
     Real *condid_field;
     std::vector<class Conductor*> conductor_arr;
     std::map<int, int> map_condid_arrid;
+    std::vector<Index> cellcond_offset;   // conductors binned to cells (CSR)
+    std::vector<int> cellcond_list;       // index in conductor_arr
 
     /* Private methods */
 
     /* initiation */
     void init();
     void init_condid();
+    void init_conductor_cells();
+    void bbox_node_range(const Vector3&, const Vector3&, Index [3], Index [3]) const;
+    void proc_dimension(std::vector<std::string>&);
     void proc_domain(std::vector<std::string>&);
     void proc_num_cells(std::vector<std::string>&);
     void proc_tile(std::vector<std::string>&);
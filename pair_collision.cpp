@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cmath>
+
+#include "espic_info.h"
+#include "mesh.h"
+#include "reaction.h"
+#include "species.h"
+#include "pair_collision.h"
+
+#ifdef OMP
+#include <omp.h>
+#endif
+
+using namespace ESPIC;
+
+// scattering of a reaction type
+enum { kind_iso, kind_back, kind_exc, kind_coul };
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+PairCollision::PairCollision(const Mesh* msh, Reaction* rct)
+  : mesh(msh),
+    reaction(rct),
+    ndim(msh->dimension()),
+    nc {msh->num_cells(0), msh->num_cells(1), msh->num_cells(2)},
+    lo {msh->xmin(), msh->ymin(), msh->zmin()},
+    h {msh->dx(), msh->dy(), msh->dz()},
+    hinv {1./msh->dx(), 1./msh->dy(), 1./msh->dz()},
+    ntype(rct->isize()),
+    has_cs(false),
+    ncoll_type(rct->isize(), 0),
+    pmax(0.)
+{
+  if (3 != ndim) nc[2] = 1;
+
+  const StringList& types = reaction->get_types();
+  for (int itype = 0; itype < ntype; itype++) {
+    const std::string& type = types[itype];
+    if ("ela" == type || "iso" == type) kind.push_back(kind_iso);
+    else if ("back" == type) kind.push_back(kind_back);
+    else if ("exc" == type) kind.push_back(kind_exc);
+    else if ("coul" == type) kind.push_back(kind_coul);
+    else {
+      espic_error("Reaction type [" + type + "] in [" + reaction->get_file()
+                  + "] is not supported between two species of particles");
+    }
+    param.push_back(reaction->th()[itype]);
+    if (kind_coul != kind.back()) has_cs = true;
+  }
+
+  int nthreads = 1;
+#ifdef OMP
+  nthreads = omp_get_max_threads();
+#endif
+  rng_arr.resize(nthreads);
+}
+
+/* ------------------------------------------------------- */
+
+PairCollision::~PairCollision()
+{
+}
+
+/* ------------------------------------------------------- */
+
+Particles::size_type PairCollision::apply(Species* sa, Species* sb, Real dt, int step)
+{
+  Pair pair;
+  pair.pa = sa->particles;
+  pair.pb = sb->particles;
+  pair.ma = sa->mass;
+  pair.mb = sb->mass;
+  pair.mr = sa->mass*sb->mass/(sa->mass + sb->mass);
+  pair.wa = sa->weight;
+  pair.wb = sb->weight;
+  pair.qq = sa->charge*sa->charge*sb->charge*sb->charge;
+  pair.like = (sa == sb);
+
+  sort(*pair.pa, start_a, order_a);
+  if (!pair.like) sort(*pair.pb, start_b, order_b);
+
+  const Index ncell = nc[0]*nc[1]*nc[2];
+  const int nthreads = static_cast<int> (rng_arr.size());
+  std::vector<Tally> tally(nthreads, Tally(ntype));
+  dke_cell.resize(2*ncell);
+
+#ifdef OMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+  {
+    int ithrd = 0;
+#ifdef OMP
+    ithrd = omp_get_thread_num();
+#endif
+    const Random& rnd = rng_arr[ithrd];
+    Tally& t = tally[ithrd];
+    std::vector<Real> cs(ntype);
+    Particles& pa = *pair.pa;
+    Particles& pb = *pair.pb;
+
+    // cells hold disjoint sets of particles
+#ifdef OMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (Index c = 0; c < ncell; c++) {
+      Particles::size_type* ia = order_a.data() + start_a[c];
+      Index na = start_a[c+1] - start_a[c];
+      Real vol = cell_volume(c);
+      rnd.set_key(step, reaction->r_index(), c);
+      t.dke_a = t.dke_b = 0.;
+      dke_cell[2*c] = dke_cell[2*c+1] = 0.;
+
+      if (pair.like) {
+        if (na < 2) continue;
+        shuffle(ia, na, rnd);
+        Real swa = 0.;
+        for (Index i = 0; i < na; i++) swa += pair.wa*pa[ia[i]].w();
+
+        // n/2 pairs share 1/2*N^2 collisions per unit n*dt, an odd
+        // particle makes a triplet of three half-weight pairs
+        Real s = swa*swa*dt/(vol*na);
+        Index i0 = 0;
+        if (1 == na%2) {
+          collide(pair, pa[ia[0]], pa[ia[1]], 0.5*s, cs.data(), rnd, t);
+          collide(pair, pa[ia[1]], pa[ia[2]], 0.5*s, cs.data(), rnd, t);
+          collide(pair, pa[ia[2]], pa[ia[0]], 0.5*s, cs.data(), rnd, t);
+          i0 = 3;
+        }
+        for (Index i = i0; i+1 < na; i += 2)
+          collide(pair, pa[ia[i]], pa[ia[i+1]], s, cs.data(), rnd, t);
+      }
+      else {
+        Particles::size_type* ib = order_b.data() + start_b[c];
+        Index nb = start_b[c+1] - start_b[c];
+        if (0 == na || 0 == nb) continue;
+        shuffle(ia, na, rnd);
+        shuffle(ib, nb, rnd);
+        Real swa = 0., swb = 0.;
+        for (Index i = 0; i < na; i++) swa += pair.wa*pa[ia[i]].w();
+        for (Index i = 0; i < nb; i++) swb += pair.wb*pb[ib[i]].w();
+
+        // every particle of the more numerous species is paired once,
+        // those of the other species are reused in turn
+        Index npair = std::max(na, nb);
+        Real s = swa*swb*dt/(vol*npair);
+        for (Index k = 0; k < npair; k++)
+          collide(pair, pa[ia[k%na]], pb[ib[k%nb]], s, cs.data(), rnd, t);
+      }
+      dke_cell[2*c] = t.dke_a;
+      dke_cell[2*c+1] = t.dke_b;
+    }
+  }
+
+  Particles::size_type ncoll = 0;
+  Real dke_a = 0., dke_b = 0.;
+  pmax = 0.;
+  for (int itype = 0; itype < ntype; itype++) {
+    ncoll_type[itype] = 0;
+    for (int ithrd = 0; ithrd < nthreads; ithrd++)
+      ncoll_type[itype] += tally[ithrd].ncoll[itype];
+    ncoll += ncoll_type[itype];
+  }
+  for (int ithrd = 0; ithrd < nthreads; ithrd++)
+    pmax = std::max(pmax, tally[ithrd].pmax);
+  // in cell order, the same for any # of threads
+  for (Index c = 0; c < ncell; c++) {
+    dke_a += dke_cell[2*c];
+    dke_b += dke_cell[2*c+1];
+  }
+  sa->add_energy(0.5*sa->mass*dke_a);
+  sb->add_energy(0.5*sb->mass*dke_b);
+
+  return ncoll;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+Index PairCollision::cell_index(const Particle& pt) const
+{
+  Index i = std::min(std::max(static_cast<Index> ((pt.x()-lo[0])*hinv[0]), 0), nc[0]-1);
+  Index j = std::min(std::max(static_cast<Index> ((pt.y()-lo[1])*hinv[1]), 0), nc[1]-1);
+  Index k = 0;
+  if (3 == ndim)
+    k = std::min(std::max(static_cast<Index> ((pt.z()-lo[2])*hinv[2]), 0), nc[2]-1);
+  return (k*nc[1] + j)*nc[0] + i;
+}
+
+/* ------------------------------------------------------- */
+
+Real PairCollision::cell_volume(Index c) const
+{
+  // same measure as the ambient loading: area in 2d, annulus in axi
+  if (3 == ndim) return h[0]*h[1]*h[2];
+  if (5 == ndim) {
+    Real r0 = lo[1] + ((c/nc[0])%nc[1])*h[1], r1 = r0 + h[1];
+    return PI*h[0]*(r1*r1 - r0*r0);
+  }
+  return h[0]*h[1];
+}
+
+/* ------------------------------------------------------- */
+
+void PairCollision::sort(const Particles& particles, std::vector<Index>& start,
+                         std::vector<Particles::size_type>& order)
+{
+  // counting sort by cell, start[c] is the first of cell c in order
+  const Particles::size_type np = particles.size();
+  const Index ncell = nc[0]*nc[1]*nc[2];
+  start.assign(ncell + 1, 0);
+  cell_id.resize(np);
+  order.resize(np);
+  for (Particles::size_type ip = 0; ip < np; ip++) {
+    cell_id[ip] = cell_index(particles[ip]);
+    start[cell_id[ip]+1]++;
+  }
+  for (Index c = 0; c < ncell; c++) start[c+1] += start[c];
+  for (Particles::size_type ip = 0; ip < np; ip++) {
+    order[start[cell_id[ip]]++] = ip;
+  }
+  for (Index c = ncell; c > 0; c--) start[c] = start[c-1];
+  start[0] = 0;
+}
+
+/* ------------------------------------------------------- */
+
+void PairCollision::shuffle(Particles::size_type* ids, Index n, const Random& rnd) const
+{
+  for (Index i = n-1; i > 0; i--) {
+    Index j = std::min(static_cast<Index> (rnd()*(i+1)), i);
+    std::swap(ids[i], ids[j]);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void PairCollision::collide(const Pair& pair, Particle& pi, Particle& pj, Real s,
+                            Real* cs, const Random& rnd, Tally& t) const
+{
+  Real g[3] = { pi.vx()-pj.vx(), pi.vy()-pj.vy(), pi.vz()-pj.vz() };
+  Real g2 = g[0]*g[0] + g[1]*g[1] + g[2]*g[2];
+  if (g2 <= 0.) return;
+  Real gm = sqrt(g2);
+
+  // s is per unit weight of the lighter particle, which is always
+  // scattered, the heavier one is in proportion to the weights
+  Real wi = pair.wa*pi.w(), wj = pair.wb*pj.w();
+  s /= std::min(wi, wj);
+
+  int itype = -1;
+  if (has_cs) {
+    reaction->cross_sections(0.5*pair.mr*g2, cs);
+    Real ptot = 0.;
+    for (int it = 0; it < ntype; it++)
+      if (kind_coul != kind[it]) ptot += cs[it];
+    ptot *= s*gm;
+    t.pmax = std::max(t.pmax, ptot);
+
+    Real r = rnd();
+    if (r < ptot) {
+      Real psum = 0.;
+      for (int it = 0; it < ntype; it++) {
+        if (kind_coul == kind[it]) continue;
+        itype = it;
+        psum += s*gm*cs[it];
+        if (r < psum) break;
+      }
+    }
+  }
+  if (itype < 0) {
+    for (int it = 0; it < ntype && itype < 0; it++)
+      if (kind_coul == kind[it]) itype = it;
+    if (itype < 0) return;
+  }
+
+  // scattering angle chi and new magnitude of relative velocity
+  Real gnew = gm, cc, sc;
+  switch (kind[itype]) {
+    case kind_back:
+      cc = -1.;
+      sc = 0.;
+      break;
+    case kind_exc: {
+      Real en = 0.5*pair.mr*g2 - param[itype];
+      if (en <= 0.) return;
+      gnew = sqrt(2.*en/pair.mr);
+      cc = 1. - 2.*rnd();
+      sc = sqrt(std::max(1. - cc*cc, 0.));
+      break;
+    }
+    case kind_coul: {
+      // tan(chi/2) is normal with variance q1^2 q2^2 n lnL dt/(8 pi mr^2 g^3)
+      // (eps0 = 1), isotropic once the variance exceeds 1
+      Real var = s*pair.qq*param[itype]/(8.*PI*pair.mr*pair.mr*g2*gm);
+      t.pmax = std::max(t.pmax, var);
+      if (var < 1.) {
+        Real delta = sqrt(var*(-2.*log(1. - rnd())))*cos(PI2*rnd());
+        Real d2 = delta*delta;
+        cc = 1. - 2.*d2/(1. + d2);
+        sc = 2.*delta/(1. + d2);
+      }
+      else {
+        cc = 1. - 2.*rnd();
+        sc = sqrt(std::max(1. - cc*cc, 0.));
+      }
+      break;
+    }
+    default:
+      cc = 1. - 2.*rnd();
+      sc = sqrt(std::max(1. - cc*cc, 0.));
+  }
+
+  // rotate g by (chi, eta) about its own direction
+  Real eta = PI2*rnd();
+  Real ce = cos(eta), se = sin(eta);
+  Real f = gnew/gm;
+  Real gyz = sqrt(g[1]*g[1] + g[2]*g[2]);
+  Real dg[3];
+  if (gyz > 1e-12*gm) {
+    dg[0] = f*(g[0]*cc - gyz*sc*ce) - g[0];
+    dg[1] = f*(g[1]*cc + (g[0]*g[1]*sc*ce - gm*g[2]*sc*se)/gyz) - g[1];
+    dg[2] = f*(g[2]*cc + (g[0]*g[2]*sc*ce + gm*g[1]*sc*se)/gyz) - g[2];
+  }
+  else {
+    dg[0] = f*g[0]*cc - g[0];
+    dg[1] = gnew*sc*ce;
+    dg[2] = gnew*sc*se;
+  }
+
+  // momentum is conserved pair by pair for equal weights
+  const Real fi = pair.mb/(pair.ma + pair.mb), fj = pair.ma/(pair.ma + pair.mb);
+  if (wi <= wj || rnd()*wi < wj) {
+    Real v2 = pi.vx()*pi.vx() + pi.vy()*pi.vy() + pi.vz()*pi.vz();
+    pi.vx() += fi*dg[0];
+    pi.vy() += fi*dg[1];
+    pi.vz() += fi*dg[2];
+    t.dke_a += pi.w()*(pi.vx()*pi.vx() + pi.vy()*pi.vy() + pi.vz()*pi.vz() - v2);
+  }
+  if (wj <= wi || rnd()*wj < wi) {
+    Real v2 = pj.vx()*pj.vx() + pj.vy()*pj.vy() + pj.vz()*pj.vz();
+    pj.vx() -= fj*dg[0];
+    pj.vy() -= fj*dg[1];
+    pj.vz() -= fj*dg[2];
+    t.dke_b += pj.w()*(pj.vx()*pj.vx() + pj.vy()*pj.vy() + pj.vz()*pj.vz() - v2);
+  }
+  t.ncoll[itype]++;
+}
+
+/* ----------------- End Private Methods ----------------- */
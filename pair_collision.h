@@ -0,0 +1,84 @@
+#ifndef _PAIR_COLLISION_H
+#define _PAIR_COLLISION_H
+
+#include <vector>
+#include "espic_type.h"
+#include "espic_math.h"
+#include "particles.h"
+
+// binary collisions between particles of two species, or of one species
+// with itself, paired at random within each cell (O(N) per call),
+// scattering by the cross sections of the reaction table ("ela", "iso",
+// "back", "exc") or by small-angle Coulomb scattering ("coul", the
+// Coulomb logarithm is given in place of the threshold, Takizuka-Abe)
+class PairCollision {
+  public:
+    /* Constructor */
+    PairCollision(const class Mesh*, class Reaction*);
+
+    ~PairCollision();
+
+    /* Public methods */
+    // collide particles of two species (the same one for like particles)
+    // over dt, particles of unequal weights are scattered with
+    // probability of the weight ratio, return # of collisions
+    // (random numbers of a cell are keyed by (step, reaction, cell))
+    Particles::size_type apply(class Species*, class Species*, Real dt, int step);
+
+    // # of collisions of a reaction type in last apply
+    Particles::size_type num_collisions(int itype) const { return ncoll_type[itype]; }
+
+    // largest collision probability of a pair in last apply, or the
+    // variance of tan(chi/2) of a Coulomb pair if larger (should stay
+    // well below 1, scattering is isotropic beyond it)
+    Real max_probability() const { return pmax; }
+
+  private:
+    const class Mesh* mesh;
+    class Reaction* reaction;
+    int ndim;
+    Index nc[3];                  // # of cells in x, y and z
+    Real lo[3], h[3], hinv[3];
+    int ntype;
+    std::vector<int> kind;        // scattering of each reaction type
+    std::vector<Real> param;      // threshold or Coulomb logarithm
+    bool has_cs;                  // any type from the cross-section table
+    std::vector<Particles::size_type> ncoll_type;
+    Real pmax;
+
+    std::vector<Index> start_a, start_b;           // particles sorted by cell
+    std::vector<Particles::size_type> order_a, order_b;
+    std::vector<Index> cell_id;
+    std::vector<Real> dke_cell;   // energy change of species a and b in a cell
+    std::vector<ESPIC::Random> rng_arr;            // one per thread, keyed by cell
+
+    // per-thread results of a call
+    class Tally {
+      public:
+        explicit Tally(int n) : ncoll(n, 0), dke_a(0.), dke_b(0.), pmax(0.) { }
+
+        std::vector<Particles::size_type> ncoll;
+        Real dke_a, dke_b;        // change of sum of w*v^2 in current cell
+        Real pmax;
+    };
+
+    // state of the species pair in a call
+    class Pair {
+      public:
+        Particles* pa;
+        Particles* pb;
+        Real ma, mb, mr;
+        Real wa, wb;              // species weights
+        Real qq;                  // (qa*qb)^2
+        bool like;
+    };
+
+    Index cell_index(const Particle&) const;
+    Real cell_volume(Index) const;
+    void sort(const Particles&, std::vector<Index>&, std::vector<Particles::size_type>&);
+    void shuffle(Particles::size_type*, Index, const ESPIC::Random&) const;
+    void collide(const Pair&, Particle&, Particle&, Real, Real*,
+                 const ESPIC::Random&, Tally&) const;
+};
+
+#endif
@@ -17,6 +17,7 @@
 #include "mesh.h"
 #include "param_particle.h"
 #include "Inject/beam.h"
+#include "Inject/flow.h"
 #include "Inject/inject.h"
 
 using std::cout;
@@ -56,7 +57,8 @@ ParamParticle::ParamParticle(const string& file, const Mesh* msh)
         << ", T = " << ambient->temp
         << ", v = [" << ambient->vel[0]
         << ", " << ambient->vel[1]
-        << ", " << ambient->vel[2] << "]).\n";
+        << ", " << ambient->vel[2] << "]"
+        << (ambient->quiet ? ", quiet start" : "") << ").\n";
     }
   }
 
@@ -82,6 +84,22 @@ ParamParticle::ParamParticle(const string& file, const Mesh* msh)
     }
   }
 
+  if (injectdef_ptr->num_flows() > 0) {
+    const char* face_name[6] = { "xlo", "xhi", "ylo", "yhi", "zlo", "zhi" };
+    int num_flows = injectdef_ptr->num_flows();
+
+    for (int i = 0; i < num_flows; i++) {
+      const FlowDef* const& flow = injectdef_ptr->flowdef_arr[i];
+      cout << "flow[" << i << "] - (species = " << specdef_arr[flow->specid]->name
+        << ", n = " << flow->ndens
+        << ", T = " << flow->temp
+        << ", v = [" << flow->vel[0]
+        << ", " << flow->vel[1]
+        << ", " << flow->vel[2] << "]"
+        << ", face = " << face_name[static_cast<int> (flow->face)] << ").\n";
+    }
+  }
+
 }
 
 /* ------------------------------------------------------- */
@@ -129,6 +147,7 @@ void ParamParticle::init()
          if ("species" == word.at(0)) proc_species(word);
     else if ("ambient" == word.at(0)) proc_ambient(word);
     else if ("beam"    == word.at(0)) proc_beam(word);
+    else if ("flow"    == word.at(0)) proc_flow(word);
     else espic_error(unknown_cmd_info(word.at(0), infile));
   }
   fclose(fp); 
@@ -203,28 +222,37 @@ void ParamParticle::proc_ambient(vector<string>& word)
   temp = (Real)atof(word[3].c_str());
   for (int c = 0; c < 3; c++) v[c] = (Real)atof(word[4+c].c_str());
 
+  bool quiet = false;
   word.erase(word.begin(), word.begin()+7);
-  if (word.size() > 0) {  // handle "domain" keyword
-    if (2 != word.size() && 7 != word.size())
-       espic_error(illegal_cmd_info("ambient", infile));
-
-    if ("domain" != word[0])
-       espic_error(illegal_cmd_info("ambient", infile));
-
-    if (2 == word.size()) {
-      if ("entire" != word[1])
-       espic_error(illegal_cmd_info("ambient", infile));
-    }
-    else {
-      for (int c = 0; c < 3; c++) {
-        bound_lo[c] = (Real)atof(word[1+c].c_str());
-        bound_hi[c] = (Real)atof(word[4+c].c_str());
+  while (word.size() > 0) {  // handle "domain" and "quiet" keywords
+    if ("domain" == word[0]) {
+      if (word.size() >= 2 && "entire" == word[1]) {
+        word.erase(word.begin(), word.begin()+2);
+      }
+      else {
+        if (word.size() < 7)
+          espic_error(illegal_cmd_info("ambient", infile));
+        for (int c = 0; c < 3; c++) {
+          bound_lo[c] = (Real)atof(word[1+c].c_str());
+          bound_hi[c] = (Real)atof(word[4+c].c_str());
+        }
+        word.erase(word.begin(), word.begin()+7);
       }
     }
+    else if ("quiet" == word[0]) {
+      if (word.size() < 2)
+        espic_error(illegal_cmd_info("ambient", infile));
+      if ("true" == word[1]) quiet = true;
+      else if ("false" == word[1]) quiet = false;
+      else espic_error(illegal_cmd_info("ambient", infile));
+      word.erase(word.begin(), word.begin()+2);
+    }
+    else
+      espic_error(illegal_cmd_info("ambient", infile));
   }
 
   ambientdef_arr.push_back(new AmbientDef(specid, n, temp, v,
-                                          bound_lo, bound_hi));
+                                          bound_lo, bound_hi, quiet));
   return;
 }
 
@@ -308,5 +336,59 @@ void ParamParticle::proc_beam(vector<string>& word)
                                     center, direction, width_x, width_y));
 }
 
+/* ------------------------------------------------------- */
+
+void ParamParticle::proc_flow(vector<string>& word)
+{
+  if (0 == num_species()) {
+    ostringstream oss;
+    oss << "\"flow\" command must be defined after \"spec\" in [" << infile << "]";
+    espic_error(oss.str());
+  }
+
+  string cmd(word[0]);
+  if (word.size() != 9) espic_error(illegal_cmd_info(cmd, infile));
+
+  int specid = -1;
+  string spec_name = word[1];
+  try {
+    specid = map_spec_name_indx.at(spec_name);
+  }
+  catch (const std::out_of_range& oor) {
+    ostringstream oss;
+    oss << "Unknown species \"" << spec_name << "\" given to \"flow\" command in ["
+      << infile << "]";
+    espic_error(oss.str());
+  }
+
+  Real n, temp, v[3];
+
+  n = (Real)atof(word[2].c_str());
+  temp = (Real)atof(word[3].c_str());
+  for (int c = 0; c < 3; c++) v[c] = (Real)atof(word[4+c].c_str());
+
+  // face particles flow in through
+  if ("face" != word[7]) espic_error(illegal_cmd_info(cmd, infile));
+
+  Mesh::BoundaryId face = Mesh::BoundaryId::xlo;
+       if ("xlo" == word[8]) face = Mesh::BoundaryId::xlo;
+  else if ("xhi" == word[8]) face = Mesh::BoundaryId::xhi;
+  else if ("ylo" == word[8]) face = Mesh::BoundaryId::ylo;
+  else if ("yhi" == word[8]) face = Mesh::BoundaryId::yhi;
+  else if ("zlo" == word[8]) face = Mesh::BoundaryId::zlo;
+  else if ("zhi" == word[8]) face = Mesh::BoundaryId::zhi;
+  else espic_error(illegal_cmd_info(cmd, infile));
+
+  // particles only leave the domain through an open (vacuum) face
+  if (Mesh::PBCType::vacuum != mesh->pbc_type(static_cast<int> (face))) {
+    ostringstream oss;
+    oss << "\"flow\" must be given on a vacuum particle boundary in ["
+      << infile << "]";
+    espic_error(oss.str());
+  }
+
+  injectdef_ptr->append(new FlowDef(specid, n, temp, v, face));
+}
+
 /* ---------------- End Private Methods ---------------- */
 
@@ -26,6 +26,7 @@ class ParamParticle {
     void proc_species(std::vector<std::string>&);
     void proc_ambient(std::vector<std::string>&);
     void proc_beam(std::vector<std::string>&);
+    void proc_flow(std::vector<std::string>&);
 
 };
 
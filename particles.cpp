@@ -3,19 +3,54 @@
 #include <cstring>
 #include <random>
 #include <algorithm>
+#include <new>
 
 #include "espic_info.h"
 #include "particles.h"
 
 /* ---------------- Begin Public Methods ---------------- */
 
+ParticlePool::ParticlePool()
+{
+}
+
+/* ------------------------------------------------------- */
+
+ParticlePool::~ParticlePool()
+{
+  for (Particle* b : block_arr) ESPIC::Memory::deallocate(b, block_bytes);
+}
+
+/* ------------------------------------------------------- */
+
+Particle* ParticlePool::take()
+{
+  if (free_arr.empty()) {
+    // chunks of a new block are handed out from its start
+    Particle* b = static_cast<Particle*> (ESPIC::Memory::allocate(block_bytes));
+    block_arr.push_back(b);
+    for (std::size_t i = chunks_per_block; i > 0; i--)
+      free_arr.push_back(b + (i-1)*chunk_size);
+  }
+  Particle* c = free_arr.back();
+  free_arr.pop_back();
+  return c;
+}
+
+/* ------------------------------------------------------- */
+
+void ParticlePool::give(Particle* c)
+{
+  free_arr.push_back(c);
+}
+
 /* Constructors */
 
 /* ------------------------------------------------------- */
 
 Particles::Particles()
   : nparticles(0),
-    data(0),
+    pool_ptr(std::make_shared<ParticlePool>()),
     scalar(0)
 //     pos_x(0),
 //     pos_y(0),
@@ -28,13 +63,23 @@ Particles::Particles()
 
 /* ------------------------------------------------------- */
 
+Particles::Particles(std::shared_ptr<ParticlePool> p)
+  : nparticles(0),
+    pool_ptr(p),
+    scalar(0)
+{
+}
+
+/* ------------------------------------------------------- */
+
 Particles::Particles(const std::vector<Real>& x,
                      const std::vector<Real>& y,
                      const std::vector<Real>& z,
                      const std::vector<Real>& vx,
                      const std::vector<Real>& vy,
                      const std::vector<Real>& vz)
-  : nparticles(x.size())
+  : nparticles(0),
+    pool_ptr(std::make_shared<ParticlePool>())
 //     pos_x(x),
 //     pos_y(y),
 //     pos_z(z),
@@ -42,25 +87,27 @@ Particles::Particles(const std::vector<Real>& x,
 //     vel_y(vy),
 //     vel_z(vz)
 {
-  if (nparticles != y.size())
+  const size_type np = x.size();
+  if (np != y.size())
     espic_error("Failed to construct particles because list length is not matched");
-  if (nparticles != z.size())
+  if (np != z.size())
     espic_error("Failed to construct particles because list length is not matched");
-  if (nparticles != vx.size())
+  if (np != vx.size())
     espic_error("Failed to construct particles because list length is not matched");
-  if (nparticles != vy.size())
+  if (np != vy.size())
     espic_error("Failed to construct particles because list length is not matched");
-  if (nparticles != vz.size())
+  if (np != vz.size())
     espic_error("Failed to construct particles because list length is not matched");
 
-  data.resize(nparticles);
-  for (size_type ip = 0; ip < nparticles; ip++) {
-    data[ip].x() = x[ip];
-    data[ip].y() = y[ip];
-    data[ip].z() = z[ip];
-    data[ip].vx() = vx[ip];
-    data[ip].vy() = vy[ip];
-    data[ip].vz() = vz[ip];
+  grow(np);
+  for (size_type ip = 0; ip < np; ip++) {
+    Particle& p = (*this)[ip];
+    p.x() = x[ip];
+    p.y() = y[ip];
+    p.z() = z[ip];
+    p.vx() = vx[ip];
+    p.vy() = vy[ip];
+    p.vz() = vz[ip];
   }
 }
 
@@ -69,8 +116,8 @@ Particles::Particles(const std::vector<Real>& x,
 /* ------------------------------------------------------- */
 
 Particles::Particles(const Particles& other)
-  : nparticles(other.nparticles),
-    data(other.data)
+  : nparticles(0),
+    pool_ptr(other.pool_ptr)
 //     pos_x(other.pos_x),
 //     pos_y(other.pos_y),
 //     pos_z(other.pos_z),
@@ -78,6 +125,18 @@ Particles::Particles(const Particles& other)
 //     vel_y(other.vel_y),
 //     vel_z(other.vel_z)
 {
+  append(other);
+}
+
+/* ------------------------------------------------------- */
+
+Particles& Particles::operator=(const Particles& rhs)
+{
+  if (this != &rhs) {
+    pop_back(nparticles);
+    append(rhs);
+  }
+  return *this;
 }
 
 /* Destructor */
@@ -88,16 +147,20 @@ Particles::~Particles()
 {
 //   std::cout << "In ~Particles(): nparticles = " << nparticles << std::endl;
   nparticles = 0;
+  for (Particle* c : chunk_arr) pool_ptr->give(c);
 }
 
 /* ------------------------------------------------------- */
 
 void Particles::particles_shuffle() 
     { 
-        srand((unsigned int)time(NULL));
         std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(data.begin(), data.end(), g);
+        std::mt19937 g(ESPIC::Random::is_reproducible()
+                       ? static_cast<unsigned int>(ranf()*4294967295.) : rd());
+        for (size_type i = nparticles; i > 1; i--) {
+            std::uniform_int_distribution<size_type> pick(0, i-1);
+            std::swap(at(i-1), at(pick(g)));
+        }
     }
 
 /* ------------------------------------------------------- */
@@ -105,12 +168,9 @@ void Particles::particles_shuffle()
 void Particles::get_sub_particles(size_type n, Particles& sub)
     {
         particles_shuffle();
-        if (sub.size() != 0) {
-            sub.data.clear();
-            sub.nparticles = 0;
-        }   
-        std::copy(data.begin(), data.begin() + n, back_inserter(sub.data));
-        sub.nparticles += n;
+        sub.pop_back(sub.size());
+        sub.reserve(n);
+        for (size_type ip = 0; ip < n; ip++) sub.append(at(ip));
     }
 
 /* ------------------------------------------------------- */
@@ -123,7 +183,18 @@ void Particles::reserve(size_type n)
 //   vel_x.reserve(n);
 //   vel_y.reserve(n);
 //   vel_z.reserve(n);
-  data.reserve(n);
+  reserve_chunks(n);
+}
+
+/* ------------------------------------------------------- */
+
+Particles::size_type Particles::grow(size_type n)
+{
+  size_type first = nparticles;
+  reserve_chunks(nparticles + n);
+  for (size_type ip = first; ip < first + n; ip++) new (&at(ip)) Particle();
+  nparticles += n;
+  return first;
 }
 
 /* ------------------------------------------------------- */
@@ -136,7 +207,8 @@ void Particles::append(const Particle& p)
 //   vel_x.push_back(p.vx());
 //   vel_y.push_back(p.vy());
 //   vel_z.push_back(p.vz());
-  data.push_back(p);
+  if (nparticles == capacity()) chunk_arr.push_back(pool_ptr->take());
+  new (&at(nparticles)) Particle(p);
   ++nparticles;
 }
 
@@ -144,8 +216,8 @@ void Particles::append(const Particle& p)
 
 void Particles::append(const std::vector<Particle>& p_arr)
 {
+  reserve_chunks(nparticles + p_arr.size());
   for (size_type i = 0; i < p_arr.size(); i++) append(p_arr[i]);
-  nparticles += p_arr.size();
 }
 
 /* ------------------------------------------------------- */
@@ -160,8 +232,7 @@ void Particles::append(std::vector<Particle>::const_iterator beg,
 //     vel_x.push_back(it->vx());
 //     vel_y.push_back(it->vy());
 //     vel_z.push_back(it->vz());
-    data.push_back(*it);
-    nparticles++;
+    append(*it);
   }
 }
 
@@ -177,8 +248,7 @@ void Particles::append(std::vector<Particle>::iterator beg,
 //     vel_x.push_back(it->vx());
 //     vel_y.push_back(it->vy());
 //     vel_z.push_back(it->vz());
-    data.push_back(*it);
-    nparticles++;
+    append(*it);
   }
 }
 
@@ -193,8 +263,9 @@ void Particles::append(const Particles& others)
 //   vel_y.insert(vel_y.end(), others.vel_y.begin(), others.vel_y.end());
 //   vel_z.insert(vel_z.end(), others.vel_z.begin(), others.vel_z.end());
 
-  data.insert(data.end(), others.data.begin(), others.data.end());
-  nparticles += others.size();
+  const size_type n = others.size();
+  reserve_chunks(nparticles + n);
+  for (size_type ip = 0; ip < n; ip++) append(others[ip]);
 }
 
 /* ------------------------------------------------------- */
@@ -218,9 +289,8 @@ void Particles::erase(size_type id)
 //   vel_x.pop_back();
 //   vel_y.pop_back();
 //   vel_z.pop_back();
-  data[id] = data.back();
-  data.pop_back();
-  nparticles--;
+  at(id) = at(nparticles-1);
+  pop_back(1);
 }
 
 /* ------------------------------------------------------- */
@@ -236,7 +306,7 @@ void Particles::erase(size_type id, size_type n)
 //     vel_x.at(id) = vel_x.at(i);
 //     vel_y.at(id) = vel_y.at(i);
 //     vel_z.at(id) = vel_z.at(i);
-    data[id] = data[i];
+    at(id) = at(i);
   }
   pop_back(n);
 }
@@ -251,8 +321,8 @@ void Particles::pop_back(size_type n)
 //   vel_x.erase(vel_x.end()-n, vel_x.end());
 //   vel_y.erase(vel_y.end()-n, vel_y.end());
 //   vel_z.erase(vel_z.end()-n, vel_z.end());
-  data.erase(data.end()-n, data.end());
   nparticles -= n;
+  release_chunks();
 }
 
 /* ------------------------------------------------------- */
@@ -288,15 +358,9 @@ void Particles::write_restart(FILE* fp)
 //   std::memcpy(buf+off, ptr, size_bytes);
 //   off += size_bytes;
 
-  std::vector<Particle>::pointer ptr;
-  size_type size_bytes = nparticles*sizeof(Particle);
-  char *buf = new char [size_bytes];
-
-  ptr = data.data();
-  std::memcpy(buf, ptr, size_bytes);
-  fwrite(buf, size_bytes, 1, fp);
-
-  delete [] buf;
+  // particles are written straight from storage, a chunk at a time
+  for (size_type ic = 0; ic < num_chunks(); ic++)
+    fwrite(static_cast<const void*> (chunk(ic)), sizeof(Particle), chunk_count(ic), fp);
 }
 
 /* ------------------------------------------------------- */
@@ -343,21 +407,34 @@ void Particles::read_restart_and_store(size_type np, FILE* fp)
 //   std::memcpy(ptr, buf+off, size_bytes);
 //   off += size_bytes;
 
-  std::vector<Particle>::pointer ptr;
-  const size_type size_bytes = np*sizeof(Particle);
-  char *buf = new char [size_bytes];
-
-  size_t sizeread = fread(buf, sizeof(char), size_bytes, fp);
-  if (sizeread != size_bytes) {
+  pop_back(nparticles);
+  grow(np);
+  size_t nread = 0;
+  for (size_type ic = 0; ic < num_chunks(); ic++)
+    nread += fread(static_cast<void*> (chunk(ic)), sizeof(Particle), chunk_count(ic), fp);
+  if (nread != np) {
     espic_error("Failed to read restart");
   }
+}
+/* ---------------- End Public Methods ---------------- */
 
-  data.resize(np);
-  ptr = data.data();
-  std::memcpy(ptr, buf, size_bytes);
+/* ---------------- Begin Private Methods ---------------- */
 
-  nparticles = np;
+void Particles::reserve_chunks(size_type n)
+{
+  while (capacity() < n) chunk_arr.push_back(pool_ptr->take());
+}
 
-  delete [] buf;
+/* ------------------------------------------------------- */
+
+void Particles::release_chunks()
+{
+  // a spare chunk keeps a set that shrinks and grows around a chunk
+  // boundary from trading chunks with the pool
+  while (chunk_arr.size() > num_chunks() + 1) {
+    pool_ptr->give(chunk_arr.back());
+    chunk_arr.pop_back();
+  }
 }
-/* ---------------- End Public Methods ---------------- */
+
+/* ----------------- End Private Methods ----------------- */
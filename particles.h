@@ -2,6 +2,7 @@
 #define _PARTICLES_H
 
 #include <vector>
+#include <memory>
 #include <array>
 #include <random>
 #include <chrono>
@@ -9,46 +10,68 @@
 #include <iostream>
 #include "espic_type.h"
 #include "espic_math.h"
+#include "espic_memory.h"
 
-class Particle {
+// particle with position stored as P, velocity and weight as V
+// (PosReal and VelReal for the run, see espic_type.h), arithmetic on
+// them is done in Real
+template <typename P, typename V>
+class BasicParticle {
   public:
+    typedef P pos_type;
+    typedef V vel_type;
+
     // constructors
     // default constructor
-    Particle() :
+    BasicParticle() :
       pos_ {0, 0, 0},
-      vel_ {0, 0, 0}
+      vel_ {0, 0, 0},
+      w_ (1.)
       { }
 
-    Particle(Real x, Real vx, Real y, Real vy, Real z=0., Real vz=0.) :
-      pos_ {x, y, z},
-      vel_ {vx, vy, vz}
+    BasicParticle(Real x, Real vx, Real y, Real vy, Real z=0., Real vz=0.) :
+      pos_ {P(x), P(y), P(z)},
+      vel_ {V(vx), V(vy), V(vz)},
+      w_ (1.)
       { }
     
-    Particle(Real x, Real y, Real z) :
-      pos_ {x, y, z},
-      vel_ {0, 0, 0}
+    BasicParticle(Real x, Real y, Real z) :
+      pos_ {P(x), P(y), P(z)},
+      vel_ {0, 0, 0},
+      w_ (1.)
       { }
 
     // copy constructor
-    Particle(const Particle& other) :
+    BasicParticle(const BasicParticle& other) :
       pos_{other.pos_[0], other.pos_[1], other.pos_[2]},
-      vel_{other.vel_[0], other.vel_[1], other.vel_[2]}
+      vel_{other.vel_[0], other.vel_[1], other.vel_[2]},
+      w_ (other.w_)
       { }
 
 // assignment operator
-    Particle& operator=(const Particle& rhs) {
+    BasicParticle& operator=(const BasicParticle& rhs) {
       pos_[0] = rhs.pos_[0]; pos_[1] = rhs.pos_[1]; pos_[2] = rhs.pos_[2];
       vel_[0] = rhs.vel_[0]; vel_[1] = rhs.vel_[1]; vel_[2] = rhs.vel_[2];
+      w_ = rhs.w_;
       return *this;
     }
 
-    Particle(Particle&& other) :
+    BasicParticle(BasicParticle&& other) :
       pos_{other.pos_[0], other.pos_[1], other.pos_[2]},
-      vel_{other.vel_[0], other.vel_[1], other.vel_[2]}
+      vel_{other.vel_[0], other.vel_[1], other.vel_[2]},
+      w_ (other.w_)
       { 
         other.pos_[0] = 0; other.pos_[1] = 0; other.pos_[2] = 0;
         other.vel_[0] = 0; other.vel_[1] = 0; other.vel_[2] = 0;
       }
+
+    // from a particle of other precision (rounded to this one)
+    template <typename P2, typename V2>
+    explicit BasicParticle(const BasicParticle<P2, V2>& other) :
+      pos_ {P(other.x()), P(other.y()), P(other.z())},
+      vel_ {V(other.vx()), V(other.vy()), V(other.vz())},
+      w_ (V(other.w()))
+      { }
  
 
     // void gen_relative_vel(const Real vth, std::array<int, 3>)
@@ -60,41 +83,50 @@ class Particle {
     //   vel_r[2] = vel_[2] - vzb_;
     // }
 
-    Real& x()  { return pos_[0]; }
-    Real& y()  { return pos_[1]; }
-    Real& z()  { return pos_[2]; }
-    Real& vx() { return vel_[0]; }
-    Real& vy() { return vel_[1]; }
-    Real& vz() { return vel_[2]; }
+    P& x()  { return pos_[0]; }
+    P& y()  { return pos_[1]; }
+    P& z()  { return pos_[2]; }
+    V& vx() { return vel_[0]; }
+    V& vy() { return vel_[1]; }
+    V& vz() { return vel_[2]; }
     // Real& vxr() { return vel_r[0]; }
     // Real& vyr() { return vel_r[1]; }
     // Real& vzr() { return vel_r[2]; }
     // Real& vr() { return vr_; }
     // Real& er() { return er_; }
-    const Real& x()  const { return pos_[0]; }
-    const Real& y()  const { return pos_[1]; }
-    const Real& z()  const { return pos_[2]; }
-    const Real& vx() const { return vel_[0]; }
-    const Real& vy() const { return vel_[1]; }
-    const Real& vz() const { return vel_[2]; }
+    const P& x()  const { return pos_[0]; }
+    const P& y()  const { return pos_[1]; }
+    const P& z()  const { return pos_[2]; }
+    const V& vx() const { return vel_[0]; }
+    const V& vy() const { return vel_[1]; }
+    const V& vz() const { return vel_[2]; }
+    // weight relative to the species weight, changed by merging/splitting
+    V& w() { return w_; }
+    const V& w() const { return w_; }
     // const Real& vr() const { return vr_; }
     // const Real& er() const { return er_; }
 
-    const Real velsqr() { return 0.5*(vel_[0]*vel_[0] 
-                      + vel_[1]*vel_[1] + vel_[2]*vel_[2]); }
+    const Real velsqr() { return 0.5*(Real(vel_[0])*vel_[0]
+                      + Real(vel_[1])*vel_[1] + Real(vel_[2])*vel_[2]); }
     // const Real rel_velsqr() { return 0.5*(vel_r[0]*vel_r[0] 
     //                   + vel_r[1]*vel_r[1] + vel_r[2]*vel_r[2]); }
     // Real* nu() { return nu_; }
     // const Real& nu(int i) const { return nu_[i]; }
 
-    Real* pos() { return pos_; }
-    Real* vel() { return vel_; }
+    P* pos() { return pos_; }
+    V* vel() { return vel_; }
+    const P* pos() const { return pos_; }
+    const V* vel() const { return vel_; }
   
   private:
-    Real pos_[3];
-    Real vel_[3];
+    P pos_[3];
+    V vel_[3];
+    V w_;
 };
 
+typedef BasicParticle<PosReal, VelReal> Particle;
+
+
 // help function
 inline Particle make_particle(Real x, Real y, Real vx, Real vy)
 {
@@ -106,8 +138,41 @@ inline Particle make_particle(Real x, Real y, Real z, Real vx, Real vy, Real vz,
   return Particle(x, vx, y, vy, z, vz);
 }
 
+// storage of particles in chunks of chunk_size, shared by the particle
+// sets of a species
+//
+// Chunks are cut from blocks mapped by ESPIC::Memory and never move, so a
+// set grows without copying the particles it holds. Chunks a set gives
+// back are handed out again before a new block is mapped; blocks are
+// released with the pool. Not thread safe, like appending to a set.
+class ParticlePool {
+  public:
+    static const int chunk_shift = 12;
+    static const std::size_t chunk_size = std::size_t(1) << chunk_shift;
+    static const std::size_t chunks_per_block = 16;
+    static const std::size_t block_bytes = chunks_per_block*chunk_size*sizeof(Particle);
+
+    ParticlePool();
+    ~ParticlePool();
+
+    ParticlePool(const ParticlePool&) = delete;
+    ParticlePool& operator=(const ParticlePool&) = delete;
+
+    Particle* take();
+    void give(Particle*);
+
+    // blocks mapped, each one holding chunks_per_block chunks
+    std::size_t num_blocks() const { return block_arr.size(); }
+    const Particle* block(std::size_t i) const { return block_arr[i]; }
+    std::size_t num_free() const { return free_arr.size(); }
+
+  private:
+    std::vector<Particle*> block_arr;
+    std::vector<Particle*> free_arr;
+};
+
 class Particles {
-  friend class Particle;
+  friend Particle;
 
   public:
 
@@ -119,8 +184,12 @@ class Particles {
     Particles(const std::vector<Real>&, const std::vector<Real>&, const std::vector<Real>&,
               const std::vector<Real>&, const std::vector<Real>&, const std::vector<Real>&);
 
-    // copy constructor
+    // empty set taking its chunks from a shared pool
+    explicit Particles(std::shared_ptr<ParticlePool>);
+
+    // copy constructor (shares the pool)
     Particles(const Particles&);
+    Particles& operator=(const Particles&);
 
     // desctructor
     ~Particles();
@@ -128,6 +197,20 @@ class Particles {
     // public methods
     size_type size() const { return nparticles; }
 
+    size_type capacity() const { return chunk_arr.size() << ParticlePool::chunk_shift; }
+
+    // particles lie contiguous within a chunk, chunk(ic) holds
+    // chunk_count(ic) of them starting at index ic*ParticlePool::chunk_size
+    size_type num_chunks() const
+    { return (nparticles + ParticlePool::chunk_size - 1) >> ParticlePool::chunk_shift; }
+    Particle* chunk(size_type ic) { return chunk_arr[ic]; }
+    const Particle* chunk(size_type ic) const { return chunk_arr[ic]; }
+    size_type chunk_count(size_type ic) const {
+      return std::min(ParticlePool::chunk_size, nparticles - (ic << ParticlePool::chunk_shift));
+    }
+
+    const ParticlePool& pool() const { return *pool_ptr; }
+
 //     std::vector<Real>& x()  { return pos_x; }
 //     std::vector<Real>& y()  { return pos_y; }
 //     std::vector<Real>& z()  { return pos_z; }
@@ -137,43 +220,44 @@ class Particles {
     // returning x, y, z, vx, vy, vz as an array is used for sum_field
     const std::vector<Real>& x() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].x();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).x();
       return scalar;
     }
     const std::vector<Real>& y() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].y();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).y();
       return scalar;
     }
     const std::vector<Real>& z() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].z();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).z();
       return scalar;
     }
     const std::vector<Real>& vx() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].vx();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).vx();
       return scalar;
     }
     const std::vector<Real>& vy() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].vy();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).vy();
       return scalar;
     }
     const std::vector<Real>& vz() {
       resize_scalar();
-      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = data[ip].vz();
+      for (size_type ip = 0; ip < size(); ip++) scalar[ip] = at(ip).vz();
       return scalar;
     }
     const std::vector<Real>& get_particles_energy() 
     {
       resize_scalar();
       for(size_type ip = 0; ip < size(); ip++) {
+        const Particle& p = at(ip);
         Real vx2, vy2, vz2;
-        vx2 = data[ip].vx() * data[ip].vx();
-        vy2 = data[ip].vy() * data[ip].vy();
-        vz2 = data[ip].vz() * data[ip].vz();
-        scalar[ip] = 0.5 * (vx2 + vy2 + vz2);
+        vx2 = p.vx() * p.vx();
+        vy2 = p.vy() * p.vy();
+        vz2 = p.vz() * p.vz();
+        scalar[ip] = 0.5 * (vx2 + vy2 + vz2) * p.w();
       }
       return scalar;
     }
@@ -181,6 +265,10 @@ class Particles {
     // reserve space for storing n particles
     void reserve(size_type n);
 
+    // add n (zero) particles to the end to be filled in place,
+    // return index of the first one
+    size_type grow(size_type n);
+
     // append one particle to the end
     void append(const Particle&);
     // append a list of particles
@@ -207,7 +295,7 @@ class Particles {
 //       vel_x[id] = particle.vx();
 //       vel_y[id] = particle.vy();
 //       vel_z[id] = particle.vz();
-      data[id] = particle;
+      at(id) = particle;
     }
 
     // particles[id1] = particles[id2]
@@ -221,7 +309,7 @@ class Particles {
 //       vel_x[id1] = vel_x[id2];
 //       vel_y[id1] = vel_y[id2];
 //       vel_z[id1] = vel_z[id2];
-      data[id1] = data[id2];
+      at(id1) = at(id2);
     }
 
     // "particle = particles[id]"
@@ -236,13 +324,15 @@ class Particles {
 //       particle.vx() = vel_x[id];
 //       particle.vy() = vel_y[id];
 //       particle.vz() = vel_z[id];
-      particle = data[id];
+      particle = at(id);
     }
 
-    Particle& operator[] (size_type i) { return data[i]; }
-    const Particle& operator[] (size_type i) const { return data[i]; }
-    Particle& at(size_type i) { return data[i]; }
-    const Particle& at(size_type i) const { return data[i]; }
+    Particle& operator[] (size_type i)
+    { return chunk_arr[i >> ParticlePool::chunk_shift][i & (ParticlePool::chunk_size-1)]; }
+    const Particle& operator[] (size_type i) const
+    { return chunk_arr[i >> ParticlePool::chunk_shift][i & (ParticlePool::chunk_size-1)]; }
+    Particle& at(size_type i) { return (*this)[i]; }
+    const Particle& at(size_type i) const { return (*this)[i]; }
 
     // erase particle with id 
     void erase(size_type id);
@@ -265,9 +355,15 @@ class Particles {
 //     std::vector<Real> vel_x;
 //     std::vector<Real> vel_y;
 //     std::vector<Real> vel_z;
-    std::vector<Particle> data;
+    std::shared_ptr<ParticlePool> pool_ptr;
+    std::vector<Particle*> chunk_arr;
     std::vector<Real> scalar;
 
+    // take chunks from the pool for n particles in total
+    void reserve_chunks(size_type n);
+    // give back chunks beyond those in use and one spare
+    void release_chunks();
+
     void resize_scalar() {
       if(scalar.size() != size()) scalar.resize(size());
     }
@@ -293,6 +389,7 @@ inline Real Pcoll(Real nu, Real dt)
 
 inline Real RG01()
 {
+    if (ESPIC::Random::is_reproducible()) return ranf();
     std::random_device rd;
     std::mt19937 g(rd());
     std::uniform_real_distribution<Real> RDr(0.,1.);
@@ -305,7 +402,9 @@ inline const void random_index(size_t np, size_t nc, std::vector<int>& index_lis
     std::vector<Particles::size_type> index(np);   
     std::generate(index.begin(), index.end(), [&]{ return i++; });
 
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    unsigned seed = ESPIC::Random::is_reproducible()
+        ? static_cast<unsigned>(ranf()*4294967295.)
+        : std::chrono::system_clock::now().time_since_epoch().count();
     std::shuffle(index.begin(), index.end(), std::default_random_engine(seed));
     index_list.insert(index_list.end(), index.begin(), index.begin()+nc);
 }
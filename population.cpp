@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cmath>
+
+#include "espic_info.h"
+#include "espic_math.h"
+#include "mesh.h"
+#include "population.h"
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+Population::Population(const Mesh* msh, int _nmin, int _nmax, uint64_t _stream)
+  : mesh(msh),
+    ndim(msh->dimension()),
+    nc {msh->num_cells(0), msh->num_cells(1), msh->num_cells(2)},
+    lo {msh->xmin(), msh->ymin(), msh->zmin()},
+    hinv {1./msh->dx(), 1./msh->dy(), 1./msh->dz()},
+    stream(_stream),
+    nmin(_nmin),
+    nmax(_nmax),
+    ntarget((_nmin + _nmax)/2),
+    nmerged(0),
+    nsplit(0)
+{
+  if (nmin < 1 || nmax < 2*nmin) {
+    espic_error("Population control needs 1 <= min and 2*min <= max per cell");
+  }
+  if (3 != ndim) nc[2] = 1;
+  cell_start.assign(nc[0]*nc[1]*nc[2] + 1, 0);
+}
+
+/* ------------------------------------------------------- */
+
+Population::~Population()
+{
+}
+
+/* ------------------------------------------------------- */
+
+Particles::size_type Population::apply(Particles& particles, int istep)
+{
+  const Particles::size_type np = particles.size();
+  const Index ncell = static_cast<Index> (cell_start.size()) - 1;
+  nmerged = nsplit = 0;
+
+  // sort particles by cell (counting sort)
+  cell_id.resize(np);
+  order.resize(np);
+  std::fill(cell_start.begin(), cell_start.end(), 0);
+  for (Particles::size_type ip = 0; ip < np; ip++) {
+    cell_id[ip] = cell_index(particles[ip]);
+    cell_start[cell_id[ip]+1]++;
+  }
+  for (Index c = 0; c < ncell; c++) cell_start[c+1] += cell_start[c];
+  for (Particles::size_type ip = 0; ip < np; ip++) {
+    order[cell_start[cell_id[ip]]++] = ip;
+  }
+  for (Index c = ncell; c > 0; c--) cell_start[c] = cell_start[c-1];
+  cell_start[0] = 0;
+
+  bool changed = false;
+  for (Index c = 0; c < ncell && !changed; c++) {
+    Index n = cell_start[c+1] - cell_start[c];
+    changed = (n > nmax || (n > 0 && n < nmin));
+  }
+  if (!changed) return np;
+
+  buffer.clear();
+  buffer.reserve(np);
+  for (Index c = 0; c < ncell; c++) {
+    Particles::size_type* ids = order.data() + cell_start[c];
+    int n = static_cast<int> (cell_start[c+1] - cell_start[c]);
+
+    if (n > nmax) merge(particles, ids, n);
+    else if (n > 0 && n < nmin) split(particles, ids, n, c, istep);
+    else {
+      for (int i = 0; i < n; i++) buffer.push_back(particles[ids[i]]);
+    }
+  }
+
+  particles.pop_back(particles.size());
+  particles.append(buffer);
+  return np;
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+Index Population::cell_index(const Particle& pt) const
+{
+  Index i = std::min(std::max(static_cast<Index> ((pt.x()-lo[0])*hinv[0]), 0), nc[0]-1);
+  Index j = std::min(std::max(static_cast<Index> ((pt.y()-lo[1])*hinv[1]), 0), nc[1]-1);
+  Index k = 0;
+  if (3 == ndim)
+    k = std::min(std::max(static_cast<Index> ((pt.z()-lo[2])*hinv[2]), 0), nc[2]-1);
+  return (k*nc[1] + j)*nc[0] + i;
+}
+
+/* ------------------------------------------------------- */
+
+void Population::merge(const Particles& particles, const Particles::size_type* ids, int n)
+{
+  // passes of 3 -> 2 merges of nearest neighbors until the cell is
+  // back to ntarget, or no neighbors are left to merge
+  cellp.clear();
+  for (int i = 0; i < n; i++) cellp.push_back(particles[ids[i]]);
+  while (static_cast<int> (cellp.size()) > ntarget && merge_pass() > 0) { }
+  nmerged += n - cellp.size();
+  buffer.insert(buffer.end(), cellp.begin(), cellp.end());
+}
+
+/* ------------------------------------------------------- */
+
+int Population::merge_pass()
+{
+  const int n = static_cast<int> (cellp.size());
+
+  // mean velocity of the cell
+  Real u[3] = {0., 0., 0.}, wsum = 0.;
+  for (const Particle& pt : cellp) {
+    u[0] += pt.w()*pt.vx();
+    u[1] += pt.w()*pt.vy();
+    u[2] += pt.w()*pt.vz();
+    wsum += pt.w();
+  }
+  for (int a = 0; a < 3; a++) u[a] /= wsum;
+
+  // velocity-space bins: octant around the mean velocity, then speed
+  // relative to it, so neighbors in rank are close in velocity
+  auto octant = [&](const Particle& pt) {
+    return (pt.vx() > u[0]) + 2*(pt.vy() > u[1]) + 4*(pt.vz() > u[2]);
+  };
+  auto key = [&](int i) {
+    const Particle& pt = cellp[i];
+    Real d[3] = { pt.vx()-u[0], pt.vy()-u[1], pt.vz()-u[2] };
+    return std::make_pair(octant(pt), d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+  };
+  rank.resize(n);
+  for (int i = 0; i < n; i++) rank[i] = i;
+  std::sort(rank.begin(), rank.end(), [&](int a, int b) {
+    return key(a) < key(b);
+  });
+
+  // consecutive triplets within one octant, by velocity-space spread
+  auto dist2 = [&](int a, int b) {
+    const Particle& pa = cellp[a];
+    const Particle& pb = cellp[b];
+    Real d[3] = { pa.vx()-pb.vx(), pa.vy()-pb.vy(), pa.vz()-pb.vz() };
+    return d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+  };
+  triplet.clear();
+  for (int r = 0; r + 2 < n; r++) {
+    if (octant(cellp[rank[r]]) != octant(cellp[rank[r+2]])) continue;
+    Real spread = dist2(rank[r], rank[r+1]) + dist2(rank[r+1], rank[r+2])
+                + dist2(rank[r], rank[r+2]);
+    triplet.push_back(std::make_pair(spread, r));
+  }
+  std::sort(triplet.begin(), triplet.end());
+
+  // closest disjoint triplets first, each one removes a particle
+  const int nneed = n - ntarget;
+  int ndone = 0;
+  used.assign(n, 0);
+  cellq.clear();
+  for (std::size_t t = 0; t < triplet.size() && ndone < nneed; t++) {
+    const int r = triplet[t].second;
+    if (used[r] || used[r+1] || used[r+2]) continue;
+    used[r] = used[r+1] = used[r+2] = 1;
+    const Particle* group[3] = { &cellp[rank[r]], &cellp[rank[r+1]], &cellp[rank[r+2]] };
+    merge_group(group, 3, cellq);
+    ndone++;
+  }
+  for (int r = 0; r < n; r++) {
+    if (!used[r]) cellq.push_back(cellp[rank[r]]);
+  }
+  cellp.swap(cellq);
+  return ndone;
+}
+
+/* ------------------------------------------------------- */
+
+void Population::merge_group(const Particle* const* group, int n, std::vector<Particle>& out)
+{
+  // two particles of half the total weight at the center of charge,
+  // moving at u +/- dv with |dv|^2 = <v^2> - u^2 keep momentum and energy
+  Real w = 0., x[3] = {0., 0., 0.}, u[3] = {0., 0., 0.}, v2 = 0.;
+  for (int i = 0; i < n; i++) {
+    const Particle& pt = *group[i];
+    w += pt.w();
+    x[0] += pt.w()*pt.x();
+    x[1] += pt.w()*pt.y();
+    x[2] += pt.w()*pt.z();
+    u[0] += pt.w()*pt.vx();
+    u[1] += pt.w()*pt.vy();
+    u[2] += pt.w()*pt.vz();
+    v2 += pt.w()*(pt.vx()*pt.vx() + pt.vy()*pt.vy() + pt.vz()*pt.vz());
+  }
+  for (int a = 0; a < 3; a++) {
+    x[a] /= w;
+    u[a] /= w;
+  }
+  Real dv = sqrt(std::max(v2/w - (u[0]*u[0] + u[1]*u[1] + u[2]*u[2]), 0.));
+
+  // dv along the largest deviation from u in the group
+  Real d[3] = {0., 0., 0.}, dmax = 0.;
+  for (int i = 0; i < n; i++) {
+    const Particle& pt = *group[i];
+    Real di[3] = { pt.vx()-u[0], pt.vy()-u[1], pt.vz()-u[2] };
+    Real dd = di[0]*di[0] + di[1]*di[1] + di[2]*di[2];
+    if (dd > dmax) {
+      dmax = dd;
+      for (int a = 0; a < 3; a++) d[a] = di[a];
+    }
+  }
+  Real scale = dmax > 0. ? dv/sqrt(dmax) : 0.;
+
+  for (int sign = -1; sign <= 1; sign += 2) {
+    Particle pt(x[0], x[1], x[2]);
+    pt.vx() = u[0] + sign*scale*d[0];
+    pt.vy() = u[1] + sign*scale*d[1];
+    pt.vz() = u[2] + sign*scale*d[2];
+    pt.w() = 0.5*w;
+    out.push_back(pt);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void Population::split(const Particles& particles, Particles::size_type* ids, int n,
+                       Index cellid, int istep)
+{
+  // split the heaviest particles in two halves at x +/- dx, inside the
+  // cell and with the velocity kept, until the cell reaches ntarget;
+  // the center of charge, momentum and energy are unchanged
+  std::sort(ids, ids+n, [&](Particles::size_type a, Particles::size_type b) {
+    Real wa = particles[a].w(), wb = particles[b].w();
+    return wa > wb || (wa == wb && a < b);
+  });
+
+  const Index ic[3] = { cellid%nc[0], (cellid/nc[0])%nc[1], cellid/(nc[0]*nc[1]) };
+  ESPIC::Random rng;
+  rng.set_key(istep, stream, cellid);
+
+  int nsp = std::min(n, ntarget - n);
+  for (int i = 0; i < n; i++) {
+    Particle pt = particles[ids[i]];
+    if (i < nsp) {
+      pt.w() *= 0.5;
+      Particle pt2 = pt;
+      for (int a = 0; a < ndim; a++) {
+        // room to both cell faces, so both halves stay in the cell
+        Real xa = pt.pos()[a], clo = lo[a] + ic[a]/hinv[a];
+        Real room = std::max(std::min(xa - clo, clo + 1./hinv[a] - xa), Real(0));
+        Real dx = (2.*rng.uniform_dist() - 1.)*room;
+        pt.pos()[a] = xa + dx;
+        pt2.pos()[a] = xa - dx;
+      }
+      buffer.push_back(pt2);
+      nsplit++;
+    }
+    buffer.push_back(pt);
+  }
+}
+
+/* ----------------- End Private Methods ----------------- */
@@ -0,0 +1,59 @@
+#ifndef _POPULATION_H
+#define _POPULATION_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "espic_type.h"
+#include "particles.h"
+
+// keep # of particles per cell of one species in [nmin, nmax] by merging
+// nearest neighbors in velocity space (3 into 2) in crowded cells and
+// splitting heavy particles in two displaced halves in sparse cells,
+// conserving charge, momentum and energy
+class Population {
+  public:
+    /* Constructor */
+    // (mesh, min and max # of particles per cell, random stream id)
+    Population(const class Mesh*, int nmin, int nmax, uint64_t stream);
+
+    ~Population();
+
+    /* Public methods */
+    // merge/split particles at a step, return # of particles visited
+    Particles::size_type apply(Particles&, int istep);
+
+    int min_per_cell() const { return nmin; }
+    int max_per_cell() const { return nmax; }
+
+    // # of particles removed by merging and added by splitting in last apply
+    Particles::size_type num_merged() const { return nmerged; }
+    Particles::size_type num_split() const { return nsplit; }
+
+  private:
+    const class Mesh* mesh;
+    int ndim;
+    Index nc[3];                  // # of cells in x, y and z
+    Real lo[3], hinv[3];
+    uint64_t stream;              // split offsets keyed by (step, stream, cell)
+    int nmin, nmax;
+    int ntarget;                  // # per cell aimed at when out of band
+    Particles::size_type nmerged, nsplit;
+
+    std::vector<Index> cell_start;                 // particles sorted by cell
+    std::vector<Particles::size_type> order;
+    std::vector<Index> cell_id;
+    std::vector<Particle> buffer;                  // particles after apply
+    std::vector<Particle> cellp, cellq;            // one cell between merge passes
+    std::vector<int> rank;
+    std::vector<std::pair<Real, int>> triplet;     // (spread, first in rank)
+    std::vector<char> used;
+
+    Index cell_index(const Particle&) const;
+    void merge(const Particles&, const Particles::size_type*, int);
+    int merge_pass();
+    void split(const Particles&, Particles::size_type*, int, Index, int);
+    void merge_group(const Particle* const*, int, std::vector<Particle>&);
+};
+
+#endif
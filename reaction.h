@@ -48,6 +48,23 @@ public:
         }
         return info;
     }
+
+    // cross sections at en written to cs[isize()], same interpolation as
+    // en_cs but without touching members (safe from several threads),
+    // energies above the table take the last row
+    void cross_sections(Real en, Real* cs) const
+    {
+        if (en <= de_) {
+            for (int i = 0; i < info_size; ++i) cs[i] = 0.;
+            return;
+        }
+        Real ei = std::min(en*deinv_ - 1, static_cast<Real>(arr_length - 1));
+        int elo = std::min(static_cast<int>(ei), arr_length - 2);
+        Real w1 = ei - elo;
+        for (int i = 0; i < info_size; ++i)
+            cs[i] = (1 - w1)*info_arr[elo][i] + w1*info_arr[elo+1][i];
+    }
+
     void find_max_coll_freq();
 
     std::vector<std::vector<int> > prodid_arr;
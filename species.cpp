@@ -36,13 +36,15 @@ void Species::reserve_num_particles(Bigint n)
 
 void Species::get_particles_energy()
 {
-  Particles::size_type nparts, ipart;
-  nparts = particles->size();
   toten = 0;
-  for (ipart = 0; ipart < nparts; ++ipart) {
-    Particle& particle = (*particles)[ipart];
-    toten += particle.velsqr()*mass;
-    // toten += particle.lost();
+  for (Particles::size_type ic = 0; ic < particles->num_chunks(); ++ic) {
+    Particle* pc = particles->chunk(ic);
+    const Particles::size_type nparts = particles->chunk_count(ic);
+    for (Particles::size_type ipart = 0; ipart < nparts; ++ipart) {
+      Particle& particle = pc[ipart];
+      toten += particle.velsqr()*mass*particle.w();
+      // toten += particle.lost();
+    }
   }
 }
 
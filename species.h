@@ -43,8 +43,15 @@ class Species {
     /* Public methods */
     void reserve_num_particles(Bigint n);
 
+    // full sweep for total kinetic energy (toten)
     void get_particles_energy();
 
+    // keep toten up to date from the energy change of push, collisions,
+    // injection and losses, without a sweep (exactly 0 once empty)
+    void add_energy(Real de) {
+      toten = (particles->size() > 0 ? toten + de : 0.);
+    }
+
     Particles::size_type num_particles() const { return particles->size(); }
 
     void write_restart(FILE *);
@@ -1,6 +1,21 @@
+#include <cstring>
+
 #include "tile.h"
 #include "ambient.h"
-#include <fstream>
+#include "field.h"
+#include "population.h"
+#include "pair_collision.h"
+#include "background_field.h"
+#include "tile_schedule.h"
+#include "diagnostics.h"
+#include "domain.h"
+#include "geometry.h"
+#include "Inject/beam.h"
+#include "Inject/flow.h"
+
+#ifdef OMP
+#include <omp.h>
+#endif
 
 int ela, exc, ion;
 using std::cout;
@@ -13,36 +28,56 @@ using std::endl;
 Tile::Tile(
     Mesh* msh,
     const ParamParticle* param_particle,
-    const CrossSection* cross_section)
+    const CrossSection* cross_section,
+    Domain* dom)
     : mesh(msh),
-      mass(cross_section->background->mass),
-      ndens(cross_section->background->ndens),
-      vth(cross_section->background->vth),
-      ptr_particle_collision(nullptr)
+      schedule(nullptr),
+      cost_candidate(8.),
+      nlost(0),
+      ncoll_step(0),
+      domain((nullptr != dom && dom->is_decomposed()) ? dom : nullptr),
+      diag(nullptr),
+      coll_channel(-1),
+      curr_step(0),
+      ptr_particle_collision(nullptr),
+      ptr_push(nullptr)
 {
+    for (const CrossSection::Background* bg : cross_section->background_arr) {
+        gas_arr.push_back(bg);
+        bgfield_arr.push_back(new BackgroundField(mesh, bg));
+    }
+    if (!bgfield_arr.empty()) {
+        int nthreads = 1;
+#ifdef OMP
+        nthreads = omp_get_max_threads();
+#endif
+        const Index ntile[3] = { bgfield_arr[0]->num_tiles(0), bgfield_arr[0]->num_tiles(1),
+                                 bgfield_arr[0]->num_tiles(2) };
+        schedule = new TileSchedule(ntile, mesh->dimension(), nthreads);
+        rng_arr.resize(nthreads);
+    }
     Bigint np = 10000;
     const vector<SpeciesDef*>& specdef_arr = param_particle->specdef_arr;
     const vector<AmbientDef*>& ambdef_arr = param_particle->ambientdef_arr;
 
     int nspecies = static_cast<int>(specdef_arr.size());
     species_arr.resize(nspecies);
+    population_arr.assign(nspecies, nullptr);
+    population_every.assign(nspecies, 1);
+    subcycle_arr.assign(nspecies, 1);
+    subcycle_slot.assign(nspecies, -1);
+    cost_particle.assign(nspecies, 1.);
     for (int ispec = 0; ispec < nspecies; ++ispec) {
         species_arr[ispec] = new Species(specdef_arr[ispec]);
         species_arr[ispec]->reserve_num_particles(np);
     }
 
     InitAmbient(mesh->dimension(), ambdef_arr, specdef_arr);
+    InitInject(mesh->dimension(), param_particle->injectdef_ptr, specdef_arr);
     InitCollision(param_particle, cross_section);
-
-    if(!ambient_arr.empty()) {
-        int num_ambient = static_cast<int>(ambient_arr.size());
-        for (int iamb = 0; iamb < num_ambient; ++iamb) {
-            Ambient* const& ambient = ambient_arr[iamb];
-            Species* & species = species_arr[ambient->species_id()];
-
-            ambient->gen_ambient_0d(np, species->particles);
-        }
-    }
+    InitLostParticles(nspecies);
+    with_geometry(mesh->dimension(), [this](auto g) { ptr_push = &Tile::PushSpecies<decltype(g)>; });
+    InitDomain();
 }
 
 Tile::~Tile()
@@ -59,92 +94,326 @@ Tile::~Tile()
         ambient_arr.clear();
         ambient_arr.shrink_to_fit();
     }
+    if(!inject_arr.empty()) {
+        for (size_t iinj = 0; iinj < inject_arr.size(); ++iinj)
+            delete inject_arr[iinj];
+        inject_arr.clear();
+        inject_arr.shrink_to_fit();
+    }
+    for (size_t ispec = 0; ispec < population_arr.size(); ++ispec)
+        delete population_arr[ispec];
+    for (size_t icsp = 0; icsp < paircoll_arr.size(); ++icsp)
+        delete paircoll_arr[icsp];
+    for (size_t igas = 0; igas < bgfield_arr.size(); ++igas)
+        delete bgfield_arr[igas];
+    delete schedule;
 }
 
-void Tile::ParticleCollisioninTiles(Real dt)
+Particles::size_type Tile::InjectParticles(Real dt)
 {
-    size_t num_collspec = reaction_arr.size();
-    for (size_t icsp = 0; icsp < num_collspec; ++icsp) {
-        std::vector<int>& specid_arr = reaction_arr[icsp].first;
-        if (specid_arr.size() < 2) {
-            ela = 0; exc = 0; ion = 0;
-            ptr_particle_collision = &Tile::ParticleBackgroundCollision;
+    Particles::size_type ninject = 0;
+    for (size_t iinj = 0; iinj < inject_arr.size(); ++iinj) {
+        if (!inject_on[iinj]) continue;
+        Inject* const& inject = inject_arr[iinj];
+        inject_buffer.clear();
+        inject->gen_particles(dt, inject_buffer);
+        if (nullptr != domain && !inject_split[iinj]) {
+            Real xa, xb;
+            inject->x_extent(xa, xb);
+            domain->select(inject_buffer, xa, xb);
         }
-        else {
-            ptr_particle_collision = &Tile::ParticleColumnCollision;
-            reaction_arr[icsp].second->is_background_collision = false;
+        Species* const& species = species_arr[inject->species()];
+        species->particles->append(inject_buffer);
+        Real ke = 0.;
+        for (const Particle& pt : inject_buffer)
+            ke += pt.w()*(pt.vx()*pt.vx() + pt.vy()*pt.vy() + pt.vz()*pt.vz());
+        species->add_energy(0.5*species->mass*ke);
+        ninject += inject_buffer.size();
+    }
+    return ninject;
+}
+
+Particles::size_type Tile::ParticlePush(Real dt0, Field* field, int istep)
+{
+    Particles::size_type npushed = 0;
+    nlost = 0;
+
+    for (int ispec = 0; ispec < num_species(); ++ispec) {
+        const int nsub = subcycle_arr[ispec];
+        if (0 != istep%nsub) continue;
+        npushed += (this->*ptr_push)(ispec, dt0*nsub, field);
+    }
+    return npushed;
+}
+
+Particles::size_type Tile::MigrateParticles(int istep)
+{
+    if (nullptr == domain) return 0;
+
+    // species not pushed in this step stay, but take part in the
+    // exchange so all processes send one message per step
+    migrate_arr.clear();
+    Particles empty;
+    for (int ispec = 0; ispec < num_species(); ++ispec) {
+        if (0 == istep%subcycle_arr[ispec]) migrate_arr.push_back(species_arr[ispec]->particles);
+        else migrate_arr.push_back(&empty);
+    }
+    Particles::size_type nsent = domain->migrate(migrate_arr, migrate_dke);
+    for (int ispec = 0; ispec < num_species(); ++ispec)
+        species_arr[ispec]->add_energy(0.5*species_arr[ispec]->mass*migrate_dke[ispec]);
+    return nsent;
+}
+
+Particles::size_type Tile::DepositCharge(Field* field, int istep)
+{
+    Particles::size_type ndeposit = 0;
+    field->reset_charge();
+    for (int ispec = 0; ispec < num_species(); ++ispec) {
+        Species* const& species = species_arr[ispec];
+        if (species->charge == 0. || subcycle_slot[ispec] >= 0) continue;
+        field->deposit(*(species->particles), species->charge*species->weight);
+        ndeposit += species->num_particles();
+    }
+    field->finalize_charge();
+
+    // sub-cycled species: deposit right after their push,
+    // extrapolate the frozen density to this step otherwise
+    for (int ispec = 0; ispec < num_species(); ++ispec) {
+        Species* const& species = species_arr[ispec];
+        const int islot = subcycle_slot[ispec];
+        if (species->charge == 0. || islot < 0) continue;
+        const int nsub = subcycle_arr[ispec];
+        if (0 == istep%nsub) {
+            field->deposit_frozen(*(species->particles), species->charge*species->weight, islot);
+            ndeposit += species->num_particles();
         }
+        field->add_frozen_charge(islot, static_cast<Real>(istep%nsub)/nsub);
+    }
+    return ndeposit;
+}
+
+void Tile::SetPopulation(int ispec, int nmin, int nmax, int n)
+{
+    delete population_arr[ispec];
+    population_arr[ispec] = new Population(mesh, nmin, nmax,
+                                           ESPIC::Random::population_stream + ispec);
+    population_every[ispec] = n;
+}
+
+Particles::size_type Tile::ControlPopulation(int istep)
+{
+    Particles::size_type nvisit = 0;
+    for (int ispec = 0; ispec < num_species(); ++ispec) {
+        Population* const& population = population_arr[ispec];
+        if (nullptr == population || 0 != istep%population_every[ispec]) continue;
+        // sub-cycled species only right after their push, before
+        // their frozen density is deposited
+        if (0 != istep%subcycle_arr[ispec]) continue;
+        nvisit += population->apply(*(species_arr[ispec]->particles), istep);
+    }
+    return nvisit;
+}
+
+void Tile::GetRandomState(std::vector<uint64_t>& state) const
+{
+    state.clear();
+    state.push_back(ranf.get_state());
+    for (const Inject* inject : inject_arr) {
+        Inject::Position pos = inject->position();
+        uint64_t res;
+        std::memcpy(&res, &pos.res, sizeof(res));
+        state.push_back(pos.ifill);
+        state.push_back(res);
+        state.push_back(static_cast<uint64_t> (pos.cursor));
+    }
+}
+
+void Tile::SetRandomState(const std::vector<uint64_t>& state)
+{
+    if (state.size() != 3*inject_arr.size() + 1) {
+        espic_warning("# of random streams differs from this input, not restored");
+        return;
+    }
+    ranf.set_state(state[0]);
+    for (size_t iinj = 0; iinj < inject_arr.size(); ++iinj) {
+        const uint64_t* s = &state[3*iinj+1];
+        Inject::Position pos;
+        pos.ifill = s[0];
+        std::memcpy(&pos.res, &s[1], sizeof(pos.res));
+        pos.cursor = static_cast<int> (s[2]);
+        inject_arr[iinj]->set_position(pos);
+    }
+}
+
+void Tile::SetBalance(Real threshold, Real candidate)
+{
+    cost_candidate = candidate;
+    if (nullptr != schedule) schedule->set_threshold(threshold);
+}
+
+void Tile::SetSubcycle(int ispec, int n, Field* field)
+{
+    subcycle_arr[ispec] = std::max(n, 1);
+    if (n > 1 && subcycle_slot[ispec] < 0)
+        subcycle_slot[ispec] = field->add_subcycle_slot();
+}
+
+Particles::size_type Tile::ParticleCollisioninTiles(Real dt, int istep)
+{
+    ncoll_step = 0;
+    curr_step = istep;
+    size_t num_collspec = reaction_arr.size();
+    for (size_t icsp = 0; icsp < num_collspec; ++icsp) {
+        if (nullptr == paircoll_arr[icsp]) continue;
+        ptr_particle_collision = &Tile::ParticleColumnCollision;
+        reaction_arr[icsp].second->is_background_collision = false;
         (this->*ptr_particle_collision)(dt, icsp);
     }
+    // all background gases of a species at once
+    for (size_t igrp = 0; igrp < bgcoll_arr.size(); ++igrp) {
+        ela = 0; exc = 0; ion = 0;
+        ptr_particle_collision = &Tile::ParticleBackgroundCollision;
+        (this->*ptr_particle_collision)(dt, igrp);
+    }
+    if (!bgcoll_arr.empty()) schedule->update();
+    return ncoll_step;
 }
 
-void Tile::ParticleBackgroundCollision(Real dt, int icsp)
+void Tile::ParticleBackgroundCollision(Real dt, int igrp)
 {
-    Particles::size_type ipart, npart, ncoll;
-    
-    const int spec_id = (reaction_arr[icsp].first)[0];
-    Reaction* & reaction = reaction_arr[icsp].second;
+    const int spec_id = bgcoll_arr[igrp].first;
+    const std::vector<int>& icsp_arr = bgcoll_arr[igrp].second;
+    const int nreact = static_cast<int>(icsp_arr.size());
     Particles* & pts = species_arr[spec_id]->particles;
     const Real pm = species_arr[spec_id]->mass;
-    const Real m = (pm * mass)/(pm + mass);
+    const Particles::size_type npart = pts->size();
 
-    const std::string& name = species_arr[spec_id]->name;
-    std::ofstream of(name+".dat", std::ofstream::app);
-    std::ofstream coll("coll.dat", std::ofstream::app);
-    Real nu_max(0);
-    npart = pts->size();
+    // sort particles by tile (counting sort), tiles are the same for all gases
+    const BackgroundField* tiles = bgfield_arr[reaction_gas[icsp_arr[0]]];
+    const Index ntile = tiles->num_tiles();
+    tile_start.assign(ntile + 1, 0);
+    tile_id.resize(npart);
+    tile_order.resize(npart);
+    for (Particles::size_type ipart = 0; ipart < npart; ++ipart) {
+        tile_id[ipart] = tiles->tile_index((*pts)[ipart].pos());
+        ++tile_start[tile_id[ipart]+1];
+    }
+    for (Index it = 0; it < ntile; ++it) tile_start[it+1] += tile_start[it];
+    for (Particles::size_type ipart = 0; ipart < npart; ++ipart)
+        tile_order[tile_start[tile_id[ipart]]++] = ipart;
+    for (Index it = ntile; it > 0; --it) tile_start[it] = tile_start[it-1];
+    tile_start[0] = 0;
 
-    VecRealArr nu_arr(npart);
-    std::vector<VrArr> vr_arr(npart);
-    std::vector<Real> vel_r(npart);
-    std::vector<int> index_list;
-    
-    for (ipart=0; ipart < npart; ++ipart) {
-        Real nevrt, nutot(0);
-        Real vxb, vyb, vzb;
-        Real energy;
-        Particle& pt = (*pts)[ipart];
-
-        VelBoltzDistr(vth, vxb, vyb, vzb);
-        vr_arr[ipart] = {pt.vx()-vxb, pt.vy()-vyb, pt.vz()-vzb};
-        vel_r[ipart] = velocity(vr_arr[ipart][0], vr_arr[ipart][1], vr_arr[ipart][2]);
-        energy = 0.5 * vel_r[ipart]*vel_r[ipart] * m;
-        nu_arr[ipart] = reaction->en_cs(energy);
-
-        nevrt = vel_r[ipart] * ndens;
-        for (auto& nui : nu_arr[ipart]) {
-            nui *= nevrt;
-            nutot += nui;
-        }
-        if (nutot > nu_max) nu_max = nutot;
-    }
-    ncoll = static_cast<Particles::size_type>(npart*Pcoll(nu_max,dt)+0.5);
-    random_index(npart, ncoll, index_list);
-    sort(index_list.begin(), index_list.end());
-
-    CollProd products;
-    int ntype = reaction->isize();
-    for(const int& ipart: index_list) {
-        Particle& ptc = (*pts)[ipart];
-        const std::vector<Real>& nu = nu_arr[ipart];
-        
-        Real rnd = ranf(), nuj = 0.;
-        int itype = 0;
-        while(itype != ntype) {
-            nuj += nu[itype];
-            if(rnd < (nuj/nu_max)) {
-                Collisionpair collision = Collisionpair(ptc, vr_arr[ipart], vel_r[ipart], pm, mass, vth);
-                ParticleCollision(itype, mass, reaction, collision, products);
-                // break;
-                if (itype == 0) ++ela;
-                else if (itype == 1) ++exc;
-                else ++ion;
-                break;
+    // null collision: candidates of a tile are drawn once with the sum of
+    // the majorants of all reactions (densest node of the gas in the tile
+    // times max sigma*v of the table), a candidate falls in the band of one
+    // reaction and is accepted with its local n(x)*sigma(g)*g
+    //
+    // tiles are independent, each thread takes its run of tiles along the
+    // space-filling curve, random numbers of a tile are keyed by
+    // (step, first reaction, tile) so the result does not depend on the
+    // assignment
+    const int nthreads = schedule->num_threads();
+    const uint64_t stream = reaction_arr[icsp_arr[0]].second->r_index();
+    int ncs = 0;
+    for (int ir = 0; ir < nreact; ++ir)
+        ncs = std::max(ncs, reaction_arr[icsp_arr[ir]].second->isize());
+    tile_dke.assign(ntile, 0.);
+    std::vector<Real> nu_max_thrd(nthreads, 0.);
+    std::vector<Particles::size_type> ncoll_thrd(nthreads, 0);
+    std::vector<std::array<int, 3>> ntype_thrd(nthreads, {0, 0, 0});
+
+#ifdef OMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+    {
+        int ithrd = 0;
+#ifdef OMP
+        ithrd = omp_get_thread_num();
+#endif
+        const ESPIC::Random& rnd = rng_arr[ithrd];
+        CollProd products;
+        std::vector<Real> band(nreact), cs(ncs);
+
+        for (Index ipos = schedule->begin(ithrd); ipos < schedule->begin(ithrd+1); ++ipos) {
+            const Index it = schedule->tile(ipos);
+            Particles::size_type* ids = tile_order.data() + tile_start[it];
+            Particles::size_type n = tile_start[it+1] - tile_start[it];
+            Real nu_tile = 0.;
+            for (int ir = 0; ir < nreact; ++ir) {
+                const int icsp = icsp_arr[ir];
+                band[ir] = bgfield_arr[reaction_gas[icsp]]->tile_max_ndens(it)
+                         * reaction_arr[icsp].second->max_coll_freq();
+                nu_tile += band[ir];
             }
-            ++itype;
+            if (0 == n || nu_tile <= 0.) continue;
+            nu_max_thrd[ithrd] = std::max(nu_max_thrd[ithrd], nu_tile);
+
+            rnd.set_key(curr_step, stream, it);
+            Particles::size_type ncand = std::min(n,
+                static_cast<Particles::size_type>(n*Pcoll(nu_tile,dt) + rnd()));
+            ncoll_thrd[ithrd] += ncand;
+            schedule->add_cost(it, cost_particle[spec_id]*n + cost_candidate*ncand);
+
+            Real dke = 0.;              // change of sum of w*v^2
+            for (Particles::size_type ic = 0; ic < ncand; ++ic) {
+                // distinct candidates by a partial shuffle
+                Particles::size_type jc = ic + std::min(
+                    static_cast<Particles::size_type>(rnd()*(n - ic)), n - ic - 1);
+                std::swap(ids[ic], ids[jc]);
+                Particle& ptc = (*pts)[ids[ic]];
+
+                Real r = rnd() * nu_tile;
+                int ir = 0;
+                while (ir < nreact-1 && r >= band[ir]) r -= band[ir++];
+                const int icsp = icsp_arr[ir];
+                Reaction* & reaction = reaction_arr[icsp].second;
+                const Real mass = gas_arr[reaction_gas[icsp]]->mass;
+                const Real m = (pm * mass)/(pm + mass);
+                const int ntype = reaction->isize();
+
+                Real nloc, vthloc;
+                Real vxb, vyb, vzb;
+                bgfield_arr[reaction_gas[icsp]]->at(ptc.pos(), nloc, vthloc);
+                VelBoltzDistr(vthloc, vxb, vyb, vzb, rnd);
+                VrArr vr = {ptc.vx()-vxb, ptc.vy()-vyb, ptc.vz()-vzb};
+                Real vel = velocity(vr[0], vr[1], vr[2]);
+                reaction->cross_sections(0.5 * vel*vel * m, cs.data());
+
+                Real nuj = 0.;
+                for (int itype = 0; itype != ntype; ++itype) {
+                    nuj += nloc * vel * cs[itype];
+                    if (r < nuj) {
+                        Real v2old = ptc.vx()*ptc.vx() + ptc.vy()*ptc.vy() + ptc.vz()*ptc.vz();
+                        Collisionpair collision = Collisionpair(ptc, vr, vel, pm, mass, vthloc, rnd);
+                        ParticleCollision(itype, mass, reaction, collision, products);
+                        Real v2new = ptc.vx()*ptc.vx() + ptc.vy()*ptc.vy() + ptc.vz()*ptc.vz();
+                        dke += ptc.w()*(v2new - v2old);
+                        ++ntype_thrd[ithrd][std::min(itype, 2)];
+                        break;
+                    }
+                }
+            }
+            tile_dke[it] = dke;
+            products.clear();
         }
     }
 
+    // reduced in tile order, independent of the # of threads
+    Real nu_max(0);
+    Particles::size_type ncoll = 0;
+    Real dke = 0.;
+    for (Index it = 0; it < ntile; ++it) dke += tile_dke[it];
+    species_arr[spec_id]->add_energy(0.5*pm*dke);
+    for (int ithrd = 0; ithrd < nthreads; ++ithrd) {
+        nu_max = std::max(nu_max, nu_max_thrd[ithrd]);
+        ncoll += ncoll_thrd[ithrd];
+        ela += ntype_thrd[ithrd][0];
+        exc += ntype_thrd[ithrd][1];
+        ion += ntype_thrd[ithrd][2];
+    }
+    ncoll_step += ncoll;
+
     // if(!products.empty()){
 
     //     std::vector<int>& prodid =  reaction->prodid_arr;
@@ -157,19 +426,64 @@ void Tile::ParticleBackgroundCollision(Real dt, int icsp)
     //         }
     //     }
     // }
-    coll << " nparts: " << npart  << " nu_max: " << nu_max 
-         << " ncolls: " << ncoll << " -> "
-         << ela << " " << exc << " " << ion << std::endl;
-
-    species_arr[spec_id]->get_particles_energy();
-    of << species_arr[spec_id]->toten << std::endl;
-    coll.close();
-    of.close();
+    if (nullptr != diag) {
+        diag->record(coll_channel, curr_step,
+                     { static_cast<Real>(curr_step), static_cast<Real>(spec_id),
+                       static_cast<Real>(npart), nu_max, static_cast<Real>(ncoll),
+                       static_cast<Real>(ela), static_cast<Real>(exc), static_cast<Real>(ion) });
+        diag->record(energy_channel[spec_id], curr_step,
+                     { static_cast<Real>(curr_step), species_arr[spec_id]->toten });
+    }
+}
+
+void Tile::SetDiagnostics(Diagnostics* dg, int n)
+{
+    diag = dg;
+    coll_channel = diag->add_channel("coll.dat",
+        { "step", "species", "nparts", "nu_max", "ncolls", "ela", "exc", "ion" }, n);
+    energy_channel.resize(species_arr.size());
+    for (size_t ispec = 0; ispec < species_arr.size(); ++ispec)
+        energy_channel[ispec] = diag->add_channel(species_arr[ispec]->name + ".dat",
+                                                  { "step", "energy" }, n);
+}
+
+void Tile::ReduceLostParticles(Real curr_time)
+{
+    for (Conductor* conductor : mesh->get_conductors()) {
+        if (conductor->is_collecting_lost_particles())
+            conductor->reduce_lost_particles(curr_time);
+    }
 }
 
 void Tile::ParticleColumnCollision(Real dt, int icsp)
-{ 
-    espic_error("Column collision has not prepared");
+{
+    Reaction* & reaction = reaction_arr[icsp].second;
+    const int nsub = std::max(reaction->sub_cycle(), 1);
+    if (0 != curr_step%nsub) return;
+
+    const std::vector<int>& specid_arr = reaction_arr[icsp].first;
+    Species* const& species1 = species_arr[specid_arr[0]];
+    Species* const& species2 = species_arr[specid_arr[1]];
+    PairCollision* const& paircoll = paircoll_arr[icsp];
+    Particles::size_type ncoll = paircoll->apply(species1, species2, dt*nsub, curr_step);
+    ncoll_step += ncoll;
+
+    if (nullptr != diag) {
+        // scattering types are counted as ela, inelastic ones as exc
+        Particles::size_type nela = 0, nexc = 0;
+        const StringList& types = reaction->get_types();
+        for (int itype = 0; itype < reaction->isize(); ++itype) {
+            if ("exc" == types[itype]) nexc += paircoll->num_collisions(itype);
+            else nela += paircoll->num_collisions(itype);
+        }
+        Particles::size_type npart = species1->num_particles();
+        if (species2 != species1) npart += species2->num_particles();
+        diag->record(coll_channel, curr_step,
+                     { static_cast<Real>(curr_step), static_cast<Real>(specid_arr[0]),
+                       static_cast<Real>(npart), paircoll->max_probability()/(dt*nsub),
+                       static_cast<Real>(ncoll), static_cast<Real>(nela),
+                       static_cast<Real>(nexc), 0. });
+    }
 }
 
 
@@ -220,14 +534,34 @@ void Tile::InitAmbient(
     }
 }
 
+void Tile::InitInject(
+    int dimension,
+    const InjectDef* injectdef,
+    const std::vector<SpeciesDef*>& specdef_arr)
+{
+    for (int i = 0; i < injectdef->num_beams(); i++) {
+        const BeamDef* const& beamdef = injectdef->beamdef_arr[i];
+        const SpeciesDef* const& specdef = specdef_arr[beamdef->specid];
+        inject_arr.push_back(new Beam(dimension, beamdef, specdef));
+        inject_arr.back()->set_stream(inject_arr.size()-1);
+    }
+
+    for (int i = 0; i < injectdef->num_flows(); i++) {
+        const FlowDef* const& flowdef = injectdef->flowdef_arr[i];
+        const SpeciesDef* const& specdef = specdef_arr[flowdef->specid];
+        inject_arr.push_back(new Flow(dimension, flowdef, specdef, mesh));
+        inject_arr.back()->set_stream(inject_arr.size()-1);
+    }
+}
+
 void Tile::InitCollision(
         const ParamParticle* pp,
         const CrossSection* cs)
 {
     for (int icsp = 0; icsp < cs->num_pairs(); ++icsp) {
         Reaction* reaction = cs->reaction_arr[icsp];
-        const std::string& bspname = cs->get_bkname();
         const ReactPair& spair = reaction->pair();
+        const int igas = cs->find_background(spair.second);
         // const StringList& prod_list = cs->product_arr[icsp];
         std::vector<int> spec_id, prod_id;
         int specid1 = -1, specid2 = -1;
@@ -236,11 +570,11 @@ void Tile::InitCollision(
             specid1 = pp->map_spec_name_indx.at(spair.first);
             spec_id.push_back(specid1);
             m1 = pp->specdef_arr[specid1]->mass;
-            if (spair.second != bspname){
+            if (igas < 0){
                 specid2 = pp->map_spec_name_indx.at(spair.second);
                 spec_id.push_back(specid2);
                 m2 = pp->specdef_arr[specid2]->mass; 
-            } else { m2 = mass; }
+            } else { m2 = gas_arr[igas]->mass; }
             reaction->mr() = m1*m2 / (m1+m2);
         }
         catch (const std::out_of_range& oor) {
@@ -251,6 +585,15 @@ void Tile::InitCollision(
         }
         reaction->find_max_coll_freq();
         reaction_arr.emplace_back(std::make_pair(spec_id, reaction));
+        reaction_gas.push_back(igas);
+        paircoll_arr.push_back(igas >= 0 ? nullptr : new PairCollision(mesh, reaction));
+        if (igas >= 0) {
+            size_t igrp = 0;
+            while (igrp < bgcoll_arr.size() && bgcoll_arr[igrp].first != specid1) ++igrp;
+            if (igrp == bgcoll_arr.size())
+                bgcoll_arr.emplace_back(std::make_pair(specid1, std::vector<int>()));
+            bgcoll_arr[igrp].second.push_back(icsp);
+        }
         std::cout << "Reaction " << icsp  <<", relative mass: " << reaction->mr()
                   << ", Max Coll Freq: " << reaction->max_coll_freq()
                   << " product(name,specid): [";
@@ -283,3 +626,164 @@ void Tile::InitCollision(
     }
     
 }
+
+template <class G>
+Particles::size_type Tile::PushSpecies(int ispec, Real dt, Field* field)
+{
+    Species* const& species = species_arr[ispec];
+    Particles& pts = *(species->particles);
+    const int islot = subcycle_slot[ispec];
+    const Real qmdt = species->charge/species->mass*dt;
+    const Real qw = species->charge*species->weight;
+    const Real mw = 0.5*species->mass*species->weight;
+    Real dke = 0.;              // change of sum of w*v^2
+    const Particles::size_type npushed = pts.size();
+
+    Particles::size_type ipart = 0;
+    while (ipart < pts.size()) {
+        Particle& pt = pts[ipart];
+        Real E[3];
+        Vector3 pos_old = { pt.x(), pt.y(), pt.z() };
+
+        Real v2old = pt.vx()*pt.vx() + pt.vy()*pt.vy() + pt.vz()*pt.vz();
+
+        // leapfrog, v(t+dt/2) = v(t-dt/2) + q/m*E(x(t))*dt
+        if (islot < 0) field->gather<G>(pt.pos(), E);
+        else field->gather_average<G>(islot, pt.pos(), E);
+        pt.vx() += qmdt*E[0];
+        pt.vy() += qmdt*E[1];
+        pt.vz() += qmdt*E[2];
+
+        pt.x() += pt.vx()*dt;
+        if constexpr (G::axi) {
+            // move in the 3d plane through the particle and
+            // rotate back to the (x, r) plane
+            Real y = pt.y() + pt.vy()*dt, z = pt.vz()*dt;
+            Real r = sqrt(y*y + z*z);
+            if (r > 0.) {
+                Real c = y/r, s = z/r;
+                Real vr = c*pt.vy() + s*pt.vz();
+                pt.vz() = -s*pt.vy() + c*pt.vz();
+                pt.vy() = vr;
+            }
+            pt.y() = r;
+        }
+        else {
+            pt.y() += pt.vy()*dt;
+            if constexpr (3 == G::nd) pt.z() += pt.vz()*dt;
+        }
+
+        Real v2new = pt.vx()*pt.vx() + pt.vy()*pt.vy() + pt.vz()*pt.vz();
+        dke += pt.w()*(v2new - v2old);
+
+        Vector3 pos_new = { pt.x(), pt.y(), pt.z() };
+        Conductor* conductor = mesh->find_scraping_conductor<G>(pos_old, pos_new);
+        bool lost = (conductor != nullptr);
+        if (lost) {
+            Real en = mw*pt.w()*v2new;
+            conductor->scrape_particle(ispec, qw*pt.w(), en, pos_old, pos_new);
+        }
+        else {
+            lost = ApplyBoundary<G>(pt);
+        }
+
+        if (lost) {
+            dke -= pt.w()*v2new;
+            pts.erase(ipart);   // last particle moved in, not pushed yet
+            ++nlost;
+        }
+        else
+            ++ipart;
+    }
+    if (islot >= 0) field->reset_average(islot);
+    species->add_energy(0.5*species->mass*dke);
+    return npushed;
+}
+
+template <class G>
+bool Tile::ApplyBoundary(Particle& pt)
+{
+    const Real lo[3] = { mesh->xmin(), mesh->ymin(), mesh->zmin() };
+    const Real hi[3] = { mesh->xmax(), mesh->ymax(), mesh->zmax() };
+    PosReal* pos = pt.pos();
+    VelReal* vel = pt.vel();
+
+    for (int a = 0; a < G::nd; ++a) {
+        int iface = -1;
+        if (pos[a] < lo[a]) iface = 2*a;
+        else if (pos[a] > hi[a]) iface = 2*a+1;
+        if (iface < 0) continue;
+
+        Real bound = (0 == iface%2 ? lo[a] : hi[a]);
+        switch (mesh->pbc_type(iface)) {
+            case Mesh::PBCType::vacuum:
+                return true;
+            case Mesh::PBCType::reflect:
+                pos[a] = 2.*bound - pos[a];
+                vel[a] = -vel[a];
+                break;
+            case Mesh::PBCType::periodic:
+                pos[a] += (0 == iface%2 ? 1. : -1.)*(hi[a] - lo[a]);
+                break;
+        }
+    }
+    return false;
+}
+
+void Tile::InitLostParticles(int nspecies)
+{
+    int nthreads = 1;
+#ifdef OMP
+    nthreads = omp_get_max_threads();
+#endif
+    for (Conductor* conductor : mesh->get_conductors()) {
+        if (conductor->is_collecting_lost_particles())
+            conductor->init_lost_particles(nspecies, nthreads);
+    }
+}
+
+void Tile::InitDomain()
+{
+    // ambient columns meeting the slab are loaded, particles of a column
+    // across a slab end are generated by both processes and each keeps
+    // its own
+    int nc[3];
+    Real dx[3] = { mesh->dx(), mesh->dy(), mesh->dz() };
+    for (int a = 0; a < 3; ++a) nc[a] = mesh->num_cells(a);
+    for (Ambient* ambient : ambient_arr) {
+        Species* const& species = species_arr[ambient->species_id()];
+        Real lo[3] = { ambient->xmin(), ambient->ymin(), ambient->zmin() };
+        Real hi[3] = { ambient->xmax(), ambient->ymax(), ambient->zmax() };
+        if (nullptr != domain) ambient->set_window(domain->xmin(), domain->xmax());
+        ambient->gen_ambient(nc, lo, hi, dx, species->particles);
+    }
+
+    inject_on.assign(inject_arr.size(), true);
+    inject_split.assign(inject_arr.size(), false);
+    if (nullptr == domain) return;
+
+    for (Species* species : species_arr)
+        domain->select(*(species->particles));
+
+    // every process has drawn the same numbers so far, split them
+    ranf.set_key(0, ranf.get_state(), domain->rank());
+
+    // a flow through a face along x is split over the slabs (own stream
+    // on each process), other injections are generated in full by the
+    // owners of their x-extent, with the same stream
+    const int rank = domain->rank();
+    for (size_t iinj = 0; iinj < inject_arr.size(); ++iinj) {
+        Inject* const& inject = inject_arr[iinj];
+        Real xa, xb;
+        if (inject->clip_x(domain->xmin(), domain->xmax())) {
+            inject->set_stream(iinj + inject_arr.size()*rank);
+            inject->x_extent(xa, xb);
+            inject_on[iinj] = (xb > xa);
+            inject_split[iinj] = true;
+        }
+        else {
+            inject->x_extent(xa, xb);
+            inject_on[iinj] = (domain->owner(xa) <= rank && rank <= domain->owner(xb));
+        }
+    }
+}
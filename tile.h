@@ -13,18 +13,90 @@ using std::pair;
 
 class Tile {
 public:
+    // with a decomposed domain only particles of the slab of this
+    // process are loaded and injected, random streams of processes are
+    // split after the initial load
     Tile(class Mesh*,
          const class ParamParticle*,
-         const class CrossSection*);
+         const class CrossSection*,
+         class Domain* = nullptr);
     
     ~Tile();
 
-    void ParticleCollisioninTiles(Real);
+    // return # of collisions in this step
+    Particles::size_type ParticleCollisioninTiles(Real, int istep = 0);
+
+    // write collision statistics and species energy to diagnostics
+    // channels every n steps
+    void SetDiagnostics(class Diagnostics*, int n);
 
-    void ParticleBackgroundCollision(Real dt, int icps);
+    // null collisions of a species with all background gases
+    // (group igrp of reactions)
+    void ParticleBackgroundCollision(Real dt, int igrp);
 
+    // binary collisions between particles of the two species of a pair,
+    // every n_sub steps of the reaction table
     void ParticleColumnCollision(Real dt, int icps);
 
+    // inject particles from beams and open-boundary flows in this step,
+    // return # of particles injected
+    Particles::size_type InjectParticles(Real dt);
+
+    // advance particles by dt in the field, remove those scraped by
+    // conductors or leaving through vacuum boundaries,
+    // return # of particles pushed
+    // (a sub-cycled species moves by n*dt in the field averaged over
+    // the last n solves, only in steps that are multiples of n)
+    Particles::size_type ParticlePush(Real dt, class Field*, int istep = 0);
+
+    // send particles that left the slab to their owners after a push,
+    // return # of particles sent
+    Particles::size_type MigrateParticles(int istep = 0);
+
+    // deposit charge of all species to field, return # of particles deposited
+    // (a sub-cycled species is deposited after its push only and its
+    // frozen density is reused in between)
+    Particles::size_type DepositCharge(class Field*, int istep = 0);
+
+    // keep # of particles per cell of a species in [nmin, nmax] every n steps
+    void SetPopulation(int ispec, int nmin, int nmax, int n);
+
+    // merge/split particles of species due in this step,
+    // return # of particles visited
+    Particles::size_type ControlPopulation(int istep);
+
+    // tiles of the null-collision loop are reassigned to threads when
+    // the slowest one carries more than threshold times the mean cost,
+    // cost of a tile is particles times their species' cost plus
+    // collision candidates times candidate
+    void SetBalance(Real threshold, Real candidate);
+    void SetParticleCost(int ispec, Real c) { cost_particle[ispec] = c; }
+
+    // nullptr if there is no background gas
+    const class TileSchedule* tile_schedule() const { return schedule; }
+
+    // push species every n steps
+    void SetSubcycle(int ispec, int n, class Field*);
+    int subcycle(int ispec) const { return subcycle_arr[ispec]; }
+    // field slot of a sub-cycled species, -1 if not sub-cycled
+    int subcycle_slot_id(int ispec) const { return subcycle_slot[ispec]; }
+
+    // # of particles removed in the last push
+    Particles::size_type num_lost() const { return nlost; }
+
+    int num_species() const { return static_cast<int>(species_arr.size()); }
+
+    class Species* get_species(int ispec) { return species_arr[ispec]; }
+
+    // states of serial random streams (global one, then fill #, residual
+    // and cursor per inject, see Inject::Position), streams of parallel
+    // loops are keyed by step and need no state
+    void GetRandomState(std::vector<uint64_t>&) const;
+    void SetRandomState(const std::vector<uint64_t>&);
+
+    // reduce lost particles scraped by conductors in this step
+    void ReduceLostParticles(Real curr_time);
+
     void NullCollisionMethod(Particles&, Real, Real, Reaction*&, Real, CollProd&);
 
     void ParticleCollision(const int , Real ,
@@ -41,22 +113,75 @@ private:
         const vector<AmbientDef*>&, 
         const vector<SpeciesDef*>&);
 
+    void InitInject(int,
+        const class InjectDef*,
+        const vector<SpeciesDef*>&);
+
     void InitCollision(
          const class ParamParticle*,
          const class CrossSection*);
+
+    void InitLostParticles(int);
+
+    // load ambient particles of the slab, select injections meeting it
+    void InitDomain();
+
+    // push one species by dt (G the geometry policy of the mesh),
+    // return # of particles pushed
+    template <class G>
+    Particles::size_type PushSpecies(int ispec, Real dt, class Field*);
+
+    // apply particle BC on domain bounds, return true if particle is lost
+    template <class G>
+    bool ApplyBoundary(Particle&);
     
 
     class Mesh* mesh;
     vector<class Ambient*> ambient_arr;
+    vector<class Inject*> inject_arr;
+    vector<bool> inject_on;         // meets the slab of this process
+    vector<bool> inject_split;      // only the part in the slab is injected
+    vector<Particle> inject_buffer;
     vector<pair<vector<int>, class Reaction*>> reaction_arr;
+    vector<class PairCollision*> paircoll_arr;   // nullptr for background
     vector<class Species*> species_arr;
-    const Real mass, ndens, vth;
+    vector<const CrossSection::Background*> gas_arr;
+    vector<class BackgroundField*> bgfield_arr;  // of each gas
+    vector<int> reaction_gas;                   // gas of a reaction, -1 for pairs
+    vector<pair<int, vector<int>>> bgcoll_arr;  // species, its gas reactions
+    std::vector<Index> tile_start;              // particles sorted by tile
+    std::vector<Particles::size_type> tile_order;
+    std::vector<Index> tile_id;
+    class TileSchedule* schedule;               // tiles of each thread
+    std::vector<ESPIC::Random> rng_arr;         // one per thread, keyed by tile
+    std::vector<Real> tile_dke;                 // energy change in a tile
+    vector<Real> cost_particle;                 // of each species
+    Real cost_candidate;
+    vector<class Population*> population_arr;   // nullptr if not controlled
+    vector<int> population_every;
+    vector<int> subcycle_arr;       // push every n steps
+    vector<int> subcycle_slot;      // field slot of sub-cycled species, -1 if not
+    Particles::size_type nlost;
+    Particles::size_type ncoll_step;
     Real xmin, ymin, zmin, xmax, ymax, zmax;
     Real dx, dy, dz;
     Real dxinv, dyinv, dzinv;
 
+    class Domain* domain;           // nullptr if not decomposed
+    vector<Particles*> migrate_arr;
+    vector<Real> migrate_dke;
+
+    class Diagnostics* diag;
+    int coll_channel;               // coll.dat
+    vector<int> energy_channel;     // <species>.dat
+    int curr_step;
+
     typedef void (Tile::*ParticleCollisioninTile)(Real, int);
     ParticleCollisioninTile ptr_particle_collision;
+
+    // push kernel of the mesh geometry, chosen at construction
+    typedef Particles::size_type (Tile::*PushSpeciesFn)(int, Real, class Field*);
+    PushSpeciesFn ptr_push;
 };
 
 #endif
\ No newline at end of file
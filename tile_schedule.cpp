@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <utility>
+
+#include "tile_schedule.h"
+
+/* ---------------- Begin Public Methods ---------------- */
+
+/* Constructor */
+TileSchedule::TileSchedule(const Index ntile[3], int ndim, int nthrd, Real thres)
+  : nthreads(std::max(nthrd, 1)),
+    threshold(thres),
+    imb_last(1.),
+    imb_max(1.),
+    nreassign(0)
+{
+  const Index nt = ntile[0]*ntile[1]*ntile[2];
+  std::vector<std::pair<uint64_t, Index>> key(nt);
+  uint64_t n = 1;
+  while (n < static_cast<uint64_t> (std::max(ntile[0], ntile[1]))) n <<= 1;
+  for (Index kt = 0; kt < ntile[2]; kt++)
+    for (Index jt = 0; jt < ntile[1]; jt++)
+      for (Index it = 0; it < ntile[0]; it++) {
+        Index itile = (kt*ntile[1] + jt)*ntile[0] + it;
+        key[itile].first = (3 == ndim) ? morton_key(it, jt, kt) : hilbert_key(n, it, jt);
+        key[itile].second = itile;
+      }
+  std::sort(key.begin(), key.end());
+
+  curve.resize(nt);
+  for (Index i = 0; i < nt; i++) curve[i] = key[i].second;
+  cost.assign(nt, 0.);
+
+  // equal # of tiles until a cost is measured
+  cut(std::vector<Real>(nt, 1.));
+}
+
+/* ------------------------------------------------------- */
+
+TileSchedule::~TileSchedule()
+{
+}
+
+/* ------------------------------------------------------- */
+
+void TileSchedule::update()
+{
+  std::vector<Real> c(curve.size());
+  for (std::size_t i = 0; i < curve.size(); i++) c[i] = cost[curve[i]];
+
+  Real total = 0., cmax = 0.;
+  for (int t = 0; t < nthreads; t++) {
+    Real sum = 0.;
+    for (Index i = run_begin[t]; i < run_begin[t+1]; i++) sum += c[i];
+    total += sum;
+    cmax = std::max(cmax, sum);
+  }
+  imb_last = (total > 0.) ? cmax*nthreads/total : 1.;
+  imb_max = std::max(imb_max, imb_last);
+
+  if (imb_last > threshold) {
+    cut(c);
+    nreassign++;
+  }
+  std::fill(cost.begin(), cost.end(), 0.);
+}
+
+/* ----------------- End Public Methods ----------------- */
+
+/* ---------------- Begin Private Methods ---------------- */
+
+void TileSchedule::cut(const std::vector<Real>& c)
+{
+  // thread t starts where the cost summed along the curve passes
+  // t/nthreads of the total
+  const Index nt = static_cast<Index> (c.size());
+  Real total = 0.;
+  for (Real v : c) total += v;
+
+  run_begin.assign(nthreads+1, nt);
+  run_begin[0] = 0;
+  Real sum = 0.;
+  Index i = 0;
+  for (int t = 1; t < nthreads; t++) {
+    Real target = total*t/nthreads;
+    while (i < nt && sum + 0.5*c[i] < target) sum += c[i++];
+    run_begin[t] = i;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+uint64_t TileSchedule::hilbert_key(uint64_t n, uint64_t x, uint64_t y)
+{
+  // distance along the Hilbert curve filling an n x n square (n a power of 2)
+  uint64_t d = 0;
+  for (uint64_t s = n/2; s > 0; s /= 2) {
+    uint64_t rx = (x & s) > 0 ? 1 : 0;
+    uint64_t ry = (y & s) > 0 ? 1 : 0;
+    d += s*s*((3*rx) ^ ry);
+    if (0 == ry) {
+      if (1 == rx) {
+        x = n-1 - x;
+        y = n-1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+/* ------------------------------------------------------- */
+
+uint64_t TileSchedule::morton_key(uint64_t x, uint64_t y, uint64_t z)
+{
+  // bits of x, y and z interleaved
+  uint64_t key = 0;
+  for (int b = 0; b < 21; b++) {
+    key |= ((x >> b) & 1) << (3*b);
+    key |= ((y >> b) & 1) << (3*b + 1);
+    key |= ((z >> b) & 1) << (3*b + 2);
+  }
+  return key;
+}
+
+/* ----------------- End Private Methods ----------------- */
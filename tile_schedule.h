@@ -0,0 +1,62 @@
+#ifndef _TILE_SCHEDULE_H
+#define _TILE_SCHEDULE_H
+
+#include <vector>
+#include "espic_type.h"
+
+// assignment of tiles to threads
+//
+// Tiles are ordered along a space-filling curve (Hilbert in 2d and
+// axi-symmetric, Morton in 3d), so a run of consecutive tiles is a
+// compact region, and each thread takes one run. The cost of each tile
+// is measured during a step (particles times their cost plus collision
+// candidates times theirs); at the end of the step the runs are cut
+// again for equal cost if the slowest thread would carry more than
+// threshold times the mean.
+class TileSchedule {
+  public:
+    /* Constructor */
+    // (# of tiles in x, y and z, dimension, # of threads, threshold)
+    TileSchedule(const Index ntile[3], int ndim, int nthreads, Real threshold = 1.1);
+
+    ~TileSchedule();
+
+    /* Public methods */
+    int num_threads() const { return nthreads; }
+    Index num_tiles() const { return static_cast<Index> (curve.size()); }
+
+    // tiles of thread ithrd are tile(i) for i in [begin(ithrd), begin(ithrd+1))
+    Index begin(int ithrd) const { return run_begin[ithrd]; }
+    Index tile(Index i) const { return curve[i]; }
+
+    // add work done on a tile in this step (a tile is only touched by
+    // the thread it is assigned to)
+    void add_cost(Index itile, Real c) { cost[itile] += c; }
+
+    // close a step: imbalance of the current runs under the measured
+    // cost, runs are cut again if it exceeds the threshold
+    void update();
+
+    void set_threshold(Real t) { threshold = t; }
+
+    // max/mean of cost per thread in the last step, the largest one
+    // since start, and # of reassignments
+    Real imbalance() const { return imb_last; }
+    Real max_imbalance() const { return imb_max; }
+    long num_reassign() const { return nreassign; }
+
+  private:
+    int nthreads;
+    Real threshold;
+    std::vector<Index> curve;       // tiles in curve order
+    std::vector<Index> run_begin;   // first curve position of each thread, nthreads+1
+    std::vector<Real> cost;         // of each tile in this step
+    Real imb_last, imb_max;
+    long nreassign;
+
+    void cut(const std::vector<Real>&);
+    static uint64_t hilbert_key(uint64_t n, uint64_t x, uint64_t y);
+    static uint64_t morton_key(uint64_t x, uint64_t y, uint64_t z);
+};
+
+#endif